@@ -0,0 +1,326 @@
+#include "benchmarks.h"
+#include "zsl/atomics.h"
+#include "zsl/hash_map.h"
+#include "zsl/array_list.h"
+#include "zsl/allocation_trace.h"
+
+static void waitBriefly(size_t spins){
+	if(spins < 64) spinPause();
+	else threadYield();
+}
+
+// Mostly small blocks, some page sized and a few large ones.
+static size_t randomBlockSize(Random& random){
+	uint64_t kind = random.next(100);
+	if(kind < 70) return 16 + random.next(240);
+	if(kind < 95) return 256 + random.next(3840);
+	return 4096 + random.next(61440);
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------- Producer/consumer ------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// A producer hands every block it allocates to its consumer through a ring and the consumer frees it,
+// so every free is a cross-thread free. The worst case for allocators that cache blocks per thread.
+struct Handoff{
+	static constexpr size_t CAPACITY = 256;
+	
+	alignas(64) size_t head;// Written by the producer.
+	alignas(64) size_t tail;// Written by the consumer.
+	void* blocks[CAPACITY];
+	Allocator allocator;
+	size_t count;
+	uint64_t seed;
+	Semaphore* done;
+};
+
+static void producerMain(void* userData){
+	Handoff* handoff = (Handoff*)userData;
+	Random random = {handoff->seed};
+	for(size_t i = 0; i < handoff->count; i++){
+		size_t size = randomBlockSize(random);
+		char* block = (char*)handoff->allocator(nullptr, size, 8);
+		block[0] = 1;
+		if(i % 8 == 0){
+			block = (char*)handoff->allocator(block, size * 2, 8);
+			block[size * 2 - 1] = 1;
+		}
+		for(size_t spins = 0; i - atomicLoad(&handoff->tail, ORDER_ACQUIRE) == Handoff::CAPACITY; spins++) waitBriefly(spins);
+		handoff->blocks[i % Handoff::CAPACITY] = block;
+		atomicStore(&handoff->head, i + 1, ORDER_RELEASE);
+	}
+	handoff->done->post();
+}
+
+static void consumerMain(void* userData){
+	Handoff* handoff = (Handoff*)userData;
+	for(size_t i = 0; i < handoff->count; i++){
+		for(size_t spins = 0; atomicLoad(&handoff->head, ORDER_ACQUIRE) == i; spins++) waitBriefly(spins);
+		handoff->allocator(handoff->blocks[i % Handoff::CAPACITY], 0, 0);
+		atomicStore(&handoff->tail, i + 1, ORDER_RELEASE);
+	}
+	handoff->done->post();
+}
+
+struct ProducerConsumer{
+	std::vector<Handoff> handoffs;
+	Semaphore done;
+	
+	// Passes count blocks in total over pairs producer/consumer pairs.
+	void start(Allocator allocator, size_t pairs, size_t count){
+		handoffs.resize(pairs);
+		done.init();
+		for(size_t i = 0; i < pairs; i++){
+			Handoff& handoff = handoffs[i];
+			handoff.head = handoff.tail = 0;
+			handoff.allocator = allocator;
+			handoff.count = count / pairs;
+			handoff.seed = i + 1;
+			handoff.done = &done;
+			threadCreate(producerMain, &handoff);
+			threadCreate(consumerMain, &handoff);
+		}
+	}
+	
+	void wait(){
+		done.wait(handoffs.size() * 2);
+		done.deinit();
+	}
+};
+
+template<Allocator allocator, size_t pairs>
+static void benchProducerConsumer(Benchmark& bench, size_t size){
+	ProducerConsumer workload;
+	bench.begin();
+	workload.start(allocator, pairs, size);
+	workload.wait();
+	bench.end(size / pairs * pairs * 2);
+}
+
+// Frees a random half of many mixed blocks and then allocates larger ones, which fit none of the holes.
+static void runFragmenter(Allocator allocator, size_t count){
+	Random random = {99};
+	std::vector<void*> blocks(count);
+	for(void*& block: blocks){
+		size_t size = randomBlockSize(random);
+		block = allocator(nullptr, size, 8);
+		((char*)block)[size - 1] = 1;
+	}
+	shuffle(blocks, random);
+	for(size_t i = 0; i < count / 2; i++) allocator(blocks[i], 0, 0);
+	for(size_t i = 0; i < count / 2; i++){
+		size_t size = randomBlockSize(random) * 2;
+		blocks[i] = allocator(nullptr, size, 16);
+		((char*)blocks[i])[size - 1] = 1;
+	}
+	for(void* block: blocks) allocator(block, 0, 0);
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Replay ------------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+#if defined(ZSL_LINUX)
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Runs function(result) in a forked child and copies result back. The child starts with a copy of
+// this process, and its peak resident size starts out at what is resident now.
+template<typename T, typename F>
+static bool runForked(T* result, F function){
+	int pipeEnds[2];
+	if(pipe(pipeEnds)) return false;
+	pid_t child = fork();
+	if(child == 0){
+		close(pipeEnds[0]);
+		function(result);
+		bool sent = write(pipeEnds[1], result, sizeof(T)) == sizeof(T);
+		_exit(sent ? 0 : 1);
+	}
+	close(pipeEnds[1]);
+	bool received = child > 0 && read(pipeEnds[0], result, sizeof(T)) == sizeof(T);
+	close(pipeEnds[0]);
+	if(child > 0) waitpid(child, nullptr, 0);
+	return received;
+}
+
+// Bytes from a line of /proc/self/status, like VmRSS or VmHWM.
+static uint64_t readProcessStatus(const char* field){
+	FILE* status = fopen("/proc/self/status", "r");
+	if(!status) return 0;
+	char line[256];
+	size_t length = strlen(field);
+	uint64_t kilobytes = 0;
+	while(fgets(line, sizeof(line), status)){
+		if(strncmp(line, field, length) == 0 && line[length] == ':'){
+			kilobytes = strtoull(line + length + 1, nullptr, 10);
+			break;
+		}
+	}
+	fclose(status);
+	return kilobytes * 1024;
+}
+
+// Without --trace, the replays play back the producer/consumer workload on two pairs of threads
+// running alongside the fragmenter. Recorded in a child so nalloc's pools here stay empty.
+static ArrayView<AllocationEvent> getReplayTrace(){
+	static ArrayList<AllocationEvent> trace = ArrayList<AllocationEvent>::init();
+	static bool loaded = false;
+	if(loaded) return trace;
+	loaded = true;
+	const char* path = benchmarkTracePath;
+	if(!path){
+		path = "/tmp/zsl_synthetic_allocations.trace";
+		bool recorded = false;
+		runForked(&recorded, [&](bool* result){
+			if(!allocationTraceStart(path)) return;
+			ProducerConsumer workload;
+			workload.start(tracedAlloc<nalloc>, 2, 1 << 18);
+			runFragmenter(tracedAlloc<nalloc>, 1 << 17);
+			workload.wait();
+			allocationTraceStop();
+			*result = true;
+		});
+		if(!recorded) printf("Failed to record a trace to %s.\n", path);
+	}
+	if(!loadAllocationTrace(path, trace)) printf("Failed to read the trace %s.\n", path);
+	if(!benchmarkTracePath) unlink(path);
+	return trace;
+}
+
+struct ReplayOp{
+	uint64_t size;
+	uint32_t slot;
+	// How many events on the slot come before this one.
+	uint32_t version;
+	uint32_t alignment;
+	AllocationOp op;
+};
+
+// One per block in the trace, never reused.
+struct ReplaySlot{
+	void* pointer;
+	// Events done on the block, stored with release after pointer.
+	uint32_t version;
+};
+
+struct ReplayThread{
+	Allocator allocator;
+	ReplaySlot* slots;
+	std::vector<ReplayOp> ops;
+	Semaphore* done;
+};
+
+static void replayMain(void* userData){
+	ReplayThread* thread = (ReplayThread*)userData;
+	for(ReplayOp& op: thread->ops){
+		ReplaySlot& slot = thread->slots[op.slot];
+		void* pointer = nullptr;
+		// Events depend only on earlier ones, so whoever runs the earliest pending event never waits.
+		if(op.version){
+			for(size_t spins = 0; atomicLoad(&slot.version, ORDER_ACQUIRE) != op.version; spins++) waitBriefly(spins);
+			pointer = slot.pointer;
+		}
+		pointer = thread->allocator(pointer, op.size, op.alignment);
+		// Touch every page like the traced program would have, or the memory never becomes resident.
+		for(size_t i = 0; i < op.size; i += 4096) ((char*)pointer)[i] = 1;
+		slot.pointer = pointer;
+		atomicStore(&slot.version, op.version + 1, ORDER_RELEASE);
+	}
+	thread->done->post();
+}
+
+// Plays back the first size events of the trace on threads threads, each taking the events of every
+// threads-th recorded thread in time order. A resize or free waits until the events before it on its
+// block are done, wherever they ran. Frees of blocks allocated before the trace started are skipped.
+// Reports the peak resident growth, the peak of the bytes the trace had live, and their ratio. The
+// growth doesn't count memory the allocator already held in this process, so run the replays apart
+// from the other allocator benchmarks.
+template<Allocator allocator, size_t threads>
+static void benchReplay(Benchmark& bench, size_t size){
+	ArrayView<AllocationEvent> trace = getReplayTrace();
+	size_t count = min(size, trace.size);
+	if(count == 0) return;
+	
+	std::vector<ReplayThread> replayThreads(threads);
+	std::vector<ReplaySlot> slots;
+	std::vector<uint64_t> slotSizes;
+	auto blockSlots = HashMap<uint64_t, uint32_t>::init();
+	size_t operations = 0;
+	uint64_t live = 0, peakLive = 0;
+	for(size_t i = 0; i < count; i++){
+		AllocationEvent& event = trace.data[i];
+		uint32_t slot;
+		if(event.op == ALLOCATION_ALLOC){
+			slot = (uint32_t)slots.size();
+			blockSlots.insert(event.block, slot);
+			slots.push_back({nullptr, 0});
+			slotSizes.push_back(0);
+		}else{
+			auto record = blockSlots.getRecord(event.block);
+			if(!record) continue;
+			slot = record->value;
+		}
+		replayThreads[event.thread % threads].ops.push_back({event.size, slot, slots[slot].version++, uint32_t(1) << event.alignmentShift, event.op});
+		live += event.size - slotSizes[slot];
+		slotSizes[slot] = event.size;
+		peakLive = max(peakLive, live);
+		operations++;
+	}
+	blockSlots.deinit();
+	for(ReplaySlot& slot: slots) slot.version = 0;
+	
+	uint64_t results[2] = {};// Elapsed nanoseconds, resident growth.
+	bool ran = runForked(&results, [&](uint64_t (*results)[2]){
+		uint64_t resident = readProcessStatus("VmRSS");
+		Semaphore done;
+		done.init();
+		uint64_t start = getTime();
+		for(ReplayThread& thread: replayThreads){
+			thread.allocator = allocator;
+			thread.slots = slots.data();
+			thread.done = &done;
+			threadCreate(replayMain, &thread);
+		}
+		done.wait(threads);
+		(*results)[0] = getTime() - start;
+		(*results)[1] = readProcessStatus("VmHWM") - resident;
+	});
+	if(!ran) return;
+	bench.elapsed += results[0];
+	bench.operations += operations;
+	bench.report("rss-MB", results[1] / 1048576.0);
+	bench.report("live-MB", peakLive / 1048576.0);
+	bench.report("rss/live", peakLive ? (double)results[1] / peakLive : 0.0);
+}
+
+template<Allocator allocator>
+static bool registerReplay(const char* name, bool threadSafe){
+	std::string suffix = std::string("/") + name;
+	// The arena keeps every block the trace allocates.
+	registerBenchmark("Allocator/replay/1t" + suffix, benchReplay<allocator, 1>, threadSafe ? 0 : 1 << 16);
+	if(!threadSafe) return true;
+	registerBenchmark("Allocator/replay/2t" + suffix, benchReplay<allocator, 2>);
+	registerBenchmark("Allocator/replay/4t" + suffix, benchReplay<allocator, 4>);
+	return true;
+}
+
+static bool replaysRegistered =
+	registerReplay<nalloc>("nalloc", true) &&
+	registerReplay<mallocAllocator>("malloc", true) &&
+	registerReplay<aalloc<benchmarkArena>>("arena", false);
+#endif
+
+template<Allocator allocator>
+static bool registerProducerConsumer(const char* name){
+	std::string suffix = std::string("/") + name;
+	registerBenchmark("Allocator/producer-consumer/1p" + suffix, benchProducerConsumer<allocator, 1>);
+	registerBenchmark("Allocator/producer-consumer/2p" + suffix, benchProducerConsumer<allocator, 2>);
+	registerBenchmark("Allocator/producer-consumer/4p" + suffix, benchProducerConsumer<allocator, 4>);
+	return true;
+}
+
+static bool registered =
+	registerProducerConsumer<nalloc>("nalloc") &&
+	registerProducerConsumer<mallocAllocator>("malloc");
@@ -0,0 +1,103 @@
+#include "benchmarks.h"
+#include "zsl/array_list.h"
+#include "zsl/profile.h"
+
+template<Allocator allocator>
+static void finish(){
+	if constexpr(allocator == aalloc<benchmarkArena>) benchmarkArena.reset();
+}
+
+// Allocate size blocks, then free them in random order.
+template<Allocator allocator, size_t blockSize>
+static void benchChurn(Benchmark& bench, size_t size){
+	std::vector<void*> blocks(size);
+	std::vector<uint32_t> order(size);
+	for(size_t i = 0; i < size; i++) order[i] = i;
+	Random random = {1};
+	shuffle(order, random);
+	bench.begin();
+	for(size_t i = 0; i < size; i++) blocks[i] = allocator(nullptr, blockSize, 8);
+	for(uint32_t i: order) allocator(blocks[i], 0, 0);
+	bench.end(size * 2);
+	finish<allocator>();
+}
+
+// Allocate and immediately free, the best case for every free list.
+template<Allocator allocator, size_t blockSize>
+static void benchPingPong(Benchmark& bench, size_t size){
+	bench.begin();
+	for(size_t i = 0; i < size; i++){
+		void* block = allocator(nullptr, blockSize, 8);
+		doNotOptimize(block);
+		allocator(block, 0, 0);
+	}
+	bench.end(size * 2);
+	finish<allocator>();
+}
+
+// Growing a list one element at a time, dominated by realloc and its copies.
+template<Allocator allocator>
+static void benchAppend(Benchmark& bench, size_t size){
+	bench.begin();
+	auto list = ArrayList<uint64_t, allocator>::init();
+	for(size_t i = 0; i < size; i++) list.append(i);
+	doNotOptimize(list.data[size - 1]);
+	list.deinit();
+	bench.end(size);
+	finish<allocator>();
+}
+
+// Same as benchAppend but growing in place by committing reserved pages.
+static void benchVirtualAppend(Benchmark& bench, size_t size){
+	bench.begin();
+	auto list = VirtualArrayList<uint64_t>::init(size);
+	for(size_t i = 0; i < size; i++) list.append(i);
+	doNotOptimize(list.data[size - 1]);
+	list.deinit();
+	bench.end(size);
+}
+
+// Growing one large buffer a page at a time without touching the new pages, so this is the realloc
+// cost alone. The pools copy the whole buffer each time it outgrows its class, mapped blocks are remapped.
+template<Allocator allocator>
+static void benchGrowLarge(Benchmark& bench, size_t size){
+	constexpr size_t STEP = 4096;
+	size_t bytes = NALLOC_DIRECT_SIZE;
+	char* buffer = (char*)allocator(nullptr, bytes, 8);
+	bench.begin();
+	for(size_t i = 0; i < size; i++){
+		bytes += STEP;
+		buffer = (char*)allocator(buffer, bytes, 8);
+		doNotOptimize(buffer);
+	}
+	bench.end(size);
+	allocator(buffer, 0, 0);
+	finish<allocator>();
+}
+
+// nalloc with allocation sampling on, the difference to churn/256B/nalloc is its cost.
+static void benchSampledChurn(Benchmark& bench, size_t size){
+	setAllocationSampling(512 * 1024);
+	benchChurn<nalloc, 256>(bench, size);
+	setAllocationSampling(0);
+	allocationSamplesReset();
+}
+
+template<Allocator allocator>
+static bool registerAllocator(const char* name){
+	std::string suffix = std::string("/") + name;
+	registerBenchmark("Allocator/churn/16B" + suffix, benchChurn<allocator, 16>);
+	registerBenchmark("Allocator/churn/256B" + suffix, benchChurn<allocator, 256>);
+	registerBenchmark("Allocator/churn/4KB" + suffix, benchChurn<allocator, 4096>, 1 << 20);
+	registerBenchmark("Allocator/ping-pong/64B" + suffix, benchPingPong<allocator, 64>);
+	registerBenchmark("Allocator/append" + suffix, benchAppend<allocator>);
+	registerBenchmark("Allocator/grow-large" + suffix, benchGrowLarge<allocator>, 1 << 16);
+	return true;
+}
+
+static bool registered =
+	registerAllocator<nalloc>("nalloc") &&
+	registerAllocator<mallocAllocator>("malloc") &&
+	registerAllocator<aalloc<benchmarkArena>>("arena") &&
+	registerBenchmark("Allocator/append/virtual", benchVirtualAppend) &&
+	registerBenchmark("Allocator/churn/256B/nalloc-sampled", benchSampledChurn);
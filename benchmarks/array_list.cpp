@@ -0,0 +1,42 @@
+#include "benchmarks.h"
+#include "zsl/array_list.h"
+
+BENCHMARK("ArrayList/append-one"){
+	std::vector<uint64_t> source(size, 1);
+	auto list = ArrayList<uint64_t>::init();
+	bench.begin();
+	for(int i = 0; i < 4; i++) for(uint64_t value: source) list.append(value);
+	bench.end(size * 4);
+	doNotOptimize(list.data[0]);
+	list.deinit();
+};
+
+BENCHMARK("ArrayList/append-range"){
+	std::vector<uint64_t> source(size, 1);
+	auto list = ArrayList<uint64_t>::init();
+	bench.begin();
+	for(int i = 0; i < 4; i++) list.appendRange({size, source.data()});
+	bench.end(size * 4);
+	doNotOptimize(list.data[0]);
+	list.deinit();
+};
+
+// Inserts blocks of 16 at the front, which moves the whole list every time.
+BENCHMARK("ArrayList/insert-range-front", 1 << 16){
+	uint64_t block[16] = {};
+	auto list = ArrayList<uint64_t>::init();
+	bench.begin();
+	for(size_t i = 0; i < size; i += 16) list.insertRange(0, {16, block});
+	bench.end(size);
+	list.deinit();
+};
+
+BENCHMARK("ArrayList/remove-if"){
+	auto list = ArrayList<uint64_t>::init(size);
+	Random random = {1};
+	for(size_t i = 0; i < size; i++) list.append(random.next());
+	bench.begin();
+	list.removeIf([](uint64_t value){return value & 1;});
+	bench.end(size);
+	list.deinit();
+};
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmarks.h"
+
+struct BenchmarkResult{
+	std::string name;
+	size_t size;
+	std::vector<double> samples;// Nanoseconds per operation, sorted.
+	std::vector<const char*> metricNames;
+	std::vector<std::vector<double>> metrics;// Per metric, sorted.
+	
+	static double percentile(std::vector<double>& values, double p){
+		size_t rank = (size_t)ceil(p * values.size());
+		return values[clamp(rank, size_t(1), values.size()) - 1];
+	}
+	double percentile(double p){return percentile(samples, p);}
+};
+
+static void printUsage(const char* program){
+	printf("Usage: %s [options]\n", program);
+	printf("  --filter TEXT       Only run benchmarks whose name contains TEXT.\n");
+	printf("  --min-size N        Smallest working set size (element count). Default 1024.\n");
+	printf("  --max-size N        Largest working set size. Default 524288.\n");
+	printf("  --repetitions N     Timed runs per size. Default 7.\n");
+	printf("  --warmup N          Untimed runs per size. Default 1.\n");
+	printf("  --json PATH         Also write every result to PATH as JSON.\n");
+	printf("  --trace PATH        Allocation trace for the replay benchmarks to play back.\n");
+}
+
+int main(int argc, char** argv){
+	const char* filter = "";
+	const char* jsonPath = nullptr;
+	size_t minSize = 1024;
+	size_t maxSize = 512 * 1024;
+	size_t repetitions = 7;
+	size_t warmup = 1;
+	for(int i = 1; i < argc; i++){
+		bool hasValue = i + 1 < argc;
+		if(strcmp(argv[i], "--filter") == 0 && hasValue) filter = argv[++i];
+		else if(strcmp(argv[i], "--json") == 0 && hasValue) jsonPath = argv[++i];
+		else if(strcmp(argv[i], "--trace") == 0 && hasValue) benchmarkTracePath = argv[++i];
+		else if(strcmp(argv[i], "--min-size") == 0 && hasValue) minSize = strtoull(argv[++i], nullptr, 0);
+		else if(strcmp(argv[i], "--max-size") == 0 && hasValue) maxSize = strtoull(argv[++i], nullptr, 0);
+		else if(strcmp(argv[i], "--repetitions") == 0 && hasValue) repetitions = max(strtoull(argv[++i], nullptr, 0), 1ull);
+		else if(strcmp(argv[i], "--warmup") == 0 && hasValue) warmup = strtoull(argv[++i], nullptr, 0);
+		else{
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	
+	// Step by 8x so a run covers L1, L2, LLC and main memory sized working sets.
+	std::vector<size_t> sizes;
+	for(size_t size = max(minSize, size_t(1)); size <= maxSize; size *= 8) sizes.push_back(size);
+	
+	std::vector<BenchmarkResult> results;
+	printf("%-52s %10s %10s %10s %10s %10s %10s\n", "benchmark (ns/op)", "size", "min", "median", "p90", "p99", "max");
+	for(BenchmarkInfo& info: benchmarks){
+		if(!strstr(info.name.c_str(), filter)) continue;
+		for(size_t size: sizes){
+			if(info.maxSize && size > info.maxSize) continue;
+			for(size_t i = 0; i < warmup; i++){
+				Benchmark bench = {};
+				info.func(bench, size);
+			}
+			BenchmarkResult result = {info.name, size, {}, {}, {}};
+			for(size_t i = 0; i < repetitions; i++){
+				Benchmark bench = {};
+				info.func(bench, size);
+				result.samples.push_back((double)bench.elapsed / max(bench.operations, size_t(1)));
+				for(size_t j = 0; j < bench.metricCount; j++){
+					if(j == result.metrics.size()){
+						result.metricNames.push_back(bench.metricNames[j]);
+						result.metrics.emplace_back();
+					}
+					result.metrics[j].push_back(bench.metrics[j]);
+				}
+			}
+			std::sort(result.samples.begin(), result.samples.end());
+			printf("%-52s %10zu %10.2f %10.2f %10.2f %10.2f %10.2f\n", info.name.c_str(), size,
+				result.samples.front(), result.percentile(0.5), result.percentile(0.9), result.percentile(0.99), result.samples.back());
+			if(result.metrics.size()){
+				printf("    ");
+				for(size_t j = 0; j < result.metrics.size(); j++){
+					std::sort(result.metrics[j].begin(), result.metrics[j].end());
+					printf(" %s %.3f", result.metricNames[j], BenchmarkResult::percentile(result.metrics[j], 0.5));
+				}
+				printf("\n");
+			}
+			fflush(stdout);
+			results.push_back(result);
+		}
+	}
+	
+	if(jsonPath){
+		FILE* json = fopen(jsonPath, "w");
+		if(!json){
+			printf("Failed to open %s.\n", jsonPath);
+			return 1;
+		}
+		fprintf(json, "{\"unit\":\"ns/op\",\"results\":[\n");
+		for(size_t i = 0; i < results.size(); i++){
+			BenchmarkResult& result = results[i];
+			fprintf(json, "\t{\"name\":\"%s\",\"size\":%zu,\"min\":%.3f,\"median\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f,\"samples\":[",
+				result.name.c_str(), result.size, result.samples.front(), result.percentile(0.5),
+				result.percentile(0.9), result.percentile(0.99), result.samples.back());
+			for(size_t j = 0; j < result.samples.size(); j++) fprintf(json, j ? ",%.3f" : "%.3f", result.samples[j]);
+			fprintf(json, "]");
+			if(result.metrics.size()){
+				fprintf(json, ",\"metrics\":{");
+				for(size_t j = 0; j < result.metrics.size(); j++){
+					fprintf(json, "%s\"%s\":%.3f", j ? "," : "", result.metricNames[j], BenchmarkResult::percentile(result.metrics[j], 0.5));
+				}
+				fprintf(json, "}");
+			}
+			fprintf(json, "}%s\n", i + 1 < results.size() ? "," : "");
+		}
+		fprintf(json, "]}\n");
+		fclose(json);
+	}
+	return 0;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "zsl/core.h"
+#include "zsl/clock.h"
+
+using namespace zsl;
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Harness -----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// Passed to every benchmark run. Only the code between begin() and end() is timed,
+// so setup like building the map for a lookup benchmark doesn't count.
+struct Benchmark{
+	static constexpr size_t MAX_METRICS = 4;
+	
+	uint64_t start = 0;
+	uint64_t elapsed = 0;
+	size_t operations = 0;
+	// Other numbers a run measures, like memory use, reported by their median over the repetitions.
+	const char* metricNames[MAX_METRICS];
+	double metrics[MAX_METRICS];
+	size_t metricCount = 0;
+	
+	ALWAYS_INLINE void begin(){start = getTime();}
+	ALWAYS_INLINE void end(size_t ops){elapsed += getTime() - start; operations += ops;}
+	// Every run of a benchmark must report the same metrics in the same order.
+	void report(const char* name, double value){
+		ZSL_ASSERT(metricCount < MAX_METRICS);
+		metricNames[metricCount] = name;
+		metrics[metricCount++] = value;
+	}
+};
+
+using BenchmarkFunction = void(*)(Benchmark&, size_t size);
+
+struct BenchmarkInfo{
+	std::string name;
+	BenchmarkFunction func;
+	// Largest size this benchmark makes sense for, zero means no limit.
+	size_t maxSize;
+};
+inline std::vector<BenchmarkInfo> benchmarks;
+// Set by --trace, an allocation trace for the replay benchmarks to use in place of their synthetic one.
+inline const char* benchmarkTracePath = nullptr;
+
+inline bool registerBenchmark(std::string name, BenchmarkFunction func, size_t maxSize = 0){
+	benchmarks.push_back({name, func, maxSize});
+	return true;
+}
+
+struct BenchmarkRegistrar{
+	const char* name;
+	size_t maxSize = 0;
+	bool operator<<(BenchmarkFunction func){return registerBenchmark(name, func, maxSize);}
+};
+
+// BENCHMARK("name"){...}; or BENCHMARK("name", maxSize){...};
+#define BENCHMARK(name, ...) static bool TOKEN_PASTE(benchmark, __LINE__) = BenchmarkRegistrar{name, __VA_ARGS__} << [](Benchmark& bench, size_t size) -> void
+
+// Keeps the compiler from throwing away a result we never read.
+template<typename T>
+ALWAYS_INLINE void doNotOptimize(const T& value){
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Makes a pointer opaque, so a pure function called on it can't be hoisted out of the loop.
+template<typename T>
+ALWAYS_INLINE T* hidePointer(T* pointer){
+	asm volatile("" : "+r"(pointer));
+	return pointer;
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Random ------------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+struct Random{
+	uint64_t state;
+	
+	ALWAYS_INLINE uint64_t next(){
+		// splitmix64
+		uint64_t z = (state += UINT64_C(0x9E3779B97F4A7C15));
+		z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+		z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+		return z ^ (z >> 31);
+	}
+	ALWAYS_INLINE uint64_t next(uint64_t bound){return next() % bound;}
+	ALWAYS_INLINE double nextDouble(){return (next() >> 11) * (1.0 / (UINT64_C(1) << 53));}
+};
+
+// Draws ranks in [1, n] where rank k has weight 1/k^s. Uses rejection-inversion
+// (Hörmann & Derflinger) so it needs no table, even for hundreds of millions of ranks.
+struct Zipf{
+	double n;
+	double s;
+	double hIntegralX1;
+	double hIntegralN;
+	double threshold;
+	
+	static double helper1(double x){return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));}
+	static double helper2(double x){return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3.0) * (1 + 0.25 * x));}
+	double h(double x){return exp(-s * log(x));}
+	double hIntegral(double x){double logX = log(x); return helper2((1 - s) * logX) * logX;}
+	double hIntegralInverse(double x){double t = max(x * (1 - s), -1.0); return exp(helper1(t) * x);}
+	
+	static Zipf init(size_t n, double s = 0.99){
+		Zipf zipf;
+		zipf.n = (double)n;
+		zipf.s = s;
+		zipf.hIntegralX1 = zipf.hIntegral(1.5) - 1;
+		zipf.hIntegralN = zipf.hIntegral(n + 0.5);
+		zipf.threshold = 2 - zipf.hIntegralInverse(zipf.hIntegral(2.5) - zipf.h(2));
+		return zipf;
+	}
+	
+	size_t next(Random& random){
+		while(true){
+			double u = hIntegralN + random.nextDouble() * (hIntegralX1 - hIntegralN);
+			double x = hIntegralInverse(u);
+			double k = clamp(floor(x + 0.5), 1.0, n);
+			if(k - x <= threshold || u >= hIntegral(k + 0.5) - h(k)) return (size_t)k;
+		}
+	}
+};
+
+template<typename T>
+void shuffle(std::vector<T>& values, Random& random){
+	for(size_t i = values.size(); i > 1; i--) std::swap(values[i - 1], values[random.next(i)]);
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------- Allocators ---------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// glibc malloc behind the zsl Allocator interface. Alignment above what malloc
+// guarantees is honored for fresh blocks only, realloc may drop it.
+inline void* mallocAllocator(void* ptr, size_t size, size_t alignment){
+	if(size == 0){
+		free(ptr);
+		return nullptr;
+	}
+	if(!ptr && alignment > alignof(max_align_t)) return aligned_alloc(alignment, align(size, alignment));
+	return realloc(ptr, size);
+}
+
+// Frees nothing, every benchmark run that uses it resets it when done.
+inline Arena benchmarkArena;
+inline bool benchmarkArenaReady = (benchmarkArena.init(), true);
@@ -0,0 +1,67 @@
+#include "benchmarks.h"
+#include "zsl/bitset.h"
+
+// size is in bits. ns/op is per word for whole set operations and per bit for iteration.
+static DynamicBitSet<> makeBits(size_t size, uint64_t density, uint64_t seed){
+	auto bits = DynamicBitSet<>::init(size);
+	Random random = {seed};
+	for(size_t i = 0; i < size; i++) if(random.next(density) == 0) bits.set(i);
+	return bits;
+}
+
+BENCHMARK("BitSet/count"){
+	auto bits = makeBits(size, 2, 1);
+	size_t total = 0;
+	bench.begin();
+	for(int i = 0; i < 16; i++){
+		total += bits.count();
+		doNotOptimize(total);
+	}
+	bench.end(size / 64 * 16);
+	bits.deinit();
+};
+
+BENCHMARK("BitSet/and"){
+	auto a = makeBits(size, 2, 1);
+	auto b = makeBits(size, 2, 2);
+	bench.begin();
+	for(int i = 0; i < 16; i++) a.andWith(b);
+	bench.end(size / 64 * 16);
+	a.deinit();
+	b.deinit();
+};
+
+// Sparse sets, where skipping empty words with ctz matters most.
+BENCHMARK("BitSet/iterate-sparse"){
+	auto bits = makeBits(size, 100, 1);
+	size_t total = 0;
+	bench.begin();
+	for(size_t i: bits.iterateSet()) total += i;
+	bench.end(size);
+	doNotOptimize(total);
+	bits.deinit();
+};
+
+BENCHMARK("BitSet/iterate-sparse/bit-by-bit"){
+	auto bits = makeBits(size, 100, 1);
+	size_t total = 0;
+	bench.begin();
+	for(size_t i = 0; i < size; i++) if(bits.get(i)) total += i;
+	bench.end(size);
+	doNotOptimize(total);
+	bits.deinit();
+};
+
+// ns/op is per query here.
+BENCHMARK("BitSet/select"){
+	auto bits = makeBits(size, 2, 1);
+	auto index = RankSelectIndex<>::init(bits);
+	Random random = {3};
+	size_t total = 0;
+	bench.begin();
+	for(size_t i = 0; i < 1024; i++) total += index.select(random.next(index.count()));
+	bench.end(1024);
+	doNotOptimize(total);
+	index.deinit();
+	bits.deinit();
+};
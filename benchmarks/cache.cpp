@@ -0,0 +1,123 @@
+#include "benchmarks.h"
+#include "zsl/cache.h"
+
+using IntCache = Cache<uint64_t, uint64_t>;
+
+// The obvious alternative, one lock around one map. Gives it the same interface as the cache.
+struct LockedMap{
+	Mutex mutex;
+	HashMap<uint64_t, uint64_t> map;
+	
+	void init(){
+		mutex.init();
+		map = HashMap<uint64_t, uint64_t>::init();
+	}
+	void deinit(){mutex.deinit(); map.deinit();}
+	ALWAYS_INLINE bool get(uint64_t key, uint64_t& value){
+		LockScope lock(mutex);
+		auto record = map.getRecord(key);
+		if(record) value = record->value;
+		return record;
+	}
+	ALWAYS_INLINE void put(uint64_t key, uint64_t value){
+		LockScope lock(mutex);
+		map[key] = value;
+	}
+};
+
+static std::vector<uint64_t> makeKeys(size_t size){
+	std::vector<uint64_t> keys(size);
+	Random random = {1};
+	for(uint64_t& key: keys) key = random.next();
+	return keys;
+}
+
+// Every lookup hits, ns/op is the hit path latency.
+template<typename Map>
+static void benchHit(Benchmark& bench, size_t size, Map& map){
+	std::vector<uint64_t> keys = makeKeys(size);
+	for(uint64_t key: keys) map.put(key, key);
+	Random random = {2};
+	shuffle(keys, random);
+	uint64_t sum = 0, value;
+	bench.begin();
+	for(uint64_t key: keys) if(map.get(key, value)) sum += value;
+	bench.end(size);
+	doNotOptimize(sum);
+}
+
+BENCHMARK("Cache/hit/zsl"){
+	auto cache = IntCache::init(size * IntCache::ENTRY_BYTES * 2);
+	benchHit(bench, size, cache);
+	cache.deinit();
+};
+
+BENCHMARK("Cache/hit/locked-hash-map"){
+	LockedMap map; map.init();
+	benchHit(bench, size, map);
+	map.deinit();
+};
+
+// Same lookups split across one thread per processor, ns/op is wall time per lookup.
+template<typename Map>
+static void benchHitThreads(Benchmark& bench, size_t size, Map& map){
+	struct Work{
+		Map* map;
+		uint64_t* keys;
+		size_t count;
+		Semaphore* done;
+	};
+	std::vector<uint64_t> keys = makeKeys(size);
+	for(uint64_t key: keys) map.put(key, key);
+	Random random = {2};
+	shuffle(keys, random);
+	size_t threads = getProcessorCount();
+	std::vector<Work> work(threads);
+	Semaphore done; done.init();
+	bench.begin();
+	for(size_t i = 0; i < threads; i++){
+		size_t first = size * i / threads;
+		work[i] = {&map, keys.data() + first, size * (i + 1) / threads - first, &done};
+		threadCreate([](void* userPtr){
+			Work* work = (Work*)userPtr;
+			uint64_t sum = 0, value;
+			for(size_t i = 0; i < work->count; i++) if(work->map->get(work->keys[i], value)) sum += value;
+			doNotOptimize(sum);
+			work->done->post();
+		}, &work[i]);
+	}
+	done.wait(threads);
+	bench.end(size);
+	done.deinit();
+}
+
+BENCHMARK("Cache/hit-threads/zsl"){
+	auto cache = IntCache::init(size * IntCache::ENTRY_BYTES * 2);
+	benchHitThreads(bench, size, cache);
+	cache.deinit();
+};
+
+BENCHMARK("Cache/hit-threads/locked-hash-map"){
+	LockedMap map; map.init();
+	benchHitThreads(bench, size, map);
+	map.deinit();
+};
+
+// Inserting into a cache that holds a quarter of the keys, so most puts evict.
+BENCHMARK("Cache/put-evicting"){
+	std::vector<uint64_t> keys = makeKeys(size);
+	auto cache = IntCache::init(size / 4 * IntCache::ENTRY_BYTES + 4096);
+	bench.begin();
+	for(uint64_t key: keys) cache.put(key, key);
+	bench.end(size);
+	cache.deinit();
+};
+
+BENCHMARK("Cache/put-batch-evicting"){
+	std::vector<uint64_t> keys = makeKeys(size);
+	auto cache = IntCache::init(size / 4 * IntCache::ENTRY_BYTES + 4096);
+	bench.begin();
+	cache.putBatch({size, keys.data()}, {size, keys.data()});
+	bench.end(size);
+	cache.deinit();
+};
@@ -0,0 +1,66 @@
+#include "benchmarks.h"
+#include "zsl/dense_map.h"
+
+static std::vector<uint64_t> makeKeys(size_t size){
+	std::vector<uint64_t> keys(size);
+	Random random = {1};
+	for(uint64_t& key: keys) key = random.next();
+	return keys;
+}
+
+// Fills size keys then removes all but one in keep, the way a map looks after most of a working set has
+// been retired. ns/op is per entry left.
+template<typename Map>
+static void benchIterate(Benchmark& bench, size_t size, size_t keep){
+	std::vector<uint64_t> keys = makeKeys(size);
+	auto map = Map::init();
+	for(uint64_t key: keys) map.insert(key, key);
+	for(size_t i = 0; i < size; i++) if(i % keep) map.remove(keys[i]);
+	uint64_t sum = 0;
+	size_t count = (size + keep - 1) / keep;
+	bench.begin();
+	for(uint64_t value: map.iterateValues()) sum += value;
+	bench.end(count);
+	doNotOptimize(sum);
+	map.deinit();
+}
+
+BENCHMARK("DenseMap/iterate/dense"){benchIterate<DenseMap<uint64_t, uint64_t>>(bench, size, 1);};
+BENCHMARK("DenseMap/iterate/hash-map"){benchIterate<HashMap<uint64_t, uint64_t>>(bench, size, 1);};
+BENCHMARK("DenseMap/iterate-sparse/dense"){benchIterate<DenseMap<uint64_t, uint64_t>>(bench, size, 16);};
+BENCHMARK("DenseMap/iterate-sparse/hash-map"){benchIterate<HashMap<uint64_t, uint64_t>>(bench, size, 16);};
+
+// Random hits, the price of the extra indirection through the index.
+template<typename Map>
+static void benchLookup(Benchmark& bench, size_t size){
+	std::vector<uint64_t> keys = makeKeys(size);
+	auto map = Map::init();
+	for(uint64_t key: keys) map.insert(key, key);
+	Random random = {2};
+	shuffle(keys, random);
+	uint64_t sum = 0;
+	bench.begin();
+	for(uint64_t key: keys) sum += map.get(key);
+	bench.end(size);
+	doNotOptimize(sum);
+	map.deinit();
+}
+
+BENCHMARK("DenseMap/lookup-hit/dense"){benchLookup<DenseMap<uint64_t, uint64_t>>(bench, size);};
+BENCHMARK("DenseMap/lookup-hit/hash-map"){benchLookup<HashMap<uint64_t, uint64_t>>(bench, size);};
+
+template<typename Map>
+static void benchErase(Benchmark& bench, size_t size){
+	std::vector<uint64_t> keys = makeKeys(size);
+	auto map = Map::init();
+	for(uint64_t key: keys) map.insert(key, key);
+	Random random = {3};
+	shuffle(keys, random);
+	bench.begin();
+	for(uint64_t key: keys) map.remove(key);
+	bench.end(size);
+	map.deinit();
+}
+
+BENCHMARK("DenseMap/erase/dense"){benchErase<DenseMap<uint64_t, uint64_t>>(bench, size);};
+BENCHMARK("DenseMap/erase/hash-map"){benchErase<HashMap<uint64_t, uint64_t>>(bench, size);};
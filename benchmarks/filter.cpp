@@ -0,0 +1,110 @@
+#include "benchmarks.h"
+#include "zsl/filter.h"
+#include "zsl/hash_map.h"
+
+// Lookups for keys that are mostly not in the set, the case a filter in front of a map is for.
+// Present keys are even and a query is present one time in ten.
+static std::vector<uint64_t> makePresent(size_t size){
+	std::vector<uint64_t> keys(size);
+	Random random = {1};
+	for(uint64_t& key: keys) key = random.next() & ~UINT64_C(1);
+	return keys;
+}
+
+static std::vector<uint64_t> makeQueries(std::vector<uint64_t>& present){
+	std::vector<uint64_t> queries(present.size());
+	Random random = {2};
+	for(uint64_t& query: queries) query = random.next(10) == 0 ? present[random.next(present.size())] : random.next() | 1;
+	return queries;
+}
+
+BENCHMARK("Filter/hash-map-only"){
+	std::vector<uint64_t> present = makePresent(size);
+	std::vector<uint64_t> queries = makeQueries(present);
+	auto map = HashMap<uint64_t, uint64_t>::init();
+	for(uint64_t key: present) map[key] = key;
+	size_t found = 0;
+	bench.begin();
+	for(uint64_t query: queries) found += map.getRecord(query) != nullptr;
+	bench.end(size);
+	doNotOptimize(found);
+	map.deinit();
+};
+
+BENCHMARK("Filter/bloom-then-hash-map"){
+	std::vector<uint64_t> present = makePresent(size);
+	std::vector<uint64_t> queries = makeQueries(present);
+	auto map = HashMap<uint64_t, uint64_t>::init();
+	auto filter = BloomFilter<uint64_t>::init(size);
+	for(uint64_t key: present){
+		map[key] = key;
+		filter.insert(key);
+	}
+	size_t found = 0;
+	bench.begin();
+	for(uint64_t query: queries) found += filter.contains(query) && map.getRecord(query) != nullptr;
+	bench.end(size);
+	doNotOptimize(found);
+	map.deinit();
+	filter.deinit();
+};
+
+template<typename Filter>
+static void benchContains(Benchmark& bench, size_t size, Filter& filter, std::vector<uint64_t>& queries){
+	size_t found = 0;
+	bench.begin();
+	for(uint64_t query: queries) found += filter.contains(query);
+	bench.end(size);
+	doNotOptimize(found);
+}
+
+template<typename Filter>
+static void benchBatch(Benchmark& bench, size_t size, Filter& filter, std::vector<uint64_t>& queries){
+	std::vector<uint8_t> results(size);
+	bench.begin();
+	size_t found = filter.containsBatch({size, queries.data()}, (bool*)results.data());
+	bench.end(size);
+	doNotOptimize(found);
+}
+
+BENCHMARK("Filter/bloom/contains"){
+	std::vector<uint64_t> present = makePresent(size);
+	std::vector<uint64_t> queries = makeQueries(present);
+	auto filter = BloomFilter<uint64_t>::init(size);
+	for(uint64_t key: present) filter.insert(key);
+	benchContains(bench, size, filter, queries);
+	filter.deinit();
+};
+
+BENCHMARK("Filter/bloom/batch"){
+	std::vector<uint64_t> present = makePresent(size);
+	std::vector<uint64_t> queries = makeQueries(present);
+	auto filter = BloomFilter<uint64_t>::init(size);
+	for(uint64_t key: present) filter.insert(key);
+	benchBatch(bench, size, filter, queries);
+	filter.deinit();
+};
+
+BENCHMARK("Filter/xor8/contains"){
+	std::vector<uint64_t> present = makePresent(size);
+	std::vector<uint64_t> queries = makeQueries(present);
+	auto filter = XorFilter<uint64_t>::init({size, present.data()});
+	benchContains(bench, size, filter, queries);
+	filter.deinit();
+};
+
+BENCHMARK("Filter/xor8/batch"){
+	std::vector<uint64_t> present = makePresent(size);
+	std::vector<uint64_t> queries = makeQueries(present);
+	auto filter = XorFilter<uint64_t>::init({size, present.data()});
+	benchBatch(bench, size, filter, queries);
+	filter.deinit();
+};
+
+BENCHMARK("Filter/xor8/build"){
+	std::vector<uint64_t> present = makePresent(size);
+	bench.begin();
+	auto filter = XorFilter<uint64_t>::init({size, present.data()});
+	bench.end(size);
+	filter.deinit();
+};
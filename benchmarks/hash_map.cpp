@@ -0,0 +1,250 @@
+#include <unordered_map>
+#include "benchmarks.h"
+#include "zsl/hash_map.h"
+
+// Gives every map the same interface so one workload template covers them all.
+template<typename V, Allocator allocator, typename sentinels = HashSentinels<uint64_t>>
+struct ZslMap{
+	using Map = HashMap<uint64_t, V, allocator, defaultHash<uint64_t>, defaultCompare<uint64_t>, sentinels>;
+	Map map;
+	
+	void init(){map = Map::init();}
+	void deinit(){
+		map.deinit();
+		if constexpr(allocator == aalloc<benchmarkArena>) benchmarkArena.reset();
+	}
+	ALWAYS_INLINE void upsert(uint64_t key, const V& value){map[key] = value;}
+	ALWAYS_INLINE void insert(uint64_t key, const V& value){map.insert(key, value);}
+	ALWAYS_INLINE V* find(uint64_t key){auto record = map.getRecord(key); return record ? &record->value : nullptr;}
+	ALWAYS_INLINE void erase(uint64_t key){map.remove(key);}
+};
+
+template<typename V>
+struct StdMap{
+	std::unordered_map<uint64_t, V>* map;
+	
+	void init(){map = new std::unordered_map<uint64_t, V>();}
+	void deinit(){delete map;}
+	ALWAYS_INLINE void upsert(uint64_t key, const V& value){(*map)[key] = value;}
+	ALWAYS_INLINE void insert(uint64_t key, const V& value){map->emplace(key, value);}
+	ALWAYS_INLINE V* find(uint64_t key){auto it = map->find(key); return it == map->end() ? nullptr : &it->second;}
+	ALWAYS_INLINE void erase(uint64_t key){map->erase(key);}
+};
+
+struct Value64{
+	uint64_t values[8];
+};
+
+enum class Distribution{
+	// Keys 0..n-1 accessed in order.
+	SEQUENTIAL,
+	// Random keys accessed uniformly at random.
+	UNIFORM,
+	// Random keys accessed with a Zipf(0.99) skew, a few keys take most of the traffic.
+	ZIPF,
+};
+
+static std::vector<uint64_t> makeKeys(size_t size, Distribution distribution, uint64_t seed){
+	std::vector<uint64_t> keys(size);
+	Random random = {seed};
+	for(size_t i = 0; i < size; i++) keys[i] = distribution == Distribution::SEQUENTIAL ? i : random.next();
+	return keys;
+}
+
+// Indices into the key set in the order a workload touches them.
+static std::vector<uint32_t> makeAccesses(size_t size, size_t count, Distribution distribution, uint64_t seed){
+	std::vector<uint32_t> accesses(count);
+	Random random = {seed};
+	if(distribution == Distribution::SEQUENTIAL){
+		for(size_t i = 0; i < count; i++) accesses[i] = i % size;
+	}else if(distribution == Distribution::UNIFORM){
+		for(size_t i = 0; i < count; i++) accesses[i] = random.next(size);
+	}else{
+		// Keys are random so the hottest ranks are scattered over the table.
+		Zipf zipf = Zipf::init(size);
+		for(size_t i = 0; i < count; i++) accesses[i] = zipf.next(random) - 1;
+	}
+	return accesses;
+}
+
+template<typename Map, typename V>
+static void fill(Map& map, std::vector<uint64_t>& keys){
+	map.init();
+	for(uint64_t key: keys) map.upsert(key, V{});
+}
+
+template<typename Map, typename V, Distribution distribution>
+static void benchInsert(Benchmark& bench, size_t size){
+	// Zipf inserts repeat hot keys, which makes this an upsert heavy counting workload.
+	std::vector<uint64_t> keys = makeKeys(size, distribution, 1);
+	std::vector<uint32_t> accesses = makeAccesses(size, size, distribution, 2);
+	std::vector<uint64_t> inserted(size);
+	for(size_t i = 0; i < size; i++) inserted[i] = keys[accesses[i]];
+	Map map; map.init();
+	bench.begin();
+	for(uint64_t key: inserted) map.upsert(key, V{});
+	bench.end(size);
+	map.deinit();
+}
+
+template<typename Map, typename V, Distribution distribution>
+static void benchLookupHit(Benchmark& bench, size_t size){
+	std::vector<uint64_t> keys = makeKeys(size, distribution, 1);
+	std::vector<uint32_t> accesses = makeAccesses(size, size, distribution, 2);
+	std::vector<uint64_t> lookups(size);
+	for(size_t i = 0; i < size; i++) lookups[i] = keys[accesses[i]];
+	Map map; fill<Map, V>(map, keys);
+	size_t found = 0;
+	bench.begin();
+	for(uint64_t key: lookups) found += map.find(key) != nullptr;
+	bench.end(size);
+	doNotOptimize(found);
+	map.deinit();
+}
+
+template<typename Map, typename V, Distribution distribution>
+static void benchLookupMiss(Benchmark& bench, size_t size){
+	std::vector<uint64_t> keys = makeKeys(size, distribution, 1);
+	std::vector<uint64_t> missing = makeKeys(size, distribution, 3);
+	if(distribution == Distribution::SEQUENTIAL) for(uint64_t& key: missing) key += size;
+	Map map; fill<Map, V>(map, keys);
+	size_t found = 0;
+	bench.begin();
+	for(uint64_t key: missing) found += map.find(key) != nullptr;
+	bench.end(size);
+	doNotOptimize(found);
+	map.deinit();
+}
+
+template<typename Map, typename V, Distribution distribution>
+static void benchErase(Benchmark& bench, size_t size){
+	std::vector<uint64_t> keys = makeKeys(size, distribution, 1);
+	std::vector<uint64_t> order = keys;
+	Random random = {4};
+	if(distribution != Distribution::SEQUENTIAL) shuffle(order, random);
+	Map map; fill<Map, V>(map, keys);
+	bench.begin();
+	for(uint64_t key: order) map.erase(key);
+	bench.end(size);
+	map.deinit();
+}
+
+template<typename Map, typename V, Distribution distribution>
+static void benchMixed(Benchmark& bench, size_t size){
+	// 90% lookups, 10% replace a key with a fresh one so the size stays constant.
+	std::vector<uint64_t> keys = makeKeys(size, distribution, 1);
+	std::vector<uint32_t> accesses = makeAccesses(size, size, distribution, 2);
+	std::vector<uint64_t> fresh = makeKeys(size, Distribution::UNIFORM, 5);
+	if(distribution == Distribution::SEQUENTIAL) for(size_t i = 0; i < size; i++) fresh[i] = size + i;
+	std::vector<uint8_t> operations(size);
+	Random random = {6};
+	for(uint8_t& operation: operations) operation = random.next(10) == 0;
+	Map map; fill<Map, V>(map, keys);
+	size_t found = 0;
+	bench.begin();
+	for(size_t i = 0; i < size; i++){
+		uint64_t& key = keys[accesses[i]];
+		if(operations[i]){
+			map.erase(key);
+			key = fresh[i];
+			map.insert(key, V{});
+		}else{
+			found += map.find(key) != nullptr;
+		}
+	}
+	bench.end(size);
+	doNotOptimize(found);
+	map.deinit();
+}
+
+template<typename Map, typename V>
+static bool registerMap(const char* name, const char* valueName){
+	const char* distributionNames[] = {"sequential", "uniform", "zipf"};
+	auto suffix = [&](size_t distribution){return std::string(distributionNames[distribution]) + "/" + name + "/" + valueName;};
+#define REGISTER_WORKLOADS(dist) \
+		registerBenchmark("HashMap/insert/" + suffix((size_t)dist), benchInsert<Map, V, dist>); \
+		registerBenchmark("HashMap/lookup-hit/" + suffix((size_t)dist), benchLookupHit<Map, V, dist>); \
+		registerBenchmark("HashMap/lookup-miss/" + suffix((size_t)dist), benchLookupMiss<Map, V, dist>); \
+		registerBenchmark("HashMap/mixed/" + suffix((size_t)dist), benchMixed<Map, V, dist>)
+	REGISTER_WORKLOADS(Distribution::SEQUENTIAL);
+	REGISTER_WORKLOADS(Distribution::UNIFORM);
+	REGISTER_WORKLOADS(Distribution::ZIPF);
+#undef REGISTER_WORKLOADS
+	// Every key is erased exactly once so the skew makes no difference here.
+	registerBenchmark("HashMap/erase/" + suffix((size_t)Distribution::SEQUENTIAL), benchErase<Map, V, Distribution::SEQUENTIAL>);
+	registerBenchmark("HashMap/erase/" + suffix((size_t)Distribution::UNIFORM), benchErase<Map, V, Distribution::UNIFORM>);
+	return true;
+}
+
+static bool registered =
+	registerMap<ZslMap<uint64_t, nalloc>, uint64_t>("zsl-nalloc", "8B") &&
+	registerMap<ZslMap<uint64_t, mallocAllocator>, uint64_t>("zsl-malloc", "8B") &&
+	registerMap<ZslMap<uint64_t, aalloc<benchmarkArena>>, uint64_t>("zsl-arena", "8B") &&
+	registerMap<ZslMap<uint64_t, nalloc, MaxSentinels<uint64_t>>, uint64_t>("zsl-sentinel", "8B") &&
+	registerMap<StdMap<uint64_t>, uint64_t>("std", "8B") &&
+	registerMap<ZslMap<Value64, nalloc>, Value64>("zsl-nalloc", "64B") &&
+	registerMap<ZslMap<Value64, mallocAllocator>, Value64>("zsl-malloc", "64B") &&
+	registerMap<ZslMap<Value64, aalloc<benchmarkArena>>, Value64>("zsl-arena", "64B") &&
+	registerMap<StdMap<Value64>, Value64>("std", "64B");
+
+// Building a map from arrays of keys and values, one insert at a time against buildFrom on every processor.
+BENCHMARK("HashMap/build/insert"){
+	std::vector<uint64_t> keys = makeKeys(size, Distribution::UNIFORM, 1);
+	bench.begin();
+	auto map = HashMap<uint64_t, uint64_t>::init();
+	for(uint64_t key: keys) map.insert(key, key);
+	bench.end(size);
+	map.deinit();
+};
+
+BENCHMARK("HashMap/build/buildFrom"){
+	std::vector<uint64_t> keys = makeKeys(size, Distribution::UNIFORM, 1);
+	bench.begin();
+	auto map = HashMap<uint64_t, uint64_t>::buildFrom({size, keys.data()}, {size, keys.data()});
+	bench.end(size);
+	map.deinit();
+};
+
+// Doubling the capacity of a full map, ns/op is per entry.
+BENCHMARK("HashMap/rehash/in-place"){
+	std::vector<uint64_t> keys = makeKeys(size, Distribution::UNIFORM, 1);
+	auto map = HashMap<uint64_t, uint64_t>::buildFrom({size, keys.data()}, {size, keys.data()});
+	bench.begin();
+	map.rehash(map.capacity * 2);
+	bench.end(size);
+	map.deinit();
+};
+
+BENCHMARK("HashMap/rehash/parallel"){
+	std::vector<uint64_t> keys = makeKeys(size, Distribution::UNIFORM, 1);
+	auto map = HashMap<uint64_t, uint64_t>::buildFrom({size, keys.data()}, {size, keys.data()});
+	bench.begin();
+	map.rehashParallel(map.capacity * 2);
+	bench.end(size);
+	map.deinit();
+};
+
+// A long running map at a constant size: every operation replaces a key and looks up a missing one.
+// Without maintenance the tombstones the removes leave behind pile up until misses probe most of the table.
+template<typename maintenance>
+static void benchChurn(Benchmark& bench, size_t size){
+	using Map = HashMap<uint64_t, uint64_t, nalloc, defaultHash<uint64_t>, defaultCompare<uint64_t>, HashSentinels<uint64_t>, maintenance>;
+	std::vector<uint64_t> keys = makeKeys(size * 5, Distribution::UNIFORM, 1);
+	std::vector<uint64_t> missing = makeKeys(size * 4, Distribution::UNIFORM, 3);
+	auto map = Map::init();
+	for(size_t i = 0; i < size; i++) map.insert(keys[i], i);
+	size_t found = 0;
+	bench.begin();
+	for(size_t i = 0; i < size * 4; i++){
+		map.remove(keys[i]);
+		map.insert(keys[i + size], i);
+		found += map.has(missing[i]);
+	}
+	bench.end(size * 4);
+	doNotOptimize(found);
+	map.deinit();
+}
+
+static bool registeredChurn =
+	registerBenchmark("HashMap/churn/maintained", benchChurn<DefaultHashMaintenance>) &&
+	registerBenchmark("HashMap/churn/unmaintained", benchChurn<NoHashMaintenance>);
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include "benchmarks.h"
+#include "zsl/interner.h"
+
+// Metric style names, a few hundred distinct ones repeated in random order.
+static std::vector<std::string> makeNames(size_t size){
+	static const char* PARTS[] = {"http", "db", "cache", "queue", "rpc", "disk"};
+	static const char* FIELDS[] = {"requests.count", "latency.p99", "errors.total", "bytes.sent", "connections.open"};
+	std::vector<std::string> names(size);
+	Random random = {1};
+	char buffer[64];
+	for(std::string& name: names){
+		snprintf(buffer, sizeof(buffer), "service.%s.%u.%s", PARTS[random.next(RAW_ARRAY_SIZE(PARTS))],
+			(unsigned)random.next(16), FIELDS[random.next(RAW_ARRAY_SIZE(FIELDS))]);
+		name = buffer;
+	}
+	return names;
+}
+
+static std::vector<StringView> makeViews(std::vector<std::string>& names){
+	std::vector<StringView> views(names.size());
+	for(size_t i = 0; i < names.size(); i++) views[i] = StringView::init(names[i].data(), names[i].size());
+	return views;
+}
+
+// Looking up names that are already interned, the steady state of a metrics pipeline.
+BENCHMARK("Interner/intern-hit"){
+	std::vector<std::string> names = makeNames(size);
+	std::vector<StringView> views = makeViews(names);
+	Interner interner;
+	interner.init();
+	for(StringView view: views) interner.intern(view);
+	uint64_t sum = 0;
+	bench.begin();
+	for(StringView view: views) sum += interner.intern(view);
+	bench.end(size);
+	doNotOptimize(sum);
+	interner.deinit();
+};
+
+BENCHMARK("Interner/intern-hit-batch"){
+	std::vector<std::string> names = makeNames(size);
+	std::vector<StringView> views = makeViews(names);
+	std::vector<InternId> ids(size);
+	Interner interner;
+	interner.init();
+	for(StringView view: views) interner.intern(view);
+	bench.begin();
+	interner.intern({size, views.data()}, ids.data());
+	bench.end(size);
+	doNotOptimize(ids[size - 1]);
+	interner.deinit();
+};
+
+// Checking each name against the previous one, by content and by id.
+BENCHMARK("Interner/compare/strings"){
+	std::vector<std::string> names = makeNames(size);
+	std::vector<StringView> views = makeViews(names);
+	size_t equal = 0;
+	bench.begin();
+	for(size_t i = 1; i < size; i++) equal += views[i].compare(views[i - 1]);
+	bench.end(size);
+	doNotOptimize(equal);
+};
+
+BENCHMARK("Interner/compare/ids"){
+	std::vector<std::string> names = makeNames(size);
+	std::vector<StringView> views = makeViews(names);
+	std::vector<InternId> ids(size);
+	Interner interner;
+	interner.init();
+	interner.intern({size, views.data()}, ids.data());
+	size_t equal = 0;
+	bench.begin();
+	for(size_t i = 1; i < size; i++) equal += ids[i] == ids[i - 1];
+	bench.end(size);
+	doNotOptimize(equal);
+	interner.deinit();
+};
+
+// Keying a map by name against keying it by id.
+BENCHMARK("Interner/map-lookup/strings"){
+	std::vector<std::string> names = makeNames(size);
+	std::vector<StringView> views = makeViews(names);
+	auto map = HashMap<StringView, uint64_t>::init();
+	for(StringView view: views) map[view]++;
+	uint64_t sum = 0;
+	bench.begin();
+	for(StringView view: views) sum += map.get(view);
+	bench.end(size);
+	doNotOptimize(sum);
+	map.deinit();
+};
+
+BENCHMARK("Interner/map-lookup/ids"){
+	std::vector<std::string> names = makeNames(size);
+	std::vector<StringView> views = makeViews(names);
+	std::vector<InternId> ids(size);
+	Interner interner;
+	interner.init();
+	interner.intern({size, views.data()}, ids.data());
+	auto map = HashMap<InternId, uint64_t>::init();
+	for(InternId id: ids) map[id]++;
+	uint64_t sum = 0;
+	bench.begin();
+	for(InternId id: ids) sum += map.get(id);
+	bench.end(size);
+	doNotOptimize(sum);
+	map.deinit();
+	interner.deinit();
+};
@@ -0,0 +1,119 @@
+#include <map>
+#include "benchmarks.h"
+#include "zsl/ordered_map.h"
+
+// Gives both maps the same interface, like the maps in hash_map.cpp.
+struct ZslOrderedMap{
+	OrderedMap<uint64_t, uint64_t> map;
+	
+	void init(){map = OrderedMap<uint64_t, uint64_t>::init();}
+	void deinit(){map.deinit();}
+	ALWAYS_INLINE void insert(uint64_t key, uint64_t value){map[key] = value;}
+	ALWAYS_INLINE uint64_t* find(uint64_t key){return map.find(key);}
+	ALWAYS_INLINE void erase(uint64_t key){map.remove(key);}
+	ALWAYS_INLINE uint64_t scan(uint64_t first, size_t count){
+		uint64_t sum = 0;
+		for(auto it = map.lowerBound(first); it != map.end() && count; ++it, count--) sum += (*it).value;
+		return sum;
+	}
+};
+
+struct StdOrderedMap{
+	std::map<uint64_t, uint64_t>* map;
+	
+	void init(){map = new std::map<uint64_t, uint64_t>();}
+	void deinit(){delete map;}
+	ALWAYS_INLINE void insert(uint64_t key, uint64_t value){(*map)[key] = value;}
+	ALWAYS_INLINE uint64_t* find(uint64_t key){auto it = map->find(key); return it == map->end() ? nullptr : &it->second;}
+	ALWAYS_INLINE void erase(uint64_t key){map->erase(key);}
+	ALWAYS_INLINE uint64_t scan(uint64_t first, size_t count){
+		uint64_t sum = 0;
+		for(auto it = map->lower_bound(first); it != map->end() && count; ++it, count--) sum += it->second;
+		return sum;
+	}
+};
+
+static std::vector<uint64_t> makeKeys(size_t size, bool sequential){
+	std::vector<uint64_t> keys(size);
+	Random random = {1};
+	for(size_t i = 0; i < size; i++) keys[i] = sequential ? i : random.next();
+	return keys;
+}
+
+template<typename Map, bool sequential>
+static void benchInsert(Benchmark& bench, size_t size){
+	std::vector<uint64_t> keys = makeKeys(size, sequential);
+	Map map; map.init();
+	bench.begin();
+	for(uint64_t key: keys) map.insert(key, key);
+	bench.end(size);
+	map.deinit();
+}
+
+template<typename Map>
+static void benchLookup(Benchmark& bench, size_t size){
+	std::vector<uint64_t> keys = makeKeys(size, false);
+	Map map; map.init();
+	for(uint64_t key: keys) map.insert(key, key);
+	Random random = {2};
+	shuffle(keys, random);
+	size_t found = 0;
+	bench.begin();
+	for(uint64_t key: keys) found += map.find(key) != nullptr;
+	bench.end(size);
+	doNotOptimize(found);
+	map.deinit();
+}
+
+// Sums the 64 entries following a random key, ns/op is per entry visited.
+template<typename Map>
+static void benchScan(Benchmark& bench, size_t size){
+	constexpr size_t SCAN = 64;
+	std::vector<uint64_t> keys = makeKeys(size, false);
+	Map map; map.init();
+	for(uint64_t key: keys) map.insert(key, key);
+	size_t scans = size / SCAN + 1;
+	uint64_t sum = 0;
+	bench.begin();
+	for(size_t i = 0; i < scans; i++){
+		sum += map.scan(keys[i], SCAN);
+		doNotOptimize(sum);
+	}
+	bench.end(scans * SCAN);
+	map.deinit();
+}
+
+template<typename Map>
+static void benchErase(Benchmark& bench, size_t size){
+	std::vector<uint64_t> keys = makeKeys(size, false);
+	Map map; map.init();
+	for(uint64_t key: keys) map.insert(key, key);
+	Random random = {3};
+	shuffle(keys, random);
+	bench.begin();
+	for(uint64_t key: keys) map.erase(key);
+	bench.end(size);
+	map.deinit();
+}
+
+template<typename Map>
+static bool registerMap(const char* name){
+	registerBenchmark(std::string("OrderedMap/insert/sequential/") + name, benchInsert<Map, true>);
+	registerBenchmark(std::string("OrderedMap/insert/uniform/") + name, benchInsert<Map, false>);
+	registerBenchmark(std::string("OrderedMap/lookup/") + name, benchLookup<Map>);
+	registerBenchmark(std::string("OrderedMap/scan/") + name, benchScan<Map>);
+	registerBenchmark(std::string("OrderedMap/erase/") + name, benchErase<Map>);
+	return true;
+}
+
+static bool registered = registerMap<ZslOrderedMap>("zsl") && registerMap<StdOrderedMap>("std");
+
+// Building from sorted records, against inserting the same records in order.
+BENCHMARK("OrderedMap/bulk-load/zsl"){
+	std::vector<OrderedMap<uint64_t, uint64_t>::Record> records(size);
+	for(size_t i = 0; i < size; i++) records[i] = {i * 3, i};
+	bench.begin();
+	auto map = OrderedMap<uint64_t, uint64_t>::init({size, records.data()});
+	bench.end(size);
+	map.deinit();
+};
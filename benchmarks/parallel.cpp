@@ -0,0 +1,116 @@
+#include "benchmarks.h"
+#include "zsl/parallel.h"
+#include "zsl/atomics.h"
+
+// Columns of doubles, like the computations these loops are meant for.
+static std::vector<double> makeColumn(size_t size){
+	std::vector<double> column(size);
+	Random random = {1};
+	for(double& value: column) value = (double)random.next(1000000) / 1000;
+	return column;
+}
+
+BENCHMARK("Parallel/reduce/serial"){
+	std::vector<double> column = makeColumn(size);
+	bench.begin();
+	double sum = 0;
+	for(double value: column) sum += value;
+	bench.end(size);
+	doNotOptimize(sum);
+};
+
+BENCHMARK("Parallel/reduce/pool"){
+	std::vector<double> column = makeColumn(size);
+	bench.begin();
+	double sum = parallelReduce(ArrayView<double>{size, column.data()}, 0.0);
+	bench.end(size);
+	doNotOptimize(sum);
+};
+
+BENCHMARK("Parallel/transform/serial"){
+	std::vector<double> column = makeColumn(size), result(size);
+	bench.begin();
+	for(size_t i = 0; i < size; i++) result[i] = column[i] * 1.08 + 2.5;
+	bench.end(size);
+	doNotOptimize(result.data());
+};
+
+BENCHMARK("Parallel/transform/pool"){
+	std::vector<double> column = makeColumn(size), result(size);
+	bench.begin();
+	parallelTransform(ArrayView<double>{size, column.data()}, result.data(), [](double value){return value * 1.08 + 2.5;});
+	bench.end(size);
+	doNotOptimize(result.data());
+};
+
+BENCHMARK("Parallel/scan/serial"){
+	std::vector<double> column = makeColumn(size), result(size);
+	bench.begin();
+	double total = 0;
+	for(size_t i = 0; i < size; i++) result[i] = total += column[i];
+	bench.end(size);
+	doNotOptimize(result.data());
+};
+
+BENCHMARK("Parallel/scan/pool"){
+	std::vector<double> column = makeColumn(size), result(size);
+	bench.begin();
+	parallelInclusiveScan(ArrayView<double>{size, column.data()}, result.data());
+	bench.end(size);
+	doNotOptimize(result.data());
+};
+
+BENCHMARK("Parallel/filter/serial"){
+	std::vector<double> column = makeColumn(size), result(size);
+	bench.begin();
+	size_t count = 0;
+	for(double value: column) if(value < 500) result[count++] = value;
+	bench.end(size);
+	doNotOptimize(count);
+};
+
+BENCHMARK("Parallel/filter/pool"){
+	std::vector<double> column = makeColumn(size), result(size);
+	bench.begin();
+	size_t count = parallelFilter(ArrayView<double>{size, column.data()}, result.data(), [](double value){return value < 500;});
+	bench.end(size);
+	doNotOptimize(count);
+};
+
+// The cost of handing one small task to each thread, on the pool and on freshly started threads.
+BENCHMARK("Parallel/dispatch/pool", 1 << 13){
+	size_t threads = getParallelThreadCount();
+	size_t sum = 0;
+	bench.begin();
+	for(size_t i = 0; i < size; i++) parallelFor(threads, [&](size_t task){atomicAdd(&sum, task);});
+	bench.end(size);
+	doNotOptimize(sum);
+};
+
+BENCHMARK("Parallel/dispatch/spawn", 1 << 13){
+	struct Task{
+		size_t* sum;
+		size_t index;
+		Semaphore* done;
+	};
+	size_t threads = getParallelThreadCount();
+	std::vector<Task> tasks(threads);
+	Semaphore done;
+	done.init();
+	size_t sum = 0;
+	bench.begin();
+	for(size_t i = 0; i < size; i++){
+		for(size_t task = 0; task < threads; task++){
+			tasks[task] = {&sum, task, &done};
+			threadCreate([](void* userData){
+				Task* task = (Task*)userData;
+				atomicAdd(task->sum, task->index);
+				task->done->post();
+			}, &tasks[task]);
+		}
+		done.wait(threads);
+	}
+	bench.end(size);
+	doNotOptimize(sum);
+	done.deinit();
+};
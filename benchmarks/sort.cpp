@@ -0,0 +1,84 @@
+#include "benchmarks.h"
+#include "zsl/sort.h"
+
+static std::vector<uint64_t> makeValues(size_t size){
+	std::vector<uint64_t> values(size);
+	Random random = {1};
+	for(uint64_t& value: values) value = random.next();
+	return values;
+}
+
+BENCHMARK("Sort/pdq"){
+	std::vector<uint64_t> values = makeValues(size);
+	bench.begin();
+	sort(ArrayView<uint64_t>{size, values.data()});
+	bench.end(size);
+};
+
+BENCHMARK("Sort/radix"){
+	std::vector<uint64_t> values = makeValues(size);
+	std::vector<uint64_t> scratch(size);
+	bench.begin();
+	radixSort(ArrayView<uint64_t>{size, values.data()}, ArrayView<uint64_t>{size, scratch.data()});
+	bench.end(size);
+};
+
+BENCHMARK("Sort/parallel"){
+	std::vector<uint64_t> values = makeValues(size);
+	bench.begin();
+	parallelSort(ArrayView<uint64_t>{size, values.data()});
+	bench.end(size);
+};
+
+BENCHMARK("Sort/std"){
+	std::vector<uint64_t> values = makeValues(size);
+	bench.begin();
+	std::sort(values.begin(), values.end());
+	bench.end(size);
+};
+
+// Gives every search the same interface, like the maps in hash_map.cpp.
+struct LowerBoundSearch{
+	ArrayView<uint64_t> values;
+	
+	void init(std::vector<uint64_t>& sorted){values = {sorted.size(), sorted.data()};}
+	void deinit(){}
+	ALWAYS_INLINE size_t find(uint64_t key){return lowerBound(values, key);}
+};
+
+struct EytzingerSearch{
+	EytzingerArray<uint64_t> eytzinger;
+	
+	void init(std::vector<uint64_t>& sorted){eytzinger = EytzingerArray<uint64_t>::init({sorted.size(), sorted.data()});}
+	void deinit(){eytzinger.deinit();}
+	ALWAYS_INLINE size_t find(uint64_t key){return (size_t)eytzinger.lowerBound(key);}
+};
+
+struct StdSearch{
+	std::vector<uint64_t>* values;
+	
+	void init(std::vector<uint64_t>& sorted){values = &sorted;}
+	void deinit(){}
+	ALWAYS_INLINE size_t find(uint64_t key){return std::lower_bound(values->begin(), values->end(), key) - values->begin();}
+};
+
+// Searches for size random keys, half of which are present.
+template<typename Search>
+static void benchSearch(Benchmark& bench, size_t size){
+	std::vector<uint64_t> values = makeValues(size);
+	std::sort(values.begin(), values.end());
+	std::vector<uint64_t> keys = makeValues(size);
+	for(size_t i = 0; i < size; i += 2) keys[i] = values[keys[i] % size];
+	Search search; search.init(values);
+	size_t found = 0;
+	bench.begin();
+	for(uint64_t key: keys) found += search.find(key);
+	bench.end(size);
+	doNotOptimize(found);
+	search.deinit();
+}
+
+static bool registered =
+	registerBenchmark("Search/lower-bound", benchSearch<LowerBoundSearch>) &&
+	registerBenchmark("Search/eytzinger", benchSearch<EytzingerSearch>) &&
+	registerBenchmark("Search/std", benchSearch<StdSearch>);
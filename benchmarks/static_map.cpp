@@ -0,0 +1,100 @@
+#include "benchmarks.h"
+#include "zsl/static_map.h"
+#include "zsl/hash_map.h"
+
+static constexpr StaticMapEntry<StringView, int> KEYWORDS[] = {
+	{"alignas", 0}, {"alignof", 1}, {"and", 2}, {"asm", 3}, {"auto", 4}, {"bool", 5}, {"break", 6}, {"case", 7},
+	{"catch", 8}, {"char", 9}, {"class", 10}, {"const", 11}, {"constexpr", 12}, {"const_cast", 13}, {"continue", 14},
+	{"decltype", 15}, {"default", 16}, {"delete", 17}, {"do", 18}, {"double", 19}, {"dynamic_cast", 20}, {"else", 21},
+	{"enum", 22}, {"explicit", 23}, {"export", 24}, {"extern", 25}, {"false", 26}, {"float", 27}, {"for", 28},
+	{"friend", 29}, {"goto", 30}, {"if", 31}, {"inline", 32}, {"int", 33}, {"long", 34}, {"mutable", 35},
+	{"namespace", 36}, {"new", 37}, {"noexcept", 38}, {"not", 39}, {"nullptr", 40}, {"operator", 41}, {"or", 42},
+	{"private", 43}, {"protected", 44}, {"public", 45}, {"register", 46}, {"reinterpret_cast", 47}, {"return", 48},
+	{"short", 49}, {"signed", 50}, {"sizeof", 51}, {"static", 52}, {"static_assert", 53}, {"static_cast", 54},
+	{"struct", 55}, {"switch", 56}, {"template", 57}, {"this", 58}, {"thread_local", 59}, {"throw", 60}, {"true", 61},
+	{"try", 62}, {"typedef", 63}, {"typeid", 64}, {"typename", 65}, {"union", 66}, {"unsigned", 67}, {"using", 68},
+	{"virtual", 69}, {"void", 70}, {"volatile", 71}, {"wchar_t", 72}, {"while", 73}, {"xor", 74},
+};
+
+static constexpr auto KEYWORD_MAP = makeStaticMap(KEYWORDS);
+
+// Words as a lexer sees them, half keywords and half identifiers.
+static std::vector<StringView> makeWords(size_t size){
+	static const char* IDENTIFIERS[] = {"i", "size", "data", "capacity", "getRecord", "value", "x", "result", "buffer", "key"};
+	std::vector<StringView> words(size);
+	Random random = {1};
+	for(StringView& word: words){
+		if(random.next(2)) word = toStaticKey<StringView>(KEYWORDS[random.next(RAW_ARRAY_SIZE(KEYWORDS))].key);
+		else word = StringView::init(IDENTIFIERS[random.next(RAW_ARRAY_SIZE(IDENTIFIERS))]);
+	}
+	return words;
+}
+
+BENCHMARK("StaticMap/keywords/static"){
+	std::vector<StringView> words = makeWords(size);
+	int sum = 0;
+	bench.begin();
+	for(StringView word: words) sum += KEYWORD_MAP.get(word, -1);
+	bench.end(size);
+	doNotOptimize(sum);
+};
+
+BENCHMARK("StaticMap/keywords/hash-map"){
+	std::vector<StringView> words = makeWords(size);
+	auto map = HashMap<StringView, int>::init();
+	for(auto& entry: KEYWORDS) map.insert(toStaticKey<StringView>(entry.key), entry.value);
+	int sum = 0;
+	bench.begin();
+	for(StringView word: words){
+		auto record = map.getRecord(word);
+		sum += record ? record->value : -1;
+	}
+	bench.end(size);
+	doNotOptimize(sum);
+	map.deinit();
+};
+
+// An opcode style table of 1000 sparse integer keys, looked up with three hits to every miss.
+struct OpcodeEntries{
+	StaticMapEntry<uint32_t, uint32_t> entries[1000];
+};
+
+static constexpr OpcodeEntries makeOpcodeEntries(){
+	OpcodeEntries opcodes = {};
+	for(uint32_t i = 0; i < 1000; i++) opcodes.entries[i] = {uint32_t(mixHash(i)), i};
+	return opcodes;
+}
+
+static constexpr OpcodeEntries OPCODE_ENTRIES = makeOpcodeEntries();
+static constexpr auto OPCODE_MAP = makeStaticMap(OPCODE_ENTRIES.entries);
+
+static std::vector<uint32_t> makeOpcodes(size_t size){
+	std::vector<uint32_t> opcodes(size);
+	Random random = {2};
+	for(uint32_t& opcode: opcodes) opcode = random.next(4) ? OPCODE_ENTRIES.entries[random.next(1000)].key : (uint32_t)random.next();
+	return opcodes;
+}
+
+BENCHMARK("StaticMap/opcodes/static"){
+	std::vector<uint32_t> opcodes = makeOpcodes(size);
+	uint32_t sum = 0;
+	bench.begin();
+	for(uint32_t opcode: opcodes) sum += OPCODE_MAP.get(opcode, 0);
+	bench.end(size);
+	doNotOptimize(sum);
+};
+
+BENCHMARK("StaticMap/opcodes/hash-map"){
+	std::vector<uint32_t> opcodes = makeOpcodes(size);
+	auto map = HashMap<uint32_t, uint32_t>::init();
+	for(auto& entry: OPCODE_ENTRIES.entries) map.insert(entry.key, entry.value);
+	uint32_t sum = 0;
+	bench.begin();
+	for(uint32_t opcode: opcodes){
+		auto record = map.getRecord(opcode);
+		sum += record ? record->value : 0;
+	}
+	bench.end(size);
+	doNotOptimize(sum);
+	map.deinit();
+};
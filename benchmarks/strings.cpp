@@ -0,0 +1,127 @@
+#include <string.h>
+#include <string_view>
+#include "benchmarks.h"
+#include "zsl/string_utils.h"
+
+// size bytes of lowercase text with nothing to find until the last few bytes.
+static std::vector<char> makeText(size_t size){
+	// Room for the marker even with --min-size below it, the benchmarks still only scan size bytes.
+	size = max(size, size_t(4));
+	std::vector<char> text(size + 1);
+	Random random = {1};
+	for(size_t i = 0; i < size; i++) text[i] = 'a' + random.next(20);
+	memcpy(text.data() + size - 4, "xyz;", 4);
+	text[size] = '\0';
+	return text;
+}
+
+// Every benchmark scans the whole text a few times, so ns/op is per byte. The libc functions are
+// pure, so without hidePointer the compiler calls them once and reuses the result.
+static constexpr size_t SCANS = 8;
+
+BENCHMARK("String/length"){
+	std::vector<char> text = makeText(size);
+	size_t total = 0;
+	bench.begin();
+	for(size_t i = 0; i < SCANS; i++){
+		total += stringLength(hidePointer(text.data()) + (i & 1));
+		doNotOptimize(total);
+	}
+	bench.end(size * SCANS);
+};
+
+BENCHMARK("String/length/libc"){
+	std::vector<char> text = makeText(size);
+	size_t total = 0;
+	bench.begin();
+	for(size_t i = 0; i < SCANS; i++){
+		total += strlen(hidePointer(text.data()) + (i & 1));
+		doNotOptimize(total);
+	}
+	bench.end(size * SCANS);
+};
+
+BENCHMARK("String/find-byte"){
+	std::vector<char> text = makeText(size);
+	const char* found = nullptr;
+	bench.begin();
+	for(size_t i = 0; i < SCANS; i++){
+		found = findByte(hidePointer(text.data()), size, ';');
+		doNotOptimize(found);
+	}
+	bench.end(size * SCANS);
+};
+
+BENCHMARK("String/find-byte/libc"){
+	std::vector<char> text = makeText(size);
+	const void* found = nullptr;
+	bench.begin();
+	for(size_t i = 0; i < SCANS; i++){
+		found = memchr(hidePointer(text.data()), ';', size);
+		doNotOptimize(found);
+	}
+	bench.end(size * SCANS);
+};
+
+BENCHMARK("String/find-any"){
+	std::vector<char> text = makeText(size);
+	const char* found = nullptr;
+	bench.begin();
+	for(size_t i = 0; i < SCANS; i++){
+		found = findAnyByte(hidePointer(text.data()), size, ";,\t\n", 4);
+		doNotOptimize(found);
+	}
+	bench.end(size * SCANS);
+};
+
+BENCHMARK("String/find-any/libc"){
+	std::vector<char> text = makeText(size);
+	size_t found = 0;
+	bench.begin();
+	for(size_t i = 0; i < SCANS; i++){
+		found = strcspn(hidePointer(text.data()), ";,\t\n");
+		doNotOptimize(found);
+	}
+	bench.end(size * SCANS);
+};
+
+BENCHMARK("String/find"){
+	std::vector<char> text = makeText(size);
+	const char* found = nullptr;
+	bench.begin();
+	for(size_t i = 0; i < SCANS; i++){
+		found = findBytes(hidePointer(text.data()), size, "xyz;", 4);
+		doNotOptimize(found);
+	}
+	bench.end(size * SCANS);
+};
+
+BENCHMARK("String/find/libc"){
+	std::vector<char> text = makeText(size);
+	const void* found = nullptr;
+	bench.begin();
+	for(size_t i = 0; i < SCANS; i++){
+		found = memmem(hidePointer(text.data()), size, "xyz;", 4);
+		doNotOptimize(found);
+	}
+	bench.end(size * SCANS);
+};
+
+// Hashes keys of 4 to 67 bytes, so ns/op is per key.
+BENCHMARK("String/hash"){
+	std::vector<char> text = makeText(size + 64);
+	uint64_t total = 0;
+	bench.begin();
+	for(size_t i = 0; i < size; i++) total += hashBytes(text.data() + i, 4 + (i & 63));
+	bench.end(size);
+	doNotOptimize(total);
+};
+
+BENCHMARK("String/hash/std"){
+	std::vector<char> text = makeText(size + 64);
+	uint64_t total = 0;
+	bench.begin();
+	for(size_t i = 0; i < size; i++) total += std::hash<std::string_view>()(std::string_view(text.data() + i, 4 + (i & 63)));
+	bench.end(size);
+	doNotOptimize(total);
+};
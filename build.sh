@@ -2,9 +2,10 @@
 
 clear
 
-while getopts "ird" opt; do case "$opt" in
+while getopts "irbd" opt; do case "$opt" in
 	i) INIT=true ;;
 	r) RUN=true ;;
+	b) BENCH=true ;;
 	d) DEBUG=true ;;
 	*) exit 1 ;;
 esac; done
@@ -25,8 +26,8 @@ if [[ ${INIT} = true ]]; then
 		printf "\033[0;36mGenerating ${1} build...\033[0m\n"
 		cmake "-G${GENERATOR_NAME}" "-Bbin/${1}" -H. "${@:2}" || exit 1
 	}
-	generate debug -DCMAKE_BUILD_TYPE=Debug -DZSL_BUILD_TESTS=ON
-	generate release -DCMAKE_BUILD_TYPE=Release -DZSL_BUILD_TESTS=ON
+	generate debug -DCMAKE_BUILD_TYPE=Debug -DZSL_BUILD_TESTS=ON -DZSL_BUILD_BENCHMARKS=ON
+	generate release -DCMAKE_BUILD_TYPE=Release -DZSL_BUILD_TESTS=ON -DZSL_BUILD_BENCHMARKS=ON
 fi
 
 cd bin/$BUILD_FOLDER || { echo "Failed to cd to $BUILD_FOLDER build folder. Make sure you run \"build -i\" and you're in the project directory."; exit 1; }
@@ -36,4 +37,6 @@ if [[ ${DEBUG} = true ]]; then
 	gdb tests/tests
 elif [[ ${RUN} = true ]]; then
 	./tests/tests
+elif [[ ${BENCH} = true ]]; then
+	./benchmarks/benchmarks "${@:2}"
 fi
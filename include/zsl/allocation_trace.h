@@ -0,0 +1,58 @@
+#pragma once
+#include "core.h"
+#include "array_list.h"
+
+namespace zsl{
+
+// Records what an allocator is asked to do, so the same sequence can be replayed against other
+// allocators. Wrap an allocator in tracedAlloc and, while a trace is running, every allocation, resize
+// and free through it is written to a binary file: one 32 byte event each, buffered per thread.
+// Every block gets a small header holding an id that ties its resizes and free to its allocation, so a
+// wrapped allocator costs 16 bytes per block (more for larger alignments) even when nothing is traced.
+// Blocks allocated through tracedAlloc must be resized and freed through it.
+
+enum AllocationOp: uint8_t{
+	ALLOCATION_ALLOC,
+	ALLOCATION_RESIZE,
+	ALLOCATION_FREE,
+};
+
+struct AllocationEvent{
+	// Nanoseconds since the trace started. Allocations and resizes are stamped once the allocator
+	// returns and frees before it is called, so an event never comes before the ones it depends on.
+	uint64_t time;
+	// The same for every event on one block, never reused.
+	uint64_t block;
+	// Zero for frees.
+	uint64_t size;
+	// Numbered in the order threads first used a traced allocator during this trace.
+	uint32_t thread;
+	AllocationOp op;
+	// log2 of the alignment.
+	uint8_t alignmentShift;
+	uint16_t reserved;
+};
+static_assert(sizeof(AllocationEvent) == 32);
+
+// The file is this header followed by the events, in no particular order.
+struct AllocationTraceHeader{
+	static constexpr uint32_t VERSION = 1;
+	char magic[8];// "ZSLTRACE"
+	uint32_t version;
+	uint32_t eventSize;
+};
+
+// Truncates path and starts recording. Fails if the file can't be opened or a trace is running.
+bool allocationTraceStart(const char* path);
+// Writes out every thread's buffer and closes the file. Call it once the traced threads are done
+// allocating, events recorded while it runs may be lost.
+void allocationTraceStop();
+// Replaces the contents of events with a trace, sorted by time. Fails if path isn't a trace of this version.
+bool loadAllocationTrace(const char* path, ArrayList<AllocationEvent>& events);
+
+void* traceAllocation(Allocator allocator, void* ptr, size_t size, size_t alignment);
+
+template<Allocator allocator>
+void* tracedAlloc(void* ptr, size_t size, size_t alignment){return traceAllocation(allocator, ptr, size, alignment);}
+
+}
@@ -1,9 +1,80 @@
 #pragma once
 #include "core.h"
-#include "memory.h"
+#include "string.h"
+#include "stdlib.h"
 
 namespace zsl{
 
+// Element moves shared by every list type. Trivially copyable types go
+// through memmove/memcpy, everything else is assigned one at a time.
+template<typename T>
+ALWAYS_INLINE void moveElements(T* to, const T* from, size_t count){
+	if constexpr(isTriviallyCopyable<T>){
+		memmove((void*)to, (const void*)from, count * sizeof(T));
+	}else if(to < from){
+		for(size_t i = 0; i < count; i++) to[i] = from[i];
+	}else{
+		for(size_t i = count; i > 0; i--) to[i - 1] = from[i - 1];
+	}
+}
+
+// Ranges must not overlap.
+template<typename T>
+ALWAYS_INLINE void copyElements(T* to, const T* from, size_t count){
+	if constexpr(isTriviallyCopyable<T>) memcpy((void*)to, (const void*)from, count * sizeof(T));
+	else for(size_t i = 0; i < count; i++) to[i] = from[i];
+}
+
+// Stable compaction, returns how many elements are left.
+template<typename T, typename F>
+size_t compactElements(T* data, size_t size, F predicate){
+	size_t kept = 0;
+	for(size_t i = 0; i < size; i++){
+		if(predicate(data[i])) continue;
+		if(kept != i) data[kept] = data[i];
+		kept++;
+	}
+	return kept;
+}
+
+// The bulk operations of every list type are identical once we have the element pointer,
+// so they are written once here. The list needs size, reserve() and getData().
+// Values passed in must not point into the list itself since growing may move it.
+#define BULK_OPERATIONS(T) \
+	void appendRange(ArrayView<T> values){ \
+		reserve(size + values.size); \
+		copyElements(getData() + size, values.data, values.size); \
+		size += values.size; \
+	} \
+	void insertRange(size_t place, ArrayView<T> values){ \
+		ZSL_ASSERT(place >= 0 && place <= size); \
+		reserve(size + values.size); \
+		T* data = getData(); \
+		moveElements(data + place + values.size, data + place, size - place); \
+		copyElements(data + place, values.data, values.size); \
+		size += values.size; \
+	} \
+	/* Removes [first, last) keeping the order of the rest. */ \
+	void removeRange(size_t first, size_t last){ \
+		ZSL_ASSERT(first <= last && last <= size); \
+		T* data = getData(); \
+		moveElements(data + first, data + last, size - last); \
+		size -= last - first; \
+	} \
+	/* Removes every element the predicate returns true for, keeping the order of the rest. */ \
+	template<typename F> size_t removeIf(F predicate){ \
+		size_t old = size; \
+		size = compactElements(getData(), size, predicate); \
+		return old - size; \
+	} \
+	/* Grows by count uninitialized elements and returns them to be filled in. */ \
+	ArrayView<T> extend(size_t count){ \
+		reserve(size + count); \
+		ArrayView<T> added = {count, getData() + size}; \
+		size += count; \
+		return added; \
+	}
+
 template<typename T, Allocator allocator = ZSL_DEFAULT_ALLOCATOR>
 struct ArrayList{
 	using ValueType = T;
@@ -14,6 +85,7 @@ struct ArrayList{
 	size_t size;
 	T* data;
 	
+	ALWAYS_INLINE T* getData(){return data;}
 	ALWAYS_INLINE T& operator[](size_t i){ZSL_ASSERT(i >= 0 && i < size); return data[i];}
 	ALWAYS_INLINE T* begin(){return data;}
 	ALWAYS_INLINE T* end(){return data + size;}
@@ -48,7 +120,7 @@ struct ArrayList{
 	void insert(size_t place, const T& value){
 		ZSL_ASSERT(place >= 0 && place <= size);
 		reserve(size + 1);
-		for(size_t i = size; i > place; i--) data[i] = data[i - 1];
+		moveElements(data + place + 1, data + place, size - place);
 		data[place] = value;
 		size++;
 	}
@@ -62,7 +134,7 @@ struct ArrayList{
 	void remove(size_t place){
 		ZSL_ASSERT(place >= 0 && place < size);
 		size--;
-		for(size_t i = place; i < size; i++) data[i] = data[i + 1];
+		moveElements(data + place, data + place + 1, size - place);
 	}
 	
 	void removePlace(size_t place){
@@ -70,10 +142,211 @@ struct ArrayList{
 		data[place] = data[--size];
 	}
 	
+	BULK_OPERATIONS(T)
+	
 	template<Allocator newAllocator = allocator>
 	ArrayList<T, newAllocator> copy(){
 		auto clone = ArrayList<T, newAllocator>::init(capacity);
-		memcpy(clone.data, data, size * sizeof(T));
+		copyElements(clone.data, data, size);
+		clone.size = size;
+		return clone;
+	}
+};
+
+// Keeps the first N elements inside the struct itself and only goes to the allocator
+// once it outgrows them, so short lived small lists never allocate.
+// Since init() returns by value we can't keep a pointer into our own storage,
+// use getData() instead of a data member.
+template<typename T, size_t N, Allocator allocator = ZSL_DEFAULT_ALLOCATOR>
+struct SmallArrayList{
+	using ValueType = T;
+	using Self = SmallArrayList<T, N, allocator>;
+	static_assert(N > 0);
+	
+	size_t capacity;
+	size_t size;
+	T* heap;// nullptr while the elements are stored inline.
+	alignas(T) char storage[N * sizeof(T)];
+	
+	ALWAYS_INLINE bool isInline(){return heap == nullptr;}
+	ALWAYS_INLINE T* getData(){return heap ? heap : (T*)storage;}
+	ALWAYS_INLINE T& operator[](size_t i){ZSL_ASSERT(i >= 0 && i < size); return getData()[i];}
+	ALWAYS_INLINE T* begin(){return getData();}
+	ALWAYS_INLINE T* end(){return getData() + size;}
+	ALWAYS_INLINE operator ArrayView<T>(){return {size, getData()};}
+	ALWAYS_INLINE ArrayView<T> slice(size_t first, size_t last){ZSL_ASSERT(first < last && first >= 0 && last <= size); return {last - first, getData() + first};}
+	ALWAYS_INLINE ArrayView<T> slice(size_t first = 0){ZSL_ASSERT(first >= 0 && first <= size); return {size - first, getData() + first};}
+	ALWAYS_INLINE void clear(){size = 0;}
+	ALWAYS_INLINE void deinit(){if(heap) dealloc<allocator>(heap);}
+	
+	static Self init(){
+		Self list;
+		list.capacity = N;
+		list.size = 0;
+		list.heap = nullptr;
+		return list;
+	}
+	
+	void reserve(size_t value){
+		if(capacity < value){
+			do capacity <<= 1; while(capacity < value);
+			if(heap){
+				heap = realloc<allocator>(capacity, heap);
+			}else{
+				// Inline lists hold at most N elements, copying all of them is a fixed size copy.
+				heap = alloc<allocator, T>(capacity);
+				memcpy(heap, storage, sizeof(storage));
+			}
+		}
+	}
+	
+	void resize(size_t value){
+		reserve(value);
+		size = value;
+	}
+	
+	// Moves the elements back inline if they fit again.
+	void shrink(){
+		if(!heap) return;
+		if(size <= N){
+			memcpy(storage, heap, size * sizeof(T));
+			dealloc<allocator>(heap);
+			heap = nullptr;
+			capacity = N;
+		}else{
+			capacity = size;
+			heap = realloc<allocator>(capacity, heap);
+		}
+	}
+	
+	void insert(size_t place, const T& value){
+		ZSL_ASSERT(place >= 0 && place <= size);
+		reserve(size + 1);
+		T* data = getData();
+		moveElements(data + place + 1, data + place, size - place);
+		data[place] = value;
+		size++;
+	}
+	
+	void append(const T& value){
+		reserve(size + 1);
+		getData()[size] = value;
+		size++;
+	}
+	
+	void remove(size_t place){
+		ZSL_ASSERT(place >= 0 && place < size);
+		size--;
+		T* data = getData();
+		moveElements(data + place, data + place + 1, size - place);
+	}
+	
+	void removePlace(size_t place){
+		ZSL_ASSERT(place >= 0 && place < size);
+		T* data = getData();
+		data[place] = data[--size];
+	}
+	
+	BULK_OPERATIONS(T)
+	
+	template<Allocator newAllocator = allocator>
+	ArrayList<T, newAllocator> copy(){
+		auto clone = ArrayList<T, newAllocator>::init(size);
+		copyElements(clone.data, getData(), size);
+		clone.size = size;
+		return clone;
+	}
+};
+
+// Reserves address space for every element it could ever hold up front and commits
+// pages as it grows. Growing never copies and element addresses never change,
+// at the cost of a fixed maximum capacity. Meant for very large append mostly lists.
+template<typename T>
+struct VirtualArrayList{
+	using ValueType = T;
+	using Self = VirtualArrayList<T>;
+	static constexpr size_t DEFAULT_RESERVATION = sizeof(size_t) == 8 ? size_t(1) << 36 : size_t(1) << 28;// In bytes.
+	
+	size_t capacity;// Elements that fit in the committed pages.
+	size_t maxCapacity;
+	size_t size;
+	T* data;
+	
+	ALWAYS_INLINE T* getData(){return data;}
+	ALWAYS_INLINE T& operator[](size_t i){ZSL_ASSERT(i >= 0 && i < size); return data[i];}
+	ALWAYS_INLINE T* begin(){return data;}
+	ALWAYS_INLINE T* end(){return data + size;}
+	ALWAYS_INLINE operator ArrayView<T>(){return {size, data};}
+	ALWAYS_INLINE ArrayView<T> slice(size_t first, size_t last){ZSL_ASSERT(first < last && first >= 0 && last <= size); return {last - first, data + first};}
+	ALWAYS_INLINE ArrayView<T> slice(size_t first = 0){ZSL_ASSERT(first >= 0 && first <= size); return {size - first, data + first};}
+	ALWAYS_INLINE void clear(){size = 0;}
+	ALWAYS_INLINE size_t getReservedSize(){return align(maxCapacity * sizeof(T), getPageSize());}
+	ALWAYS_INLINE void deinit(){freeVirtualMemory(data, getReservedSize());}
+	
+	static Self init(size_t maxCapacity = DEFAULT_RESERVATION / sizeof(T)){
+		Self list = {0, maxCapacity, 0, nullptr};
+		list.data = (T*)reserveVirtualMemory(list.getReservedSize());
+		return list;
+	}
+	
+	void reserve(size_t value){
+		if(capacity < value){
+			// Past the reservation lies whatever else is mapped, so this stops release builds too.
+			ZSL_ASSERT(value <= maxCapacity);
+			if(value > maxCapacity) abort();
+			// Commit at least double so appending one at a time doesn't mprotect every page.
+			size_t committed = align(capacity * sizeof(T), getPageSize());
+			size_t target = min(align(max(value * sizeof(T), committed * 2), getPageSize()), getReservedSize());
+			commitVirtualMemory((char*)data + committed, target - committed);
+			capacity = min(target / sizeof(T), maxCapacity);
+		}
+	}
+	
+	void resize(size_t value){
+		reserve(value);
+		size = value;
+	}
+	
+	// Returns the pages past the last element to the OS.
+	void shrink(){
+		size_t committed = align(capacity * sizeof(T), getPageSize());
+		size_t used = align(size * sizeof(T), getPageSize());
+		if(used < committed) decommitVirtualMemory((char*)data + used, committed - used);
+		capacity = used / sizeof(T);
+	}
+	
+	void insert(size_t place, const T& value){
+		ZSL_ASSERT(place >= 0 && place <= size);
+		reserve(size + 1);
+		moveElements(data + place + 1, data + place, size - place);
+		data[place] = value;
+		size++;
+	}
+	
+	void append(const T& value){
+		reserve(size + 1);
+		data[size] = value;
+		size++;
+	}
+	
+	void remove(size_t place){
+		ZSL_ASSERT(place >= 0 && place < size);
+		size--;
+		moveElements(data + place, data + place + 1, size - place);
+	}
+	
+	void removePlace(size_t place){
+		ZSL_ASSERT(place >= 0 && place < size);
+		data[place] = data[--size];
+	}
+	
+	BULK_OPERATIONS(T)
+	
+	template<Allocator newAllocator = ZSL_DEFAULT_ALLOCATOR>
+	ArrayList<T, newAllocator> copy(){
+		auto clone = ArrayList<T, newAllocator>::init(size);
+		copyElements(clone.data, data, size);
+		clone.size = size;
 		return clone;
 	}
 };
@@ -81,4 +354,6 @@ struct ArrayList{
 //template<typename T> using TempList = ArrayList<T, talloc>;
 //template<typename T> using TempView = ArrayView<T>;
 
+#undef BULK_OPERATIONS
+
 }
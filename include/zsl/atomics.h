@@ -98,4 +98,37 @@ struct alignas(alignof(T*) * 2) TaggedPointer{
 };
 
 
+// Tells the CPU we are busy waiting, so it doesn't flood the pipeline with loads of the same line
+// and gives the other hyperthread the core.
+ALWAYS_INLINE void spinPause(){
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+// For critical sections of a few dozen instructions, where taking a Mutex costs more than the section.
+// Waiters spin on a plain load so they don't steal the line from the owner, and yield if it takes long.
+struct SpinLock{
+	static constexpr uint32_t SPINS_BEFORE_YIELD = 64;
+	
+	uint32_t locked;
+	
+	void init(){locked = 0;}
+	
+	ALWAYS_INLINE bool tryLock(){
+		return !atomicLoad(&locked, ORDER_RELAXED) && !atomicExchange(&locked, uint32_t(1), ORDER_ACQUIRE);
+	}
+	
+	void lock(){
+		for(uint32_t spins = 0; !tryLock(); spins++){
+			if(spins < SPINS_BEFORE_YIELD) spinPause();
+			else threadYield();
+		}
+	}
+	
+	ALWAYS_INLINE void unlock(){atomicStore(&locked, uint32_t(0), ORDER_RELEASE);}
+};
+
 }
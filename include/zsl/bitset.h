@@ -0,0 +1,302 @@
+#pragma once
+#include "core.h"
+#include "string.h"
+#if defined(__BMI2__)
+	#include "immintrin.h"
+#endif
+
+namespace zsl{
+
+// Word kernels shared by every bitset, vectorized with AVX2 when the CPU has it (see cpu.h).
+void bitsAnd(uint64_t* to, const uint64_t* from, size_t words);
+void bitsOr(uint64_t* to, const uint64_t* from, size_t words);
+void bitsXor(uint64_t* to, const uint64_t* from, size_t words);
+// to &= ~from
+void bitsAndNot(uint64_t* to, const uint64_t* from, size_t words);
+uint64_t bitsPopCount(const uint64_t* words, size_t count);
+
+// Position of the k-th (counting from zero) set bit of word.
+ALWAYS_INLINE uint32_t selectBit(uint64_t word, uint32_t k){
+	ZSL_ASSERT(k < popCount(word));
+#if defined(__BMI2__)
+	return countTrailingZeros(uint64_t(_pdep_u64(UINT64_C(1) << k, word)));
+#else
+	// Skip whole bytes first so the bit by bit part is at most eight steps.
+	uint32_t base = 0;
+	while(true){
+		uint32_t inByte = popCount(uint32_t((word >> base) & 0xFF));
+		if(k < inByte) break;
+		k -= inByte;
+		base += 8;
+	}
+	uint32_t byte = (word >> base) & 0xFF;
+	for(uint32_t i = 0; i < k; i++) byte &= byte - 1;
+	return base + countTrailingZeros(byte);
+#endif
+}
+
+// Visits set bits in increasing order, one countTrailingZeros per bit instead of a test per bit.
+struct SetBitIterator{
+	const uint64_t* words;
+	size_t wordCount;
+	size_t wordIndex;
+	uint64_t word;
+	
+	ALWAYS_INLINE SetBitIterator(const uint64_t* words, size_t wordCount, size_t wordIndex): words(words), wordCount(wordCount), wordIndex(wordIndex){
+		if(wordIndex < wordCount){
+			word = words[wordIndex];
+			skipEmpty();
+		}else{
+			word = 0;
+		}
+	}
+	ALWAYS_INLINE void skipEmpty(){
+		while(!word && ++wordIndex < wordCount) word = words[wordIndex];
+	}
+	ALWAYS_INLINE size_t operator*(){return wordIndex * 64 + countTrailingZeros(word);}
+	ALWAYS_INLINE SetBitIterator& operator++(){
+		word &= word - 1;
+		skipEmpty();
+		return *this;
+	}
+	ALWAYS_INLINE bool operator!=(const SetBitIterator& other){return wordIndex != other.wordIndex;}
+};
+
+struct SetBits{
+	const uint64_t* words;
+	size_t wordCount;
+	ALWAYS_INLINE SetBitIterator begin(){return {words, wordCount, 0};}
+	ALWAYS_INLINE SetBitIterator end(){return {words, wordCount, wordCount};}
+};
+
+// Every bitset type shares these once it has bitCount, getWords() and getWordCount().
+// Bits past bitCount in the last word are always kept zero so counting never sees them.
+#define BIT_OPERATIONS(Self) \
+	static constexpr size_t NOT_FOUND = SIZE_MAX; \
+	ALWAYS_INLINE bool get(size_t i){ZSL_ASSERT(i < bitCount); return (getWords()[i / 64] >> (i % 64)) & 1;} \
+	ALWAYS_INLINE void set(size_t i){ZSL_ASSERT(i < bitCount); getWords()[i / 64] |= UINT64_C(1) << (i % 64);} \
+	ALWAYS_INLINE void set(size_t i, bool value){ \
+		ZSL_ASSERT(i < bitCount); \
+		uint64_t& word = getWords()[i / 64]; \
+		word = (word & ~(UINT64_C(1) << (i % 64))) | (uint64_t(value) << (i % 64)); \
+	} \
+	ALWAYS_INLINE void unset(size_t i){ZSL_ASSERT(i < bitCount); getWords()[i / 64] &= ~(UINT64_C(1) << (i % 64));} \
+	ALWAYS_INLINE void flip(size_t i){ZSL_ASSERT(i < bitCount); getWords()[i / 64] ^= UINT64_C(1) << (i % 64);} \
+	void setAll(){ \
+		memset(getWords(), 0xFF, getWordCount() * sizeof(uint64_t)); \
+		trimLastWord(); \
+	} \
+	void unsetAll(){memset(getWords(), 0, getWordCount() * sizeof(uint64_t));} \
+	ALWAYS_INLINE void trimLastWord(){ \
+		if(bitCount % 64) getWords()[bitCount / 64] &= (UINT64_C(1) << (bitCount % 64)) - 1; \
+	} \
+	/* The other set must have the same number of bits. */ \
+	void andWith(Self& other){ZSL_ASSERT(bitCount == other.bitCount); bitsAnd(getWords(), other.getWords(), getWordCount());} \
+	void orWith(Self& other){ZSL_ASSERT(bitCount == other.bitCount); bitsOr(getWords(), other.getWords(), getWordCount());} \
+	void xorWith(Self& other){ZSL_ASSERT(bitCount == other.bitCount); bitsXor(getWords(), other.getWords(), getWordCount());} \
+	void andNotWith(Self& other){ZSL_ASSERT(bitCount == other.bitCount); bitsAndNot(getWords(), other.getWords(), getWordCount());} \
+	size_t count(){return bitsPopCount(getWords(), getWordCount());} \
+	/* Set bits in [first, last). */ \
+	size_t count(size_t first, size_t last){ \
+		ZSL_ASSERT(first <= last && last <= bitCount); \
+		if(first == last) return 0; \
+		uint64_t* words = getWords(); \
+		size_t firstWord = first / 64, lastWord = (last - 1) / 64; \
+		uint64_t firstMask = ~UINT64_C(0) << (first % 64); \
+		uint64_t lastMask = ~UINT64_C(0) >> (63 - (last - 1) % 64); \
+		if(firstWord == lastWord) return popCount(words[firstWord] & firstMask & lastMask); \
+		return popCount(words[firstWord] & firstMask) + bitsPopCount(words + firstWord + 1, lastWord - firstWord - 1) + popCount(words[lastWord] & lastMask); \
+	} \
+	bool any(){ \
+		uint64_t* words = getWords(); \
+		for(size_t i = 0; i < getWordCount(); i++) if(words[i]) return true; \
+		return false; \
+	} \
+	/* First set bit at or after from, NOT_FOUND if there is none. */ \
+	size_t findNext(size_t from = 0){ \
+		if(from >= bitCount) return NOT_FOUND; \
+		uint64_t* words = getWords(); \
+		size_t i = from / 64; \
+		uint64_t word = words[i] & (~UINT64_C(0) << (from % 64)); \
+		while(!word){ \
+			if(++i == getWordCount()) return NOT_FOUND; \
+			word = words[i]; \
+		} \
+		return i * 64 + countTrailingZeros(word); \
+	} \
+	/* First unset bit at or after from, NOT_FOUND if there is none. */ \
+	size_t findNextUnset(size_t from = 0){ \
+		if(from >= bitCount) return NOT_FOUND; \
+		uint64_t* words = getWords(); \
+		size_t i = from / 64; \
+		uint64_t word = ~words[i] & (~UINT64_C(0) << (from % 64)); \
+		while(!word){ \
+			if(++i == getWordCount()) return NOT_FOUND; \
+			word = ~words[i]; \
+		} \
+		size_t found = i * 64 + countTrailingZeros(word); \
+		return found < bitCount ? found : NOT_FOUND; \
+	} \
+	/* Set bits before i. Linear in i, build a RankSelectIndex for many queries. */ \
+	ALWAYS_INLINE size_t rank(size_t i){return count(0, i);} \
+	/* Position of the k-th set bit, NOT_FOUND if there are not that many. */ \
+	size_t select(size_t k){ \
+		uint64_t* words = getWords(); \
+		for(size_t i = 0; i < getWordCount(); i++){ \
+			size_t inWord = popCount(words[i]); \
+			if(k < inWord) return i * 64 + selectBit(words[i], k); \
+			k -= inWord; \
+		} \
+		return NOT_FOUND; \
+	} \
+	/* for(size_t i: bits.iterateSet()) */ \
+	ALWAYS_INLINE SetBits iterateSet(){return {getWords(), getWordCount()};}
+
+template<size_t bits>
+struct BitSet{
+	using Self = BitSet<bits>;
+	static constexpr size_t bitCount = bits;
+	static constexpr size_t WORD_COUNT = (bits + 63) / 64;
+	
+	uint64_t words[WORD_COUNT];
+	
+	static Self init(){
+		Self self;
+		self.unsetAll();
+		return self;
+	}
+	
+	ALWAYS_INLINE uint64_t* getWords(){return words;}
+	ALWAYS_INLINE size_t getWordCount(){return WORD_COUNT;}
+	
+	BIT_OPERATIONS(Self)
+};
+
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR>
+struct DynamicBitSet{
+	using Self = DynamicBitSet<allocator>;
+	
+	size_t capacity;// In words.
+	size_t bitCount;
+	uint64_t* words;
+	
+	static Self init(size_t bitCount = 0){
+		Self self;
+		self.capacity = max((bitCount + 63) / 64, size_t(1));
+		self.bitCount = bitCount;
+		self.words = alloc<allocator, uint64_t>(self.capacity);
+		self.unsetAll();
+		return self;
+	}
+	
+	void deinit(){
+		dealloc<allocator>(words);
+	}
+	
+	ALWAYS_INLINE uint64_t* getWords(){return words;}
+	ALWAYS_INLINE size_t getWordCount(){return (bitCount + 63) / 64;}
+	
+	// New bits start unset.
+	void resize(size_t newBitCount){
+		size_t oldWords = getWordCount();
+		size_t newWords = (newBitCount + 63) / 64;
+		if(newWords > capacity){
+			capacity = max(newWords, capacity * 2);
+			words = realloc<allocator>(capacity, words);
+		}
+		if(newWords > oldWords) memset(words + oldWords, 0, (newWords - oldWords) * sizeof(uint64_t));
+		if(newBitCount < bitCount){
+			bitCount = newBitCount;
+			trimLastWord();
+		}
+		bitCount = newBitCount;
+	}
+	
+	ALWAYS_INLINE void append(bool value){
+		if(bitCount % 64 == 0) resize(bitCount + 1);
+		else bitCount++;
+		set(bitCount - 1, value);
+	}
+	
+	Self copy(){
+		Self clone = init(bitCount);
+		memcpy(clone.words, words, getWordCount() * sizeof(uint64_t));
+		return clone;
+	}
+	
+	BIT_OPERATIONS(Self)
+};
+
+#undef BIT_OPERATIONS
+
+// Constant time rank and logarithmic select over a bitset that no longer changes. Costs 12.5% extra space,
+// one cumulative count per 512 bits, so rank is a table lookup and a popcount over at most eight words.
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR>
+struct RankSelectIndex{
+	using Self = RankSelectIndex<allocator>;
+	static constexpr size_t WORDS_PER_BLOCK = 8;
+	static constexpr size_t NOT_FOUND = SIZE_MAX;
+	
+	const uint64_t* words;
+	size_t wordCount;
+	size_t blockCount;
+	// Set bits before each block, with one extra entry holding the total.
+	uint64_t* ranks;
+	
+	// The index points into the bitset's words, keep the set alive and unchanged while using it.
+	template<typename BitSetType>
+	static Self init(BitSetType& bitSet){
+		Self self;
+		self.words = bitSet.getWords();
+		self.wordCount = bitSet.getWordCount();
+		self.blockCount = (self.wordCount + WORDS_PER_BLOCK - 1) / WORDS_PER_BLOCK;
+		self.ranks = alloc<allocator, uint64_t>(self.blockCount + 1);
+		uint64_t total = 0;
+		for(size_t block = 0; block < self.blockCount; block++){
+			self.ranks[block] = total;
+			size_t first = block * WORDS_PER_BLOCK;
+			total += bitsPopCount(self.words + first, min(WORDS_PER_BLOCK, self.wordCount - first));
+		}
+		self.ranks[self.blockCount] = total;
+		return self;
+	}
+	
+	void deinit(){
+		dealloc<allocator>(ranks);
+	}
+	
+	ALWAYS_INLINE size_t count(){return ranks[blockCount];}
+	
+	// Set bits before i.
+	size_t rank(size_t i){
+		ZSL_ASSERT(i <= wordCount * 64);
+		size_t wordIndex = i / 64;
+		size_t block = wordIndex / WORDS_PER_BLOCK;
+		size_t result = ranks[block];
+		for(size_t w = block * WORDS_PER_BLOCK; w < wordIndex; w++) result += popCount(words[w]);
+		if(i % 64) result += popCount(words[wordIndex] & (~UINT64_C(0) >> (64 - i % 64)));
+		return result;
+	}
+	
+	// Position of the k-th set bit, NOT_FOUND if there are not that many.
+	size_t select(size_t k){
+		if(k >= count()) return NOT_FOUND;
+		// Last block with fewer than k + 1 bits before it, branchless like lowerBound in sort.h.
+		const uint64_t* base = ranks;
+		size_t size = blockCount;
+		while(size > 1){
+			size_t half = size / 2;
+			base += (base[half] <= k) * half;
+			size -= half;
+		}
+		size_t block = base - ranks;
+		k -= ranks[block];
+		for(size_t w = block * WORDS_PER_BLOCK;; w++){
+			size_t inWord = popCount(words[w]);
+			if(k < inWord) return w * 64 + selectBit(words[w], k);
+			k -= inWord;
+		}
+	}
+};
+
+}
@@ -0,0 +1,267 @@
+#pragma once
+#include "core.h"
+#include "atomics.h"
+#include "hash_map.h"
+
+namespace zsl{
+
+template<typename K, typename V> using EvictFunction = void(*)(K&, V&);
+
+struct CacheStats{
+	size_t hits;
+	size_t misses;
+	size_t insertions;
+	size_t evictions;
+	size_t entries;
+	size_t bytes;
+};
+
+// A bounded cache with CLOCK eviction, split into shards by key hash that each have their own lock,
+// table and budget, so threads touching different keys rarely wait on each other.
+// A hit only sets the entry's referenced bit (no list to reorder like LRU), and when a shard is over
+// its budget the clock hand sweeps its entries, clearing referenced bits and evicting the first entry
+// that wasn't used since the last sweep. Values are copied in and out under the shard lock, so keep
+// them small or store pointers and free them in onEvict.
+template<typename K, typename V, Allocator allocator = ZSL_DEFAULT_ALLOCATOR,
+	HashFunction<K> hasher = defaultHash<K>, CompareFunction<K> comparer = defaultCompare<K>, EvictFunction<K, V> onEvict = nullptr>
+struct Cache{
+	using Self = Cache<K, V, allocator, hasher, comparer, onEvict>;
+	using Index = HashMap<K, uint32_t, allocator, hasher, comparer>;
+	
+	struct Slot{
+		K key;
+		V value;
+		// What the entry is charged against the budget, zero for free slots.
+		size_t bytes;
+		bool referenced;
+	};
+	
+	// Every entry is charged its slot and (about) its table record on top of the extra bytes it is given.
+	static constexpr size_t ENTRY_BYTES = sizeof(Slot) + 2 * sizeof(typename Index::Record);
+	
+	struct alignas(64) Shard{
+		SpinLock lock;
+		// Key to slot, the tombstones evictions leave are cleaned up by its inserts.
+		Index index;
+		Slot* slots;
+		uint32_t slotCount;
+		uint32_t slotCapacity;
+		uint32_t hand;
+		// Stack of free slot indices, as long as slots.
+		uint32_t* freeSlots;
+		uint32_t freeCount;
+		size_t bytes;
+		size_t budget;
+		size_t hits;
+		size_t misses;
+		size_t insertions;
+		size_t evictions;
+	};
+	
+	uint32_t shardShift;
+	size_t shardCount;
+	Shard* shards;
+	
+	// Zero shards picks four per processor, rounded up to a power of two.
+	static Self init(size_t byteBudget, size_t shardCount = 0){
+		if(shardCount == 0) shardCount = getProcessorCount() * 4;
+		shardCount = nextPow2(uint64_t(shardCount));
+		Self self;
+		self.shardCount = shardCount;
+		self.shardShift = 64 - (uint32_t)countTrailingZeros(uint64_t(shardCount));
+		self.shards = alloc<allocator, Shard>(shardCount);
+		for(size_t i = 0; i < shardCount; i++){
+			Shard& shard = self.shards[i];
+			shard.lock.init();
+			shard.index = Index::init();
+			shard.slots = nullptr;
+			shard.slotCount = shard.slotCapacity = shard.hand = 0;
+			shard.freeSlots = nullptr;
+			shard.freeCount = 0;
+			shard.bytes = 0;
+			shard.budget = byteBudget / shardCount;
+			shard.hits = shard.misses = shard.insertions = shard.evictions = 0;
+		}
+		return self;
+	}
+	
+	void deinit(){
+		for(size_t i = 0; i < shardCount; i++){
+			Shard& shard = shards[i];
+			if constexpr(onEvict != nullptr){
+				for(uint32_t slot = 0; slot < shard.slotCount; slot++){
+					if(shard.slots[slot].bytes) onEvict(shard.slots[slot].key, shard.slots[slot].value);
+				}
+			}
+			shard.index.deinit();
+			if(shard.slots) dealloc<allocator>(shard.slots);
+			if(shard.freeSlots) dealloc<allocator>(shard.freeSlots);
+		}
+		dealloc<allocator>(shards);
+	}
+	
+	// The table index comes from the low bits of the hash, so the shard comes from the high bits of a mix.
+	ALWAYS_INLINE Shard& getShard(const K& key){
+		return shards[shardCount == 1 ? 0 : mixHash(hasher(key)) >> shardShift];
+	}
+	
+	// Copies the value out on a hit.
+	bool get(const K& key, V& value){
+		Shard& shard = getShard(key);
+		shard.lock.lock();
+		auto record = shard.index.getRecord(key);
+		if(!record){
+			shard.misses++;
+			shard.lock.unlock();
+			return false;
+		}
+		Slot& slot = shard.slots[record->value];
+		// Don't dirty the line when the bit is already set, hot entries are read by every core.
+		if(!slot.referenced) slot.referenced = true;
+		value = slot.value;
+		shard.hits++;
+		shard.lock.unlock();
+		return true;
+	}
+	
+	// Inserts or replaces. extraBytes is what the value owns outside of the cache, like a buffer it points
+	// to. Returns false without inserting if the entry alone is larger than a shard's budget. A replaced
+	// entry's old key and value are passed to onEvict, the cache keeps the new ones.
+	bool put(const K& key, const V& value, size_t extraBytes = 0){
+		Shard& shard = getShard(key);
+		shard.lock.lock();
+		bool admitted = putLocked(shard, key, value, ENTRY_BYTES + extraBytes);
+		shard.lock.unlock();
+		return admitted;
+	}
+	
+	// Inserts many entries, taking each shard's lock once for all of its keys instead of once per key.
+	// Returns how many were admitted.
+	size_t putBatch(ArrayView<K> keys, ArrayView<V> values){
+		ZSL_ASSERT(keys.size == values.size);
+		// Counting sort of the entries by shard.
+		uint32_t* order = alloc<allocator, uint32_t>(max(keys.size, size_t(1)));
+		uint32_t* shardOf = alloc<allocator, uint32_t>(max(keys.size, size_t(1)));
+		size_t* starts = alloc<allocator, size_t>(shardCount + 1);
+		for(size_t i = 0; i <= shardCount; i++) starts[i] = 0;
+		for(size_t i = 0; i < keys.size; i++){
+			shardOf[i] = uint32_t(&getShard(keys.data[i]) - shards);
+			starts[shardOf[i] + 1]++;
+		}
+		for(size_t i = 0; i < shardCount; i++) starts[i + 1] += starts[i];
+		for(size_t i = 0; i < keys.size; i++) order[starts[shardOf[i]]++] = (uint32_t)i;
+		size_t admitted = 0;
+		size_t first = 0;
+		for(size_t i = 0; i < shardCount; i++){
+			// starts[i] is now where shard i ends.
+			if(first == starts[i]) continue;
+			Shard& shard = shards[i];
+			shard.lock.lock();
+			for(; first < starts[i]; first++){
+				uint32_t entry = order[first];
+				admitted += putLocked(shard, keys.data[entry], values.data[entry], ENTRY_BYTES);
+			}
+			shard.lock.unlock();
+		}
+		dealloc<allocator>(order);
+		dealloc<allocator>(shardOf);
+		dealloc<allocator>(starts);
+		return admitted;
+	}
+	
+	bool remove(const K& key){
+		Shard& shard = getShard(key);
+		shard.lock.lock();
+		auto record = shard.index.getRecord(key);
+		if(record) evict(shard, record->value, false);
+		shard.lock.unlock();
+		return record;
+	}
+	
+	// Sums the shards one at a time, so with concurrent writers it is not a single point in time.
+	CacheStats getStats(){
+		CacheStats stats = {};
+		for(size_t i = 0; i < shardCount; i++){
+			Shard& shard = shards[i];
+			shard.lock.lock();
+			stats.hits += shard.hits;
+			stats.misses += shard.misses;
+			stats.insertions += shard.insertions;
+			stats.evictions += shard.evictions;
+			stats.entries += shard.index.size;
+			stats.bytes += shard.bytes;
+			shard.lock.unlock();
+		}
+		return stats;
+	}
+	
+	bool putLocked(Shard& shard, const K& key, const V& value, size_t bytes){
+		if(bytes > shard.budget) return false;
+		auto record = shard.index.getRecord(key);
+		if(record){
+			uint32_t index = record->value;
+			Slot& slot = shard.slots[index];
+			if constexpr(onEvict != nullptr) onEvict(slot.key, slot.value);
+			// Equal keys hash the same, so the record can take the new key in place.
+			record->key = key;
+			shard.bytes -= slot.bytes;
+			slot.key = key;
+			slot.value = value;
+			slot.bytes = bytes;
+			slot.referenced = true;
+			shard.bytes += bytes;
+			// Replacing a value with a larger one can go over too. The entry fits the budget on its own,
+			// so the others make room for it.
+			while(shard.bytes > shard.budget) sweep(shard, index);
+		}else{
+			// Reserve before sweeping so we don't evict an entry and then find there's no room for its replacement.
+			while(shard.bytes + bytes > shard.budget) sweep(shard);
+			uint32_t index = takeSlot(shard);
+			shard.slots[index] = {key, value, bytes, false};
+			shard.index.insert(key, index);
+			shard.bytes += bytes;
+			shard.insertions++;
+		}
+		return true;
+	}
+	
+	// Advances the hand until it evicts one entry other than keep. Ends within two laps, the first
+	// clears every bit.
+	void sweep(Shard& shard, uint32_t keep = UINT32_MAX){
+		while(true){
+			if(shard.hand >= shard.slotCount) shard.hand = 0;
+			Slot& slot = shard.slots[shard.hand];
+			uint32_t current = shard.hand++;
+			if(!slot.bytes || current == keep) continue;
+			if(slot.referenced){
+				slot.referenced = false;
+				continue;
+			}
+			evict(shard, current, true);
+			return;
+		}
+	}
+	
+	void evict(Shard& shard, uint32_t index, bool counted){
+		Slot& slot = shard.slots[index];
+		// Out of the index first, onEvict may free what the key points to.
+		shard.index.remove(slot.key);
+		if constexpr(onEvict != nullptr) onEvict(slot.key, slot.value);
+		shard.bytes -= slot.bytes;
+		slot.bytes = 0;
+		shard.freeSlots[shard.freeCount++] = index;
+		if(counted) shard.evictions++;
+	}
+	
+	uint32_t takeSlot(Shard& shard){
+		if(shard.freeCount) return shard.freeSlots[--shard.freeCount];
+		if(shard.slotCount == shard.slotCapacity){
+			shard.slotCapacity = max(shard.slotCapacity * 2, uint32_t(16));
+			shard.slots = shard.slots ? realloc<allocator>(shard.slotCapacity, shard.slots) : alloc<allocator, Slot>(shard.slotCapacity);
+			shard.freeSlots = shard.freeSlots ? realloc<allocator>(shard.slotCapacity, shard.freeSlots) : alloc<allocator, uint32_t>(shard.slotCapacity);
+		}
+		return shard.slotCount++;
+	}
+};
+
+}
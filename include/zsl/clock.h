@@ -0,0 +1,39 @@
+#pragma once
+#include "core.h"
+
+namespace zsl{
+
+// Cycle counter. On x86 this is the invariant TSC, which ticks at a constant rate
+// on every core no matter the frequency scaling. Elsewhere we fall back to getTime.
+ALWAYS_INLINE uint64_t readCycles(){
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	return __builtin_ia32_rdtsc();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	return __rdtsc();
+#else
+	return getTime();
+#endif
+}
+
+// Like readCycles but waits for every previous instruction to finish first,
+// so the work being measured can't leak past the read.
+ALWAYS_INLINE uint64_t readCyclesSerialized(){
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	unsigned int aux;
+	return __builtin_ia32_rdtscp(&aux);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	unsigned int aux;
+	return __rdtscp(&aux);
+#else
+	return getTime();
+#endif
+}
+
+// Measured against getTime the first time it's called, which takes a few milliseconds.
+double getCyclesPerNanosecond();
+
+ALWAYS_INLINE uint64_t cyclesToNanoseconds(uint64_t cycles){
+	return (uint64_t)(cycles / getCyclesPerNanosecond());
+}
+
+}
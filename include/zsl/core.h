@@ -40,6 +40,13 @@ template<typename L, typename R> struct typeEqual{static constexpr bool same = f
 template<typename T> struct typeEqual<T, T>{static constexpr bool same = true;};
 template<typename L, typename R> inline constexpr bool isTypeEqual = typeEqual<L, R>::same;
 
+template<bool, typename T, typename F> struct selectTypeHelper{using type = T;};
+template<typename T, typename F> struct selectTypeHelper<false, T, F>{using type = F;};
+template<bool B, typename T, typename F> using selectType = typename selectTypeHelper<B, T, F>::type;
+
+// Every compiler we support has this builtin, which saves us from pulling in <type_traits>.
+template<typename T> inline constexpr bool isTriviallyCopyable = __is_trivially_copyable(T);
+
 // --------------------------------------------------------------------------------------------------------
 // ------------------------------------------------ Macros ------------------------------------------------
 // --------------------------------------------------------------------------------------------------------
@@ -253,15 +260,104 @@ ALWAYS_INLINE uint64_t log2Ceil(uint64_t v){
 #endif
 }
 
-inline bool isStringEqual(const char* a, const char* b){
-	size_t i = 0;
-	while(true){
-		if(a[i] != b[i]) return false;
-		if(a[i] == '\0') return true;
+// Number of set bits.
+ALWAYS_INLINE uint32_t popCount(uint32_t v){
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ZSL_NO_CLZ)
+	return __builtin_popcount(v);
+#elif defined(_MSC_VER) && !defined(ZSL_NO_CLZ)
+	return __popcnt(v);
+#else
+	v = v - ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#endif
+}
+
+ALWAYS_INLINE uint64_t popCount(uint64_t v){
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ZSL_NO_CLZ)
+	return __builtin_popcountll(v);
+#elif defined(_MSC_VER) && !defined(ZSL_NO_CLZ)
+	return __popcnt64(v);
+#else
+	v = v - ((v >> 1) & UINT64_C(0x5555555555555555));
+	v = (v & UINT64_C(0x3333333333333333)) + ((v >> 2) & UINT64_C(0x3333333333333333));
+	return (((v + (v >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F)) * UINT64_C(0x0101010101010101)) >> 56;
+#endif
+}
+
+// Index of the lowest set bit, 32 if there is none.
+ALWAYS_INLINE uint32_t countTrailingZeros(uint32_t v){
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ZSL_NO_CLZ)
+	return v ? __builtin_ctz(v) : 32;
+#elif defined(_MSC_VER) && !defined(ZSL_NO_CLZ)
+	unsigned long int index;
+	return _BitScanForward(&index, v) ? index : 32;
+#else
+	if(!v) return 32;
+	uint32_t i = 0;
+	while(!(v & 1)){
+		v >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+// Index of the lowest set bit, 64 if there is none.
+ALWAYS_INLINE uint64_t countTrailingZeros(uint64_t v){
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ZSL_NO_CLZ)
+	return v ? __builtin_ctzll(v) : 64;
+#elif defined(_MSC_VER) && !defined(ZSL_NO_CLZ)
+	unsigned long int index;
+	return _BitScanForward64(&index, v) ? index : 64;
+#else
+	if(!v) return 64;
+	uint64_t i = 0;
+	while(!(v & 1)){
+		v >>= 1;
 		i++;
 	}
+	return i;
+#endif
 }
 
+// 32 if v is zero.
+ALWAYS_INLINE uint32_t countLeadingZeros(uint32_t v){
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ZSL_NO_CLZ)
+	return v ? __builtin_clz(v) : 32;
+#elif defined(_MSC_VER) && !defined(ZSL_NO_CLZ)
+	unsigned long int index;
+	return _BitScanReverse(&index, v) ? 31 - index : 32;
+#else
+	uint32_t i = 32;
+	while(v){
+		v >>= 1;
+		i--;
+	}
+	return i;
+#endif
+}
+
+// 64 if v is zero.
+ALWAYS_INLINE uint64_t countLeadingZeros(uint64_t v){
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(ZSL_NO_CLZ)
+	return v ? __builtin_clzll(v) : 64;
+#elif defined(_MSC_VER) && !defined(ZSL_NO_CLZ)
+	unsigned long int index;
+	return _BitScanReverse64(&index, v) ? 63 - index : 64;
+#else
+	uint64_t i = 64;
+	while(v){
+		v >>= 1;
+		i--;
+	}
+	return i;
+#endif
+}
+
+// Compares 16 bytes at a time, see string_utils.h for length aware strings.
+bool isStringEqual(const char* a, const char* b);
+
 template<typename Container>
 bool hasString(Container& buffer, const char* str){
 	for(const char* value: buffer){
@@ -280,13 +376,37 @@ bool contains(Container& buffer, const T& value){
 // -------------------------------------------------- OS --------------------------------------------------
 // --------------------------------------------------------------------------------------------------------
 
+// Returns nullptr if the memory can't be mapped.
 void* allocateVirtualMemory(size_t);
 void* reserveVirtualMemory(size_t);
 void commitVirtualMemory(void*, size_t);
+// Gives the pages back to the OS but keeps the address range reserved.
+void decommitVirtualMemory(void*, size_t);
 void freeVirtualMemory(void*, size_t);
+// Grows or shrinks memory from allocateVirtualMemory, moving it to another address if it has to. Pages
+// are remapped rather than copied. Returns the new address, or nullptr with the memory left where it was.
+void* resizeVirtualMemory(void*, size_t oldSize, size_t newSize);
+
+size_t getProcessorCount();
+size_t getPageSize();
 
 using ThreadFunction = void(*)(void*);
 void threadCreate(ThreadFunction, void*);
+struct StackRange{
+	char* low;
+	char* high;
+};
+// The calling thread's stack, looked up the first time and cached. Threads from threadCreate look it up
+// before they start, so on those it can be read from a signal handler with lookup false, which returns
+// an empty range instead of looking it up.
+StackRange getThreadStack(bool lookup = true);
+void threadYield();
+void threadSleep(uint64_t nanoseconds);
+
+// Nanoseconds from an arbitrary fixed point, never goes backwards.
+uint64_t getTime();
+// Nanoseconds of CPU time used by the whole process.
+uint64_t getProcessTime();
 
 #if defined(ZSL_WINDOWS)
 using MutexType = CRITICAL_SECTION;
@@ -398,6 +518,10 @@ struct NallocInfo{
 };
 ArrayView<NallocInfo> nallocGetInfo();
 #endif
+// Blocks at least this large are mapped straight from the OS instead of coming from the power of two
+// pools, they are unmapped when freed and grown with resizeVirtualMemory. When the OS is out of memory
+// for one, nalloc returns nullptr and leaves the block being resized as it was.
+constexpr size_t NALLOC_DIRECT_SIZE = size_t(1) << 20;
 void* nalloc(void*, size_t, size_t);
 #ifndef ZSL_DEFAULT_ALLOCATOR
 #define ZSL_DEFAULT_ALLOCATOR nalloc
@@ -0,0 +1,97 @@
+#pragma once
+#include "core.h"
+#include "atomics.h"
+
+namespace zsl{
+
+// Bit flags, combine them to ask for several features at once.
+enum CpuFeature: uint32_t{
+	CPU_SSE2     = 1 << 0,
+	CPU_SSE3     = 1 << 1,
+	CPU_SSSE3    = 1 << 2,
+	CPU_SSE41    = 1 << 3,
+	CPU_SSE42    = 1 << 4,
+	CPU_POPCNT   = 1 << 5,
+	CPU_AES      = 1 << 6,
+	CPU_AVX      = 1 << 7,
+	CPU_FMA      = 1 << 8,
+	CPU_AVX2     = 1 << 9,
+	CPU_BMI1     = 1 << 10,
+	CPU_BMI2     = 1 << 11,
+	CPU_LZCNT    = 1 << 12,
+	CPU_AVX512F  = 1 << 13,
+	CPU_AVX512BW = 1 << 14,
+	CPU_AVX512VL = 1 << 15,
+	// Fast rep movsb, which makes it the best memcpy for large copies.
+	CPU_ERMS     = 1 << 16,
+};
+using CpuFeatures = uint32_t;
+
+struct CpuInfo{
+	// Only features the OS also saves the registers for, AVX is missing if XSAVE doesn't cover ymm.
+	CpuFeatures features;
+	char vendor[13];
+	char brand[49];
+	size_t cacheLineSize;
+};
+
+// Detected once. Setting ZSL_CPU_DISABLE to a comma separated list of feature names (like "avx2,avx512f")
+// removes them, so the fallback kernels can be tested and benchmarked on any machine.
+const CpuInfo& getCpuInfo();
+const char* getCpuFeatureName(CpuFeature);
+
+ALWAYS_INLINE bool hasCpuFeatures(CpuFeatures features){
+	return (getCpuInfo().features & features) == features;
+}
+
+// Compiles a single function for an instruction set the rest of the build doesn't assume.
+// Only call it through a CpuDispatch (or after checking hasCpuFeatures).
+#if defined(__GNUC__) || defined(__clang__)
+#define ZSL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ZSL_TARGET(isa)
+#endif
+
+template<typename Signature, size_t count> struct CpuDispatch;
+
+// Picks the first implementation whose required features the CPU has, on the first call.
+// Order candidates best first and end with one that requires nothing. Constant initialized,
+// so a global dispatch can be called from static initializers in other files.
+// static CpuDispatch<size_t(const char*), 2> stringLength = {{{CPU_AVX2, stringLengthAvx2}, {0, stringLengthScalar}}};
+template<typename R, typename... Args, size_t count>
+struct CpuDispatch<R(Args...), count>{
+	using Function = R(*)(Args...);
+	
+	struct Candidate{
+		CpuFeatures required;
+		Function function;
+	};
+	
+	Candidate candidates[count];
+	Function resolved = nullptr;
+	
+	Function resolve(){
+		Function function = candidates[count - 1].function;
+		for(Candidate& candidate: candidates){
+			if(hasCpuFeatures(candidate.required)){
+				function = candidate.function;
+				break;
+			}
+		}
+		// Every thread that races here picks the same function, so a plain store is enough.
+		atomicStore(&resolved, function, ORDER_RELAXED);
+		return function;
+	}
+	
+	// Hoist this out of hot loops to skip the load on every call.
+	ALWAYS_INLINE Function get(){
+		Function function = atomicLoad(&resolved, ORDER_RELAXED);
+		return function ? function : resolve();
+	}
+	
+	ALWAYS_INLINE R operator()(Args... args){
+		return get()(args...);
+	}
+};
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include "core.h"
+#include "hash_map.h"
+#include "array_list.h"
+
+namespace zsl{
+
+// A map whose entries are packed in an ArrayList in insertion order, found through a separate open
+// addressed table of 32 bit entry indices. Iterating is a walk over size entries no matter how large
+// the table has grown, and the values can be handed out as one contiguous array.
+// Removing moves the last entry into the hole (like ArrayList::removePlace), so the order is insertion
+// order only until the first remove. The table deletes by shifting the rest of the probe run back
+// instead of leaving tombstones. Inserting may move every entry, don't hold pointers across it.
+template<typename K, typename V, Allocator allocator = ZSL_DEFAULT_ALLOCATOR, HashFunction<K> hasher = defaultHash<K>,
+	CompareFunction<K> comparer = defaultCompare<K>>
+struct DenseMap{
+	using KeyType = K;
+	using ValueType = V;
+	using Self = DenseMap<K, V, allocator, hasher, comparer>;
+	static constexpr size_t MIN_CAPACITY = 16;// MUST BE POWER OF TWO
+	// Every probe reads an entry to compare keys, and slots are only four bytes, so keep runs short.
+	static constexpr double MAX_LOAD_FACTOR = 0.5;
+	static constexpr uint32_t EMPTY = UINT32_MAX;
+	
+	struct Entry{
+		K key;
+		V value;
+	};
+	
+	ArrayList<Entry, allocator> entries;
+	size_t capacity;// MUST BE A POWER OF TWO
+	// Index into entries or EMPTY.
+	uint32_t* slots;
+	
+	static Self init(size_t initial = MIN_CAPACITY){
+		size_t capacity = nextPow2(max(size_t(initial / MAX_LOAD_FACTOR) + 1, MIN_CAPACITY));
+		Self self = {ArrayList<Entry, allocator>::init(initial), capacity, alloc<allocator, uint32_t>(capacity)};
+		self.clear();
+		return self;
+	}
+	
+	ALWAYS_INLINE void deinit(){
+		entries.deinit();
+		dealloc<allocator>(slots);
+	}
+	
+	ALWAYS_INLINE void clear(){
+		entries.clear();
+		for(size_t i = 0; i < capacity; i++) slots[i] = EMPTY;
+	}
+	
+	ALWAYS_INLINE size_t getSize(){return entries.size;}
+	ALWAYS_INLINE size_t getHash(const K& key){return BIT_MODULO(hasher(key), capacity);}
+	ALWAYS_INLINE bool has(const K& key){return getEntry(key);}
+	
+	// The slot holding key's entry, or the empty slot that ends its probe run.
+	ALWAYS_INLINE size_t findSlot(const K& key){
+		size_t i = getHash(key);
+		while(slots[i] != EMPTY && !comparer(entries.data[slots[i]].key, key)) i = BIT_MODULO(i + 1, capacity);
+		return i;
+	}
+	
+	ALWAYS_INLINE Entry* getEntry(const K& key){
+		uint32_t index = slots[findSlot(key)];
+		return index == EMPTY ? nullptr : entries.data + index;
+	}
+	
+	V& get(const K& key){
+		Entry* entry = getEntry(key);
+		ZSL_ASSERT(entry);
+		return entry->value;
+	}
+	
+	V& insert(const K& key, const V& value){
+		ZSL_ASSERT(getEntry(key) == nullptr);
+		ZSL_ASSERT(entries.size < EMPTY);
+		reserve(entries.size + 1);
+		slots[findSlot(key)] = (uint32_t)entries.size;
+		entries.append({key, value});
+		return entries.data[entries.size - 1].value;
+	}
+	
+	V& operator[](const K& key){
+		size_t slot = findSlot(key);
+		if(slots[slot] != EMPTY) return entries.data[slots[slot]].value;
+		if(needsGrow(entries.size + 1)) return insert(key, V{});
+		ZSL_ASSERT(entries.size < EMPTY);
+		slots[slot] = (uint32_t)entries.size;
+		entries.append({key, V{}});
+		return entries.data[entries.size - 1].value;
+	}
+	
+	void remove(const K& key){
+		size_t slot = findSlot(key);
+		uint32_t index = slots[slot];
+		ZSL_ASSERT(index != EMPTY);
+		removeSlot(slot);
+		uint32_t last = uint32_t(entries.size - 1);
+		if(index != last){
+			// Point the last entry's slot at the hole it's about to fill.
+			slots[findSlot(entries.data[last].key)] = index;
+		}
+		entries.removePlace(index);
+	}
+	
+	// Removes every entry predicate(key, value) returns true for, keeping the order of the rest.
+	// Rebuilds the table once at the end instead of fixing it per entry.
+	template<typename F>
+	size_t removeIf(F predicate){
+		size_t removed = entries.removeIf([&](Entry& entry){return predicate(entry.key, entry.value);});
+		if(removed) rebuild(capacity);
+		return removed;
+	}
+	
+	// Backward shift deletion: every later slot of the run whose home is at or before the hole moves
+	// back into it, so the run stays unbroken and lookups never need tombstones.
+	void removeSlot(size_t hole){
+		size_t i = hole;
+		while(true){
+			i = BIT_MODULO(i + 1, capacity);
+			if(slots[i] == EMPTY) break;
+			size_t home = getHash(entries.data[slots[i]].key);
+			// Can move when home isn't cyclically in (hole, i].
+			if(BIT_MODULO(i - home, capacity) >= BIT_MODULO(i - hole, capacity)){
+				slots[hole] = slots[i];
+				hole = i;
+			}
+		}
+		slots[hole] = EMPTY;
+	}
+	
+	ALWAYS_INLINE bool needsGrow(size_t value){return (double)value / capacity > MAX_LOAD_FACTOR;}
+	
+	void reserve(size_t value){
+		entries.reserve(value);
+		if(needsGrow(value)){
+			size_t newCapacity = capacity;
+			do newCapacity <<= 1; while((double)value / newCapacity > MAX_LOAD_FACTOR);
+			rebuild(newCapacity);
+		}
+	}
+	
+	// Refills the table from the entries, no keys are compared since they're known to be distinct.
+	void rebuild(size_t newCapacity){
+		if(newCapacity != capacity){
+			dealloc<allocator>(slots);
+			slots = alloc<allocator, uint32_t>(newCapacity);
+			capacity = newCapacity;
+		}
+		for(size_t i = 0; i < capacity; i++) slots[i] = EMPTY;
+		for(uint32_t index = 0; index < entries.size; index++){
+			size_t i = getHash(entries.data[index].key);
+			while(slots[i] != EMPTY) i = BIT_MODULO(i + 1, capacity);
+			slots[i] = index;
+		}
+	}
+	
+	ALWAYS_INLINE Entry* begin(){return entries.begin();}
+	ALWAYS_INLINE Entry* end(){return entries.end();}
+	ALWAYS_INLINE operator ArrayView<Entry>(){return entries;}
+
+#define ITER(name, type, get) struct name{ \
+		Entry* entry; \
+		ALWAYS_INLINE type& operator*(){return entry->get;} \
+		ALWAYS_INLINE void operator++(){entry++;} \
+		ALWAYS_INLINE bool operator==(const name& other){return entry == other.entry;} \
+		ALWAYS_INLINE bool operator!=(const name& other){return entry != other.entry;} \
+	}
+	ITER(KeyIterator, K, key);
+	ITER(ValueIterator, V, value);
+#undef ITER
+	template<typename T>
+	struct IteratorType{
+		Self& map;
+		ALWAYS_INLINE T begin(){return {map.entries.begin()};}
+		ALWAYS_INLINE T end(){return {map.entries.end()};}
+	};
+	
+	ALWAYS_INLINE IteratorType<KeyIterator> iterateKeys(){return {*this};}
+	ALWAYS_INLINE IteratorType<ValueIterator> iterateValues(){return {*this};}
+};
+
+}
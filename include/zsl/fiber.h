@@ -0,0 +1,78 @@
+#pragma once
+#include "core.h"
+#include "atomics.h"
+
+namespace zsl{
+
+// Stackful fibers multiplexed over a small set of OS threads (M:N).
+// Every fiber gets a fixed size stack carved out of one big virtual memory
+// reservation, so spawning a fiber never calls the heap allocator and
+// finished stacks are recycled by the next spawn.
+// Stacks have no guard pages (that would cost two mappings per fiber),
+// so size them generously for the work you run on them.
+
+using FiberFunction = void(*)(void*);
+
+struct Fiber{
+	void* context;// Saved stack pointer while the fiber is not running.
+	Fiber* next;
+	FiberFunction function;
+	void* userData;
+	bool done;
+};
+
+struct FiberScheduler{
+	static inline constexpr size_t DEFAULT_STACK_SIZE = size_t(64) * 1024;
+	static inline constexpr size_t DEFAULT_MAX_FIBERS = sizeof(size_t) == 8 ? size_t(1) << 18 : size_t(1) << 10;
+	// How many stacks we commit at once when the reservation grows.
+	static inline constexpr size_t COMMIT_STACKS = 64;
+	
+	char* stacks;
+	char* committed;
+	char* mark;
+	size_t stackSize;
+	size_t maxFibers;
+	
+	Fiber* freeFibers;
+	Fiber* head;
+	Fiber* tail;
+	size_t activeFibers;
+	size_t workerCount;
+	bool quit;
+	
+	Mutex mutex;
+	Condition ready;
+	Condition idle;
+	Semaphore exited;
+	
+	// Zero threads means one worker per processor.
+	void init(size_t threads = 0, size_t maxFibers = DEFAULT_MAX_FIBERS, size_t stackSize = DEFAULT_STACK_SIZE);
+	// Waits for every queued fiber to finish before stopping the workers.
+	void deinit();
+	// Safe to call from any thread, including from inside a fiber.
+	void spawn(FiberFunction, void*);
+	// Blocks the calling OS thread until no fibers are left. Don't call this from a fiber.
+	void wait();
+};
+
+// Returns the running fiber or nullptr if called outside of a fiber.
+Fiber* getCurrentFiber();
+// Gives the worker thread to the next queued fiber. The calling fiber is requeued
+// and may resume on a different worker thread.
+void fiberYield();
+
+// Counts outstanding work so a fiber can wait on other fibers without blocking its worker thread.
+struct FiberGroup{
+	size_t count;
+	
+	ALWAYS_INLINE void init(){count = 0;}
+	ALWAYS_INLINE void add(size_t amount = 1){atomicAdd(&count, amount, ORDER_RELAXED);}
+	ALWAYS_INLINE void done(){atomicSub(&count, size_t(1), ORDER_RELEASE);}
+	
+	void wait(){
+		if(getCurrentFiber()) while(atomicLoad(&count, ORDER_ACQUIRE) != 0) fiberYield();
+		else while(atomicLoad(&count, ORDER_ACQUIRE) != 0) threadYield();
+	}
+};
+
+}
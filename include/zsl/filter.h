@@ -0,0 +1,259 @@
+#pragma once
+#include "core.h"
+#include "string.h"
+#include "hash_map.h"
+#include "sort.h"
+#if defined(__SSE2__)
+	#include "immintrin.h"
+#endif
+
+namespace zsl{
+
+// Approximate membership filters. They answer "definitely not in the set" or "maybe in the set",
+// so a lookup that is usually a miss can skip the HashMap probe (or the disk read) in one cache access.
+// Keys are hashed with the same hash functions as HashMap and the result is mixed, since defaultHash
+// of an integer is the integer itself.
+
+// The bit a split block Bloom filter sets in each of the eight words of a block is picked by the low
+// half of the hash, multiplied by a different odd constant per word. The high half picks the block.
+inline constexpr uint32_t BLOOM_SALTS[8] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+ALWAYS_INLINE uint32_t bloomWordMask(uint64_t hash, size_t word){
+	return uint32_t(1) << ((uint32_t(hash) * BLOOM_SALTS[word]) >> 27);
+}
+
+ALWAYS_INLINE size_t bloomBlock(uint64_t hash, size_t blockCount){
+	return reduceRange(uint32_t(hash >> 32), (uint32_t)blockCount);
+}
+
+// Whether every bit hash sets in a block is set. The scalar loop is bound by the variable shifts, so
+// SSE2 does four words at a time: a 32 bit multiply out of two 32x32->64 ones and 1 << n by building
+// the float 2^n and converting it back (2^31 overflows to 0x80000000, which is the bit we want anyway).
+ALWAYS_INLINE bool bloomBlockContains(const uint32_t* block, uint64_t hash){
+#if defined(__SSE2__)
+	const __m128i value = _mm_set1_epi32(uint32_t(hash));
+	const __m128i valueOdd = _mm_srli_epi64(value, 32);
+	__m128i missing = _mm_setzero_si128();
+	for(size_t half = 0; half < 2; half++){
+		__m128i salts = _mm_loadu_si128((const __m128i*)(BLOOM_SALTS + half * 4));
+		__m128i even = _mm_mul_epu32(value, salts);
+		__m128i odd = _mm_mul_epu32(valueOdd, _mm_srli_epi64(salts, 32));
+		__m128i product = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		__m128i exponent = _mm_add_epi32(_mm_slli_epi32(_mm_srli_epi32(product, 27), 23), _mm_set1_epi32(127 << 23));
+		__m128i mask = _mm_cvttps_epi32(_mm_castsi128_ps(exponent));
+		missing = _mm_or_si128(missing, _mm_andnot_si128(_mm_loadu_si128((const __m128i*)(block + half * 4)), mask));
+	}
+	return _mm_movemask_epi8(_mm_cmpeq_epi32(missing, _mm_setzero_si128())) == 0xFFFF;
+#else
+	uint32_t missing = 0;
+	for(size_t word = 0; word < 8; word++) missing |= bloomWordMask(hash, word) & ~block[word];
+	return missing == 0;
+#endif
+}
+
+// Batch queries over already mixed hashes, results[i] is set to whether hashes[i] may be in the filter
+// and the number of maybes is returned. They prefetch the next keys' cache lines so several misses are
+// in flight at once, and the Bloom one tests a block with one AVX2 compare when the CPU has it (see cpu.h).
+size_t blockedBloomQuery(const uint32_t* blocks, size_t blockCount, const uint64_t* hashes, size_t count, bool* results);
+size_t xorFilterQuery(const uint8_t* fingerprints, size_t blockLength, const uint64_t* hashes, size_t count, bool* results);
+size_t xorFilterQuery(const uint16_t* fingerprints, size_t blockLength, const uint64_t* hashes, size_t count, bool* results);
+
+// Keys are hashed in chunks of this size on the stack before a batch kernel runs.
+inline constexpr size_t FILTER_BATCH_SIZE = 64;
+
+// --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------- Bloom Filter -------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// A split block Bloom filter. The hash picks one 32 byte block and sets one bit in each of its eight
+// 32 bit words, so a query is a single cache line read (and a single compare with AVX2).
+// About 1.3% false positives at 10 bits per key and 0.2% at 16, a bit worse than a classic Bloom filter
+// of the same size. Keys can be added at any time, but not removed.
+template<typename K, Allocator allocator = ZSL_DEFAULT_ALLOCATOR, HashFunction<K> hasher = defaultHash<K>>
+struct BloomFilter{
+	using Self = BloomFilter<K, allocator, hasher>;
+	static constexpr size_t BLOCK_WORDS = 8;
+	
+	struct alignas(32) Block{
+		uint32_t words[BLOCK_WORDS];
+	};
+	
+	size_t blockCount;
+	Block* blocks;
+	
+	static Self init(size_t expected, size_t bitsPerKey = 10){
+		size_t blockCount = max((expected * bitsPerKey + 255) / 256, size_t(1));
+		// The block is picked from 32 bits of the hash.
+		ZSL_ASSERT(blockCount <= UINT32_MAX);
+		Self self = {blockCount, alloc<allocator, Block>(blockCount)};
+		self.clear();
+		return self;
+	}
+	
+	ALWAYS_INLINE void deinit(){dealloc<allocator>(blocks);}
+	ALWAYS_INLINE void clear(){memset(blocks, 0, blockCount * sizeof(Block));}
+	ALWAYS_INLINE static uint64_t hashKey(const K& key){return mixHash(hasher(key));}
+	
+	ALWAYS_INLINE Block& getBlock(uint64_t hash){return blocks[bloomBlock(hash, blockCount)];}
+	
+	void insertHash(uint64_t hash){
+		Block& block = getBlock(hash);
+		for(size_t i = 0; i < BLOCK_WORDS; i++) block.words[i] |= bloomWordMask(hash, i);
+	}
+	
+	ALWAYS_INLINE bool containsHash(uint64_t hash){return bloomBlockContains(getBlock(hash).words, hash);}
+	
+	ALWAYS_INLINE void insert(const K& key){insertHash(hashKey(key));}
+	ALWAYS_INLINE bool contains(const K& key){return containsHash(hashKey(key));}
+	
+	// Same answers as contains, but with many cache misses in flight. Returns the number of maybes.
+	size_t containsBatch(ArrayView<K> keys, bool* results){
+		uint64_t hashes[FILTER_BATCH_SIZE];
+		size_t maybe = 0;
+		for(size_t first = 0; first < keys.size; first += FILTER_BATCH_SIZE){
+			size_t count = min(keys.size - first, FILTER_BATCH_SIZE);
+			for(size_t i = 0; i < count; i++) hashes[i] = hashKey(keys.data[first + i]);
+			maybe += blockedBloomQuery((const uint32_t*)blocks, blockCount, hashes, count, results + first);
+		}
+		return maybe;
+	}
+};
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Xor Filter --------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// A static filter (Graf and Lemire) built once from the full key set. A key maps to three cells, one in
+// each third of the array, and is in the filter when the xor of the three equals its fingerprint.
+// About 1.23 fingerprints per key: 9.8 bits per key for 0.4% false positives with uint8_t fingerprints,
+// or 19.7 bits for 0.0015% with uint16_t. Smaller and more accurate than a Bloom filter, but three
+// (independent) memory accesses per query and no inserts after init.
+template<typename K, typename T = uint8_t, Allocator allocator = ZSL_DEFAULT_ALLOCATOR, HashFunction<K> hasher = defaultHash<K>>
+struct XorFilter{
+	static_assert(isTypeEqual<T, uint8_t> || isTypeEqual<T, uint16_t>, "Fingerprints are uint8_t or uint16_t.");
+	using Self = XorFilter<K, T, allocator, hasher>;
+	// Construction fails with a small probability, each retry uses a new seed.
+	static constexpr size_t MAX_ATTEMPTS = 64;
+	
+	uint64_t seed;
+	size_t blockLength;
+	T* fingerprints;
+	
+	ALWAYS_INLINE uint64_t hashKey(const K& key){return mixHash(hasher(key) + seed);}
+	
+	ALWAYS_INLINE static size_t cell(uint64_t hash, size_t index, size_t blockLength){
+		uint64_t rotated = index == 0 ? hash : (hash << (21 * index)) | (hash >> (64 - 21 * index));
+		return reduceRange(uint32_t(rotated), (uint32_t)blockLength) + index * blockLength;
+	}
+	
+	ALWAYS_INLINE static T fingerprint(uint64_t hash){return T(hash ^ (hash >> 32));}
+	
+	// Duplicate keys are fine. Returns an empty filter (where contains is always false) if the keys
+	// didn't fit after MAX_ATTEMPTS seeds, which for distinct hashes practically never happens.
+	static Self init(ArrayView<K> keys){
+		Self self = {UINT64_C(0x726b2b9d438b9d4d), 0, nullptr};
+		// Two equal hashes can never be peeled apart, sort and drop the repeats first.
+		uint64_t* hashes = alloc<allocator, uint64_t>(max(keys.size, size_t(1)));
+		size_t count = 0;
+		for(size_t i = 0; i < keys.size; i++) hashes[i] = hasher(keys.data[i]);
+		radixSort<allocator, uint64_t>({keys.size, hashes});
+		for(size_t i = 0; i < keys.size; i++) if(i == 0 || hashes[i] != hashes[i - 1]) hashes[count++] = hashes[i];
+		
+		size_t blockLength = (32 + count * 123 / 100) / 3;
+		ZSL_ASSERT(blockLength <= UINT32_MAX);
+		size_t cells = blockLength * 3;
+		// xors[i] is the xor of the hashes that still map to cell i and counts[i] how many there are,
+		// so a cell with one left knows which hash it is without a list.
+		uint64_t* xors = alloc<allocator, uint64_t>(cells);
+		uint32_t* counts = alloc<allocator, uint32_t>(cells);
+		size_t* queue = alloc<allocator, size_t>(cells);
+		// Peeled hashes in order, with the cell each one owns.
+		uint64_t* stack = alloc<allocator, uint64_t>(max(count, size_t(1)));
+		size_t* owners = alloc<allocator, size_t>(max(count, size_t(1)));
+		self.fingerprints = alloc<allocator, T>(cells);
+		self.blockLength = blockLength;
+		
+		bool built = false;
+		for(size_t attempt = 0; attempt < MAX_ATTEMPTS && !built; attempt++){
+			self.seed = mixHash(self.seed + attempt);
+			memset(xors, 0, cells * sizeof(uint64_t));
+			memset(counts, 0, cells * sizeof(uint32_t));
+			for(size_t i = 0; i < count; i++){
+				uint64_t hash = mixHash(hashes[i] + self.seed);
+				for(size_t index = 0; index < 3; index++){
+					size_t c = cell(hash, index, blockLength);
+					xors[c] ^= hash;
+					counts[c]++;
+				}
+			}
+			size_t queued = 0;
+			for(size_t c = 0; c < cells; c++) if(counts[c] == 1) queue[queued++] = c;
+			size_t peeled = 0;
+			while(queued){
+				size_t c = queue[--queued];
+				// Another peel may have emptied it since it was queued.
+				if(counts[c] != 1) continue;
+				uint64_t hash = xors[c];
+				stack[peeled] = hash;
+				owners[peeled++] = c;
+				for(size_t index = 0; index < 3; index++){
+					size_t other = cell(hash, index, blockLength);
+					xors[other] ^= hash;
+					if(--counts[other] == 1) queue[queued++] = other;
+				}
+			}
+			built = peeled == count;
+			if(!built) continue;
+			// In reverse peeling order every cell a key uses, other than the one it owns, is final already.
+			memset(self.fingerprints, 0, cells * sizeof(T));
+			for(size_t i = peeled; i > 0; i--){
+				uint64_t hash = stack[i - 1];
+				T value = fingerprint(hash);
+				for(size_t index = 0; index < 3; index++) value ^= self.fingerprints[cell(hash, index, blockLength)];
+				self.fingerprints[owners[i - 1]] = value;
+			}
+		}
+		if(!built){
+			dealloc<allocator>(self.fingerprints);
+			self.blockLength = 0;
+			self.fingerprints = nullptr;
+		}
+		dealloc<allocator>(hashes);
+		dealloc<allocator>(xors);
+		dealloc<allocator>(counts);
+		dealloc<allocator>(queue);
+		dealloc<allocator>(stack);
+		dealloc<allocator>(owners);
+		return self;
+	}
+	
+	ALWAYS_INLINE void deinit(){if(fingerprints) dealloc<allocator>(fingerprints);}
+	
+	bool contains(const K& key){
+		if(!fingerprints) return false;
+		uint64_t hash = hashKey(key);
+		T value = fingerprint(hash);
+		for(size_t index = 0; index < 3; index++) value ^= fingerprints[cell(hash, index, blockLength)];
+		return value == 0;
+	}
+	
+	size_t containsBatch(ArrayView<K> keys, bool* results){
+		if(!fingerprints){
+			memset(results, 0, keys.size);
+			return 0;
+		}
+		uint64_t hashes[FILTER_BATCH_SIZE];
+		size_t maybe = 0;
+		for(size_t first = 0; first < keys.size; first += FILTER_BATCH_SIZE){
+			size_t count = min(keys.size - first, FILTER_BATCH_SIZE);
+			for(size_t i = 0; i < count; i++) hashes[i] = hashKey(keys.data[first + i]);
+			maybe += xorFilterQuery(fingerprints, blockLength, hashes, count, results + first);
+		}
+		return maybe;
+	}
+};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "core.h"
+#include "parallel.h"
 
 namespace zsl{
 
@@ -23,19 +24,114 @@ ALWAYS_INLINE size_t defaultHash(const T& value){
 	else return (size_t)value;
 }
 
+// The murmur3 finalizer, every input bit affects every output bit. For anything that needs other
+// bits of a hash than the ones the table index uses, since defaultHash of an integer is the integer.
+ALWAYS_INLINE constexpr uint64_t mixHash(uint64_t hash){
+	hash ^= hash >> 33;
+	hash *= UINT64_C(0xff51afd7ed558ccd);
+	hash ^= hash >> 33;
+	hash *= UINT64_C(0xc4ceb53fe1a85ec9);
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// Maps a 32 bit value onto [0, range) with a multiply instead of a division (Lemire).
+ALWAYS_INLINE constexpr uint32_t reduceRange(uint32_t value, uint32_t range){
+	return uint32_t((uint64_t(value) * range) >> 32);
+}
+
 template<typename T>
 ALWAYS_INLINE bool defaultCompare(const T& a, const T& b){
 	if constexpr(isCustomCompare<T>) return a.compare(b);
 	else return a == b;
 }
 
-template<typename K, typename V, Allocator allocator = ZSL_DEFAULT_ALLOCATOR, HashFunction<K> hasher = defaultHash<K>, CompareFunction<K> comparer = defaultCompare<K>>
+// Reserving two key values that are never inserted lets a map tell empty and deleted records apart
+// by their key, so records are just {K, V} with no state byte padded out to the key's alignment.
+// Specialize this with static empty() and deleted() functions for a key type, or pass a type that has
+// them as the map's sentinels parameter. Both must hash and compare like any other key.
+template<typename T> struct HashSentinels{};
+
+// Reserves the two largest values of an integer key or the two highest addresses of a pointer key.
+template<typename T>
+struct MaxSentinels{
+	static_assert(T(1) / T(2) == T(0), "MaxSentinels needs an integer or pointer key.");
+	// Signed types lose the sign bit, so -1 and -2 stay usable keys.
+	static constexpr T MAX = T(~uint64_t(0) >> (64 - sizeof(T) * 8 + (T(-1) < T(0))));
+	
+	ALWAYS_INLINE static T empty(){return MAX;}
+	ALWAYS_INLINE static T deleted(){return MAX - 1;}
+};
+
+template<typename T>
+struct MaxSentinels<T*>{
+	ALWAYS_INLINE static T* empty(){return (T*)~uintptr_t(0);}
+	ALWAYS_INLINE static T* deleted(){return (T*)~uintptr_t(1);}
+};
+
+template<typename T, typename B = HashWrapper<true>> struct isHashSentinelsHelper{static constexpr bool is = false;};
+template<typename T> struct isHashSentinelsHelper<T, HashWrapper<isTypeEqual<decltype(&T::empty), decltype(&T::deleted)>>>{static constexpr bool is = true;};
+template<typename T> inline constexpr bool isHashSentinels = isHashSentinelsHelper<T>::is;
+
+// What a map keeps counted as it changes, so checking its health costs nothing.
+struct HashMapStats{
+	size_t size;
+	size_t capacity;
+	// Deleted records. Lookups probe past them, only a cleanup (or an insert landing on one) frees them.
+	size_t tombstones;
+	// Sum and largest of how far each record is from its home slot. Removing a record never lowers the
+	// largest, it's exact again after the next rehash or cleanup.
+	size_t totalProbe;
+	size_t maxProbe;
+	
+	ALWAYS_INLINE double getAverageProbe() const{return size ? (double)totalProbe / size : 0.0;}
+	ALWAYS_INLINE double getTombstoneRatio() const{return (double)tombstones / capacity;}
+};
+
+enum class HashMaintenance: uint8_t{
+	NONE,
+	// Clear the tombstones in place, moving the records after them back toward their home slots.
+	CLEAN,
+	// Double the capacity.
+	GROW,
+};
+
+// A map asks its maintenance policy what to do before every insert, pass a type with the same static
+// check function to use other thresholds.
+struct DefaultHashMaintenance{
+	// Tombstones take slots that would end misses early, so clean well before they add up to the free slots.
+	static constexpr double MAX_TOMBSTONE_RATIO = 0.2;
+	// Linear probing at the maximum load factor averages about 1.2, so this only trips on clustered hashes.
+	static constexpr double MAX_AVERAGE_PROBE = 4.0;
+	// Growing doesn't help a hash that collides at every capacity, so stop at a quarter of the maximum load.
+	static constexpr double MIN_GROW_LOAD = 0.175;
+	
+	// Runs before every insert, so it multiplies instead of dividing.
+	ALWAYS_INLINE static HashMaintenance check(const HashMapStats& stats){
+		if(stats.tombstones > stats.capacity * MAX_TOMBSTONE_RATIO) return HashMaintenance::CLEAN;
+		if(stats.totalProbe > stats.size * MAX_AVERAGE_PROBE){
+			// A few tombstones are enough to blame, but not so few that every remove triggers a cleanup.
+			if(stats.tombstones * 32 > stats.capacity) return HashMaintenance::CLEAN;
+			if(stats.size > stats.capacity * MIN_GROW_LOAD) return HashMaintenance::GROW;
+		}
+		return HashMaintenance::NONE;
+	}
+};
+
+// Leaves tombstones and clustering for the owner to handle with clearGravestones and optimize.
+struct NoHashMaintenance{
+	ALWAYS_INLINE static HashMaintenance check(const HashMapStats&){return HashMaintenance::NONE;}
+};
+
+template<typename K, typename V, Allocator allocator = ZSL_DEFAULT_ALLOCATOR, HashFunction<K> hasher = defaultHash<K>,
+	CompareFunction<K> comparer = defaultCompare<K>, typename sentinels = HashSentinels<K>, typename maintenance = DefaultHashMaintenance>
 struct HashMap{
 	using KeyType = K;
 	using ValueType = V;
-	using Self = HashMap<K, V, allocator, hasher, comparer>;
+	using Self = HashMap<K, V, allocator, hasher, comparer, sentinels, maintenance>;
 	static constexpr size_t MIN_CAPACITY = 16;// MUST BE POWER OF TWO
 	static constexpr double MAX_LOAD_FACTOR = 0.7;
+	static constexpr bool SENTINELS = isHashSentinels<sentinels>;
 	
 	enum class RecordType: uint8_t{
 		UNUSED,
@@ -47,37 +143,102 @@ struct HashMap{
 		PLACED,
 	};
 	
-	struct Record{
+	struct TypedRecord{
 		K key;
 		V value;
 		RecordType type;
 	};
 	
+	struct SentinelRecord{
+		K key;
+		V value;
+	};
+	
+	using Record = selectType<SENTINELS, SentinelRecord, TypedRecord>;
+	
 	size_t capacity;// MUST BE A POWER OF TWO
 	size_t size;
 	Record* data;
+	size_t tombstones;
+	size_t totalProbe;
+	size_t maxProbe;
 	
 	static Self init(size_t initial = MIN_CAPACITY){
 		initial = nextPow2(max(initial, MIN_CAPACITY));
-		Self v = {initial, 0, alloc<allocator, Record>(initial)};
+		Self v = {initial, 0, alloc<allocator, Record>(initial), 0, 0, 0};
 		v.clear();
 		return v;
 	}
 	
+	// Builds a map from parallel arrays of keys and values in up to threads parallel chunks, zero means one
+	// per pool thread. A key that appears more than once keeps its last value.
+	static Self buildFrom(ArrayView<K> keys, ArrayView<V> values, size_t threads = 0){
+		ZSL_ASSERT(keys.size == values.size);
+		size_t initial = nextPow2(max(size_t(keys.size / MAX_LOAD_FACTOR) + 1, MIN_CAPACITY));
+		Self map = {initial, 0, alloc<allocator, Record>(initial), 0, 0, 0};
+		map.placeParallel(keys.size, [&](size_t i, const K*& key, const V*& value){
+			key = keys.data + i;
+			value = values.data + i;
+			return true;
+		}, threads);
+		return map;
+	}
+	
 	ALWAYS_INLINE void deinit(){dealloc<allocator>(data);}
 	ALWAYS_INLINE double getLoadFactor(){return (double)size / capacity;}
 	ALWAYS_INLINE bool has(const K& key){return getRecord(key);}
-	ALWAYS_INLINE void clear(){for(size_t i = 0; i < capacity; i++) data[i].type = RecordType::UNUSED;}
+	ALWAYS_INLINE void clear(){
+		for(size_t i = 0; i < capacity; i++) setUnused(data[i]);
+		tombstones = totalProbe = maxProbe = 0;
+	}
 	ALWAYS_INLINE size_t getHash(const K& key){return BIT_MODULO(hasher(key), capacity);}
+	ALWAYS_INLINE size_t getProbe(const Record& record){return BIT_MODULO(size_t(&record - data) - getHash(record.key), capacity);}
 	//ALWAYS_INLINE size_t nextHash(size_t hash){return BIT_MODULO(hash + 1, capacity);}
 	
+	ALWAYS_INLINE static bool isUnused(const Record& record){
+		if constexpr(SENTINELS) return comparer(record.key, sentinels::empty());
+		else return record.type == RecordType::UNUSED;
+	}
+	ALWAYS_INLINE static bool isDeleted(const Record& record){
+		if constexpr(SENTINELS) return comparer(record.key, sentinels::deleted());
+		else return record.type == RecordType::DELETED;
+	}
+	ALWAYS_INLINE static bool isOccupied(const Record& record){
+		if constexpr(SENTINELS) return !isUnused(record) && !isDeleted(record);
+		else return record.type == RecordType::OCCUPIED;
+	}
+	ALWAYS_INLINE static bool isSentinel(const K& key){
+		if constexpr(SENTINELS) return comparer(key, sentinels::empty()) || comparer(key, sentinels::deleted());
+		else return false;
+	}
+	ALWAYS_INLINE static void setUnused(Record& record){
+		if constexpr(SENTINELS) record.key = sentinels::empty();
+		else record.type = RecordType::UNUSED;
+	}
+	ALWAYS_INLINE static void setDeleted(Record& record){
+		if constexpr(SENTINELS) record.key = sentinels::deleted();
+		else record.type = RecordType::DELETED;
+	}
+	ALWAYS_INLINE static void setOccupied(Record& record, const K& key, const V& value){
+		if constexpr(SENTINELS) record = {key, value};
+		else record = {key, value, RecordType::OCCUPIED};
+	}
+	
 	Record* getRecord(const K& key){
+		// Sentinel keys can't be stored and would match free slots.
+		if constexpr(SENTINELS) if(isSentinel(key)) return nullptr;
 		size_t hash = getHash(key);
 		size_t i = hash;
 		while(true){
 			Record& record = data[i];
-			if(record.type == RecordType::UNUSED) return nullptr;
-			if(record.type == RecordType::OCCUPIED && comparer(record.key, key)) return &record;
+			if constexpr(SENTINELS){
+				// The key isn't a sentinel, so a match is occupied.
+				if(comparer(record.key, key)) return &record;
+				if(isUnused(record)) return nullptr;
+			}else{
+				if(record.type == RecordType::UNUSED) return nullptr;
+				if(record.type == RecordType::OCCUPIED && comparer(record.key, key)) return &record;
+			}
 			i = BIT_MODULO(i + 1, capacity);
 			if(i == hash) return nullptr;// In case all unused record slots are deleted and we loop around.
 		}
@@ -87,7 +248,7 @@ struct HashMap{
 		size_t i = getHash(key);
 		while(true){
 			Record& record = data[i];
-			if(record.type != RecordType::OCCUPIED) return record;
+			if(!isOccupied(record)) return record;
 			i = BIT_MODULO(i + 1, capacity);
 			// Since we always reserve we don't have to worry about wrapping
 			// since there will be always an available spot.
@@ -101,12 +262,12 @@ struct HashMap{
 	}
 	
 	V& insert(const K& key, const V& value){
+		ZSL_ASSERT(!isSentinel(key));
 		ZSL_ASSERT(getRecord(key) == nullptr);
+		// Before placing the record, so the reference returned stays valid.
+		maintain();
 		reserve(size + 1);
-		Record& record = getUnusedRecord(key);
-		record = {key, value, RecordType::OCCUPIED};
-		size++;
-		return record.value;
+		return place(getUnusedRecord(key), key, value);
 	}
 	
 	V& operator[](const K& key){
@@ -115,14 +276,36 @@ struct HashMap{
 		else return insert(key, V{});
 	}
 	
+	// Never moves other records, so it's safe while iterating. The tombstone is cleaned up by a later insert.
 	void remove(const K& key){
 		Record* record = getRecord(key);
 		ZSL_ASSERT(record);
-		record->type = RecordType::DELETED;
+		totalProbe -= getProbe(*record);
+		setDeleted(*record);
+		tombstones++;
 		size--;
 	}
 	
 	void rehash(size_t newCapacity){
+		// Without a state byte there is no way to mark records placed, so build a new table instead.
+		if constexpr(SENTINELS) rehashOutOfPlace(newCapacity);
+		else rehashInPlace(newCapacity);
+	}
+	
+	void rehashOutOfPlace(size_t newCapacity){
+		newCapacity = nextPow2(max(newCapacity, capacity));
+		Record* oldData = data;
+		size_t oldCapacity = capacity;
+		data = alloc<allocator, Record>(newCapacity);
+		capacity = newCapacity;
+		clear();
+		for(Record* record = oldData; record < oldData + oldCapacity; record++){
+			if(isOccupied(*record)) countProbe(getUnusedRecord(record->key) = *record);
+		}
+		dealloc<allocator>(oldData);
+	}
+	
+	void rehashInPlace(size_t newCapacity){
 		//TODO: Instead of doing this inplace, point to previous hashmap and update as you go.
 		if(newCapacity > capacity){
 			newCapacity = nextPow2(newCapacity);
@@ -160,9 +343,178 @@ struct HashMap{
 				}
 			}
 		}
-		// Unmark all records.
+		// Unmark all records, counting them on the way since there are no tombstones left.
+		tombstones = totalProbe = maxProbe = 0;
 		for(Record* record = data; record < data + capacity; record++){
-			if(record->type == RecordType::PLACED) record->type = RecordType::OCCUPIED;
+			if(record->type != RecordType::PLACED) continue;
+			record->type = RecordType::OCCUPIED;
+			countProbe(*record);
+		}
+	}
+	
+	// Rehashes into a new table in up to threads parallel chunks, zero means one per pool thread.
+	void rehashParallel(size_t newCapacity, size_t threads = 0){
+		newCapacity = nextPow2(max(newCapacity, capacity));
+		Record* oldData = data;
+		size_t oldCapacity = capacity;
+		data = alloc<allocator, Record>(newCapacity);
+		capacity = newCapacity;
+		placeParallel(oldCapacity, [&](size_t i, const K*& key, const V*& value){
+			if(!isOccupied(oldData[i])) return false;
+			key = &oldData[i].key;
+			value = &oldData[i].value;
+			return true;
+		}, threads);
+		dealloc<allocator>(oldData);
+	}
+	
+	// Fills an uncleared table with the entries source gives for [0, count), replacing the map's contents.
+	// The table is split into one contiguous region of home slots per thread. The entries are counted and
+	// scattered by region, then each thread clears its region and inserts into it without probing past
+	// its end. The few entries that would have are inserted afterwards on one thread.
+	template<typename F>
+	void placeParallel(size_t count, F source, size_t threads){
+		constexpr size_t MIN_CHUNK_SIZE = 1 << 14;
+		struct Entry{
+			K key;
+			V value;
+		};
+		if(threads == 0) threads = getParallelThreadCount();
+		size_t chunks = 1;
+		while(chunks * 2 <= threads && count / (chunks * 2) >= MIN_CHUNK_SIZE && capacity / (chunks * 2) >= MIN_CHUNK_SIZE) chunks *= 2;
+		size = 0;
+		const K* key;
+		const V* value;
+		if(chunks == 1){
+			clear();
+			for(size_t i = 0; i < count; i++) if(source(i, key, value)) upsertReserved(*key, *value);
+			return;
+		}
+		
+		size_t regionShift = countTrailingZeros(uint64_t(capacity / chunks));
+		// counts[chunk * chunks + region] is how many of a chunk's entries go to a region, then where they start.
+		size_t* counts = alloc<allocator, size_t>(chunks * chunks);
+		size_t* regionStarts = alloc<allocator, size_t>(chunks + 1);
+		parallelFor(chunks, [&](size_t chunk){
+			size_t* chunkCounts = counts + chunk * chunks;
+			const K* key;
+			const V* value;
+			for(size_t region = 0; region < chunks; region++) chunkCounts[region] = 0;
+			for(size_t i = count * chunk / chunks; i < count * (chunk + 1) / chunks; i++){
+				if(source(i, key, value)) chunkCounts[getHash(*key) >> regionShift]++;
+			}
+		});
+		size_t total = 0;
+		for(size_t region = 0; region < chunks; region++){
+			regionStarts[region] = total;
+			for(size_t chunk = 0; chunk < chunks; chunk++){
+				size_t chunkCount = counts[chunk * chunks + region];
+				counts[chunk * chunks + region] = total;
+				total += chunkCount;
+			}
+		}
+		regionStarts[chunks] = total;
+		
+		Entry* entries = alloc<allocator, Entry>(max(total, size_t(1)));
+		parallelFor(chunks, [&](size_t chunk){
+			size_t* offsets = counts + chunk * chunks;
+			const K* key;
+			const V* value;
+			for(size_t i = count * chunk / chunks; i < count * (chunk + 1) / chunks; i++){
+				if(source(i, key, value)) entries[offsets[getHash(*key) >> regionShift]++] = {*key, *value};
+			}
+		});
+		
+		// Entries that reach the end of their region are moved to the front of the region's entries,
+		// regionOverflows[region] counts them and regionSizes[region] the ones inserted. Both reuse counts.
+		size_t* regionOverflows = counts;
+		size_t* regionSizes = counts + chunks;
+		parallelFor(chunks, [&](size_t region){
+			size_t first = region << regionShift;
+			size_t last = (region + 1) << regionShift;
+			for(size_t i = first; i < last; i++) setUnused(data[i]);
+			size_t overflows = 0, inserted = 0;
+			for(size_t e = regionStarts[region]; e < regionStarts[region + 1]; e++){
+				Entry& entry = entries[e];
+				size_t i = getHash(entry.key);
+				while(i < last && isOccupied(data[i]) && !comparer(data[i].key, entry.key)) i++;
+				if(i == last){
+					entries[regionStarts[region] + overflows++] = entry;
+				}else if(isOccupied(data[i])){
+					data[i].value = entry.value;
+				}else{
+					setOccupied(data[i], entry.key, entry.value);
+					inserted++;
+				}
+			}
+			regionOverflows[region] = overflows;
+			regionSizes[region] = inserted;
+		});
+		for(size_t region = 0; region < chunks; region++){
+			size += regionSizes[region];
+			Entry* overflows = entries + regionStarts[region];
+			for(size_t e = 0; e < regionOverflows[region]; e++) upsertReserved(overflows[e].key, overflows[e].value);
+		}
+		
+		dealloc<allocator>(entries);
+		dealloc<allocator>(regionStarts);
+		dealloc<allocator>(counts);
+		recount();
+	}
+	
+	// Insert or replace when the capacity is known to be enough already.
+	ALWAYS_INLINE void upsertReserved(const K& key, const V& value){
+		Record* record = getRecord(key);
+		if(record){
+			record->value = value;
+			return;
+		}
+		place(getUnusedRecord(key), key, value);
+	}
+	
+	// Fills a record from getUnusedRecord and counts it.
+	ALWAYS_INLINE V& place(Record& record, const K& key, const V& value){
+		if(isDeleted(record)) tombstones--;
+		setOccupied(record, key, value);
+		countProbe(record);
+		size++;
+		return record.value;
+	}
+	
+	ALWAYS_INLINE void countProbe(const Record& record){
+		size_t probe = getProbe(record);
+		totalProbe += probe;
+		maxProbe = max(maxProbe, probe);
+	}
+	
+	// Recomputes the counters from the records, after anything that moves records around in bulk.
+	void recount(){
+		tombstones = totalProbe = maxProbe = 0;
+		for(size_t i = 0; i < capacity; i++){
+			if(isDeleted(data[i])) tombstones++;
+			else if(isOccupied(data[i])) countProbe(data[i]);
+		}
+	}
+	
+	ALWAYS_INLINE HashMapStats getStats(){return {size, capacity, tombstones, totalProbe, maxProbe};}
+	
+	// Runs whatever the maintenance policy asks for. insert calls this, call it after removing many keys
+	// from a map that won't see another insert for a while.
+	void maintain(){
+		switch(maintenance::check(getStats())){
+			case HashMaintenance::NONE: break;
+			case HashMaintenance::CLEAN: clearGravestones(); break;
+			case HashMaintenance::GROW: rehash(capacity << 1); break;
+		}
+	}
+	
+	// How many records are each distance from their home slot, with the last entry counting everything
+	// at its distance or further. Scans the whole table, for debugging and tuning a hash.
+	void getProbeHistogram(ArrayView<size_t> histogram){
+		ZSL_ASSERT(histogram.size > 0);
+		for(size_t& count: histogram) count = 0;
+		for(size_t i = 0; i < capacity; i++){
+			if(isOccupied(data[i])) histogram[min(getProbe(data[i]), histogram.size - 1)]++;
 		}
 	}
 	
@@ -176,35 +528,30 @@ struct HashMap{
 	
 	void clearGravestones(){
 		bool deletedGroup = false;
-		for(size_t i = 0; i < capacity || deletedGroup; i = BIT_MODULO(i + 1, capacity)){
-			Record& record = data[i];
-			if(record.type == RecordType::DELETED){
-				record.type == RecordType::UNUSED;
+		// Keeps going past the end while in a group, since the records after it wrap around to the start.
+		for(size_t n = 0; n < capacity || deletedGroup; n++){
+			Record& record = data[BIT_MODULO(n, capacity)];
+			if(isDeleted(record)){
+				setUnused(record);
 				deletedGroup = true;
 				continue;
-			}else if(record.type == RecordType::UNUSED){
+			}else if(isUnused(record)){
 				deletedGroup = false;
 				continue;
 			}
 			// Must be occupied by process-of-elimination.
 			if(deletedGroup){
-				record.type = RecordType::UNUSED;
-				Record& newRecord = getUnusedRecord(record.key);
-				newRecord = {record.key, record.value, RecordType::OCCUPIED};
+				Record moved = record;
+				setUnused(record);
+				Record& newRecord = getUnusedRecord(moved.key);
+				newRecord = moved;
 			}
 		}
+		recount();
 	}
 	
-	size_t getCollisionScore(){
-		size_t score = 0;
-		for(size_t i = 0; i < capacity; i++){
-			Record& record = data[i];
-			if(record.type != RecordType::OCCUPIED) continue;
-			size_t hash = getHash(record.key);
-			score += BIT_MODULO(i - hash, capacity);
-		}
-		return score;
-	}
+	// The sum of every record's distance from its home slot.
+	ALWAYS_INLINE size_t getCollisionScore(){return totalProbe;}
 	
 	void optimize(size_t maxCollisionScore, size_t maxCapacity = SIZE_MAX){
 		while(getCollisionScore() > maxCollisionScore && capacity < maxCapacity) rehash(capacity << 1);
@@ -214,7 +561,7 @@ struct HashMap{
 		Self& map;
 		size_t i;
 		ALWAYS_INLINE IteratorBase(Self& m, size_t initial = 0): map(m), i(initial){next();}
-		ALWAYS_INLINE void next(){while(i < map.capacity && map.data[i].type != RecordType::OCCUPIED) i++;}
+		ALWAYS_INLINE void next(){while(i < map.capacity && !isOccupied(map.data[i])) i++;}
 		ALWAYS_INLINE void operator++(){i++; next();}
 		ALWAYS_INLINE bool operator==(IteratorBase& other){return i == other.i;}
 		ALWAYS_INLINE bool operator!=(IteratorBase& other){return i != other.i;}
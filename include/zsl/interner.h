@@ -0,0 +1,53 @@
+#pragma once
+#include "core.h"
+#include "atomics.h"
+#include "hash_map.h"
+#include "array_list.h"
+#include "string_utils.h"
+
+namespace zsl{
+
+// Names an interned string, two ids of the same interner are equal exactly when their strings are.
+using InternId = uint32_t;
+
+// Copies each distinct string into an arena once and hands out a dense id for it, so strings that get
+// hashed and compared over and over (metric names, field names, tags) become integers.
+// Interning takes a lock, resolving an id doesn't: strings are never moved or freed before deinit, and
+// the id to string table reserves its address space up front so it never moves either. Any thread that
+// was handed an id can read its string.
+struct Interner{
+	static constexpr InternId NONE = UINT32_MAX;
+	static constexpr size_t DEFAULT_MAX_COUNT = size_t(1) << 24;
+	
+	Mutex mutex;
+	Arena arena;
+	// Id to string.
+	VirtualArrayList<StringView> strings;
+	// How many of strings are filled in, stored with release after the string is.
+	size_t count;
+	HashMap<StringView, InternId> ids;
+	
+	void init(size_t maxCount = DEFAULT_MAX_COUNT);
+	void deinit();
+	// The id of string, copying it in if it's new.
+	InternId intern(StringView string);
+	// Interns many strings taking the lock once, results[i] is the id of values[i].
+	void intern(ArrayView<StringView> values, InternId* results);
+	// The id of string if it's interned, NONE otherwise.
+	InternId find(StringView string);
+	
+	// The interned copy, null terminated and valid until deinit.
+	ALWAYS_INLINE StringView get(InternId id){
+		// The acquire pairs with the release in internLocked, it has to happen with asserts off too.
+		size_t published = atomicLoad(&count, ORDER_ACQUIRE);
+		ZSL_ASSERT(id < published);
+		(void)published;
+		return strings.data[id];
+	}
+	ALWAYS_INLINE const char* getPointer(InternId id){return get(id).data;}
+	ALWAYS_INLINE size_t getCount(){return atomicLoad(&count, ORDER_ACQUIRE);}
+	
+	InternId internLocked(StringView string);
+};
+
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include "core.h"
+#include "array_list.h"
+
+namespace zsl{
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------- Files ------------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+#if defined(ZSL_WINDOWS)
+using FileHandle = HANDLE;
+#elif defined(ZSL_LINUX)
+using FileHandle = int;
+#endif
+
+enum FileMode: uint32_t{
+	FILE_READ     = 1 << 0,
+	FILE_WRITE    = 1 << 1,
+	FILE_CREATE   = 1 << 2,
+	FILE_TRUNCATE = 1 << 3,
+	FILE_APPEND   = 1 << 4,
+	// Bypass the page cache. Buffers, sizes and offsets must be aligned to the device block size.
+	FILE_DIRECT   = 1 << 5,
+};
+
+struct File{
+	FileHandle handle;
+	bool isValid();
+};
+
+// Functions returning int64_t return a negative value on failure.
+File fileOpen(const char* path, uint32_t mode);
+void fileClose(File);
+int64_t fileRead(File, void* buffer, size_t size, size_t offset);
+int64_t fileWrite(File, const void* buffer, size_t size, size_t offset);
+bool fileSync(File);
+int64_t fileSize(File);
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Mapping -----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+enum MappingFlags: uint32_t{
+	// Writes to the mapping are written back to the file.
+	MAPPING_WRITE      = 1 << 0,
+	// Aggressive read ahead, pages behind the reader may be dropped early.
+	MAPPING_SEQUENTIAL = 1 << 1,
+	// Disable read ahead.
+	MAPPING_RANDOM     = 1 << 2,
+	// Start reading the range in the background.
+	MAPPING_WILL_NEED  = 1 << 3,
+	// Fault every page in before returning.
+	MAPPING_POPULATE   = 1 << 4,
+	// Back the range with transparent huge pages where the file system supports it.
+	MAPPING_HUGE_PAGES = 1 << 5,
+};
+
+// Maps the whole file. Returns an empty view if the file can't be mapped or is empty.
+ArrayView<char> mapFile(const char* path, uint32_t flags = 0);
+ArrayView<char> mapFile(File, uint32_t flags = 0);
+void unmapFile(ArrayView<char>);
+// Applies the advice flags (SEQUENTIAL, RANDOM, WILL_NEED, HUGE_PAGES) to part of a mapping.
+void adviseMapping(ArrayView<char>, uint32_t flags);
+// Drops the pages of part of a mapping from this process. They stay in the page
+// cache and fault back in from the file if touched again.
+void releaseMapping(ArrayView<char>);
+
+// Hands out consecutive windows of a mapped file without copying.
+// Pages ahead of the reader are prefetched and pages behind it are released,
+// so resident memory stays around a few windows no matter how big the file is.
+struct FileReader{
+	static inline constexpr size_t DEFAULT_WINDOW_SIZE = size_t(4) * 1024 * 1024;
+	
+	ArrayView<char> file;
+	size_t windowSize;
+	size_t position;
+	size_t released;
+	
+	static FileReader init(const char* path, size_t windowSize = DEFAULT_WINDOW_SIZE);
+	ALWAYS_INLINE bool isValid(){return file.data != nullptr;}
+	ALWAYS_INLINE bool isDone(){return position >= file.size;}
+	// Returns the next window, which is empty once the whole file was read.
+	ArrayView<char> next();
+	// Steps back so the last bytes of the previous window start the next one.
+	// Use it to keep a record that straddles two windows in one piece.
+	void unread(size_t bytes);
+	void deinit();
+};
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Async IO ----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+struct IoCompletion{
+	void* userData;
+	// Bytes transferred, or a negative error code.
+	int64_t result;
+};
+
+enum class IoOperation: uint8_t{
+	READ,
+	WRITE,
+	READ_FIXED,
+	WRITE_FIXED,
+	SYNC,
+};
+
+struct IoRequest{
+	IoOperation operation;
+	uint32_t bufferIndex;
+	File file;
+	void* buffer;
+	size_t size;
+	size_t offset;
+	void* userData;
+};
+
+// Batched asynchronous file IO. Uses io_uring when the kernel allows it and
+// falls back to performing the requests with blocking calls inside submit() otherwise.
+// Requests are only queued until submit() (or wait()) is called, so a whole batch costs one syscall.
+// Any thread may queue and submit requests, completions should be reaped by one thread at a time.
+struct IoQueue{
+	static inline constexpr uint32_t DEFAULT_ENTRIES = 256;
+	
+	int ring;// -1 when using the blocking fallback.
+	bool kernelPolling;
+	uint32_t entries;
+	uint32_t localTail;
+	uint32_t* sqHead;
+	uint32_t* sqTail;
+	uint32_t* sqMask;
+	uint32_t* sqFlags;
+	uint32_t* sqArray;
+	void* sqes;
+	uint32_t* cqHead;
+	uint32_t* cqTail;
+	uint32_t* cqMask;
+	void* cqes;
+	void* sqRing;
+	size_t sqRingSize;
+	void* cqRing;
+	size_t cqRingSize;
+	size_t sqesSize;
+	
+	// Requests waiting for submit() in the blocking fallback.
+	ArrayList<IoRequest> pending;
+	// Finished requests poll() hands out before reading the completion ring.
+	ArrayList<IoCompletion> completed;
+	Mutex submitMutex;
+	Mutex completeMutex;
+	
+	// With kernelPolling a kernel thread picks requests up without any syscall at all,
+	// at the cost of a busy core. Ignored if the kernel refuses it.
+	void init(uint32_t entries = DEFAULT_ENTRIES, bool kernelPolling = false);
+	void deinit();
+	ALWAYS_INLINE bool isAsync(){return ring >= 0;}
+	
+	// Pins buffers in the kernel so fixed reads and writes skip the per request page mapping.
+	// Buffers typically come from an Arena and must stay alive until deinit.
+	bool registerBuffers(ArrayView<ArrayView<char>> buffers);
+	
+	void read(File, void* buffer, size_t size, size_t offset, void* userData);
+	void write(File, const void* buffer, size_t size, size_t offset, void* userData);
+	// Buffer must lie inside the registered buffer bufferIndex.
+	void readFixed(File, uint32_t bufferIndex, void* buffer, size_t size, size_t offset, void* userData);
+	void writeFixed(File, uint32_t bufferIndex, const void* buffer, size_t size, size_t offset, void* userData);
+	void sync(File, void* userData);
+	
+	// Hands every queued request to the kernel and returns how many there were. Requests the kernel
+	// refuses stay queued and go with the next submit.
+	uint32_t submit();
+	// Copies out finished requests without blocking.
+	size_t poll(ArrayView<IoCompletion> completions);
+	// Submits queued requests and blocks until at least minimum requests finished, or returns early
+	// if the kernel refuses them.
+	size_t wait(ArrayView<IoCompletion> completions, size_t minimum = 1);
+	
+	// Requests of 4 GiB and more complete with -EINVAL.
+	void queue(const IoRequest&);
+	// Publishes the queued entries and enters until the kernel consumed them. Returns zero, or a
+	// negative error code if the kernel refused them. Needs submitMutex.
+	int flush();
+	// io_uring_enter that retries when interrupted or out of resources, and reaps completions into
+	// completed when the completion ring is backed up.
+	int enter(uint32_t submit, uint32_t minimum, uint32_t flags);
+	// Moves everything in the completion ring to completed, returns whether there was anything.
+	bool stashCompletions();
+	void complete(void* userData, int64_t result);
+};
+
+}
@@ -0,0 +1,504 @@
+#pragma once
+#include "core.h"
+#include "string.h"
+#include "array_list.h"
+#include "sort.h"
+#if defined(__SSE2__)
+	#include "immintrin.h"
+#endif
+
+namespace zsl{
+
+// Number of keys less than key in a sorted node, the in-node search of OrderedMap for integer keys.
+// Counting every key instead of stopping at the first larger one leaves no branch to mispredict.
+// Inline rather than dispatched at runtime (see cpu.h), a call per node costs more than the scan,
+// so AVX2 is used when the build targets it and SSE2 otherwise. There are only signed compares,
+// flipping the top bit maps unsigned order onto signed order. A compare gives -1 in every lane
+// where the key is less, subtracting it counts them.
+template<typename T>
+ALWAYS_INLINE size_t countLess(const T* keys, size_t count, T key){
+	static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Only 32 and 64 bit keys.");
+	constexpr bool isSigned = T(-1) < T(0);
+	size_t i = 0;
+	size_t less = 0;
+#if defined(__AVX2__)
+	if constexpr(sizeof(T) == 4){
+		const __m256i flip = _mm256_set1_epi32(isSigned ? 0 : INT32_MIN);
+		const __m256i pivot = _mm256_xor_si256(_mm256_set1_epi32(key), flip);
+		__m256i total = _mm256_setzero_si256();
+		for(; i + 8 <= count; i += 8){
+			__m256i block = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), flip);
+			total = _mm256_sub_epi32(total, _mm256_cmpgt_epi32(pivot, block));
+		}
+		__m128i half = _mm_add_epi32(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+		less = _mm_cvtsi128_si32(half);
+	}else{
+		const __m256i flip = _mm256_set1_epi64x(isSigned ? 0 : INT64_MIN);
+		const __m256i pivot = _mm256_xor_si256(_mm256_set1_epi64x(key), flip);
+		__m256i total = _mm256_setzero_si256();
+		for(; i + 4 <= count; i += 4){
+			__m256i block = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), flip);
+			total = _mm256_sub_epi64(total, _mm256_cmpgt_epi64(pivot, block));
+		}
+		__m128i half = _mm_add_epi64(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+		less = _mm_cvtsi128_si64(half) + _mm_extract_epi64(half, 1);
+	}
+#elif defined(__SSE2__)
+	if constexpr(sizeof(T) == 4){
+		const __m128i flip = _mm_set1_epi32(isSigned ? 0 : INT32_MIN);
+		const __m128i pivot = _mm_xor_si128(_mm_set1_epi32(key), flip);
+		__m128i total = _mm_setzero_si128();
+		for(; i + 4 <= count; i += 4){
+			__m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(keys + i)), flip);
+			total = _mm_sub_epi32(total, _mm_cmpgt_epi32(pivot, block));
+		}
+		total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(1, 0, 3, 2)));
+		total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2, 3, 0, 1)));
+		less = _mm_cvtsi128_si32(total);
+	}
+#endif
+	for(; i < count; i++) less += keys[i] < key;
+	return less;
+}
+
+// Hands out fixed size nodes carved from larger blocks, so a tree with millions of nodes only makes
+// a few thousand allocator calls and its nodes sit next to each other. Freed nodes are reused, but
+// the blocks only go back to the allocator in deinit.
+template<size_t nodeSize, Allocator allocator = ZSL_DEFAULT_ALLOCATOR>
+struct NodePool{
+	using Self = NodePool<nodeSize, allocator>;
+	// Rounded to cache lines so no node straddles more lines than it has to.
+	static constexpr size_t NODE_SIZE = (nodeSize + 63) & ~size_t(63);
+	static constexpr size_t NODES_PER_BLOCK = 64;
+	
+	struct FreeNode{
+		FreeNode* next;
+	};
+	
+	// The first node of every block links the blocks together.
+	FreeNode* blocks;
+	FreeNode* free;
+	// Untouched part of the newest block.
+	char* fresh;
+	char* freshEnd;
+	
+	static Self init(){return {nullptr, nullptr, nullptr, nullptr};}
+	
+	void deinit(){
+		while(blocks){
+			FreeNode* next = blocks->next;
+			dealloc<allocator>(blocks);
+			blocks = next;
+		}
+		*this = init();
+	}
+	
+	void* get(){
+		if(free){
+			void* node = free;
+			free = free->next;
+			return node;
+		}
+		if(fresh == freshEnd){
+			FreeNode* block = (FreeNode*)allocator(nullptr, NODE_SIZE * NODES_PER_BLOCK, 64);
+			block->next = blocks;
+			blocks = block;
+			fresh = (char*)block + NODE_SIZE;
+			freshEnd = (char*)block + NODE_SIZE * NODES_PER_BLOCK;
+		}
+		void* node = fresh;
+		fresh += NODE_SIZE;
+		return node;
+	}
+	
+	ALWAYS_INLINE void put(void* node){
+		FreeNode* freed = (FreeNode*)node;
+		freed->next = free;
+		free = freed;
+	}
+};
+
+// A B+-tree. Nodes are a few cache lines wide so the tree stays shallow and a lookup touches a handful
+// of nodes, keys are stored apart from values so the in-node search only reads keys, and the leaves
+// are linked so iteration and range scans walk them in key order without going back up the tree.
+// Removal doesn't rebalance, a node only goes away once it is empty. A map that shrinks a lot and
+// stays that way should be rebuilt with init(sorted).
+template<typename K, typename V, Allocator allocator = ZSL_DEFAULT_ALLOCATOR, typename F = Less>
+struct OrderedMap{
+	using KeyType = K;
+	using ValueType = V;
+	using Self = OrderedMap<K, V, allocator, F>;
+	static constexpr size_t NODE_SIZE = 256;
+	static constexpr size_t LEAF_FIT = (NODE_SIZE - 3 * sizeof(void*)) / (sizeof(K) + sizeof(V));
+	static constexpr size_t INNER_FIT = (NODE_SIZE - 2 * sizeof(void*)) / (sizeof(K) + sizeof(void*));
+	// Splits need at least a few entries per node, large keys or values make nodes bigger instead.
+	static constexpr size_t LEAF_CAPACITY = LEAF_FIT > 4 ? LEAF_FIT : 4;
+	static constexpr size_t INNER_CAPACITY = INNER_FIT > 4 ? INNER_FIT : 4;
+	
+	struct Leaf{
+		uint32_t count;
+		Leaf* previous;
+		Leaf* next;
+		K keys[LEAF_CAPACITY];
+		V values[LEAF_CAPACITY];
+	};
+	
+	// keys[i] is the largest key child i may hold. The last child is bounded by the parent.
+	struct Inner{
+		// Number of keys, there is one more child.
+		uint32_t count;
+		K keys[INNER_CAPACITY];
+		void* children[INNER_CAPACITY + 1];
+	};
+	
+	struct Record{
+		K key;
+		V value;
+	};
+	
+	struct Entry{
+		const K& key;
+		V& value;
+	};
+	
+	// Null when the map is empty.
+	void* root;
+	Leaf* firstLeaf;
+	// Levels of inner nodes above the leaves.
+	size_t height;
+	size_t size;
+	NodePool<sizeof(Leaf) < sizeof(Inner) ? sizeof(Inner) : sizeof(Leaf), allocator> pool;
+	
+	static Self init(){
+		Self self;
+		self.root = nullptr;
+		self.firstLeaf = nullptr;
+		self.height = 0;
+		self.size = 0;
+		self.pool = decltype(self.pool)::init();
+		return self;
+	}
+	
+	// Bulk load from records sorted by strictly increasing key. Builds the tree bottom up with full
+	// leaves, which is much faster than inserting one by one and gives the shallowest tree for lookups.
+	static Self init(ArrayView<Record> sorted){
+		Self self = init();
+		if(sorted.size == 0) return self;
+		size_t count = (sorted.size + LEAF_CAPACITY - 1) / LEAF_CAPACITY;
+		void** nodes = alloc<allocator, void*>(count);
+		K* bounds = alloc<allocator, K>(count);
+		Leaf* previous = nullptr;
+		size_t next = 0;
+		for(size_t n = 0; n < count; n++){
+			// Spread the remainder so the last leaf isn't left with a few keys.
+			size_t take = (sorted.size - next + count - n - 1) / (count - n);
+			Leaf* leaf = self.newLeaf();
+			leaf->count = take;
+			leaf->previous = previous;
+			if(previous) previous->next = leaf;
+			else self.firstLeaf = leaf;
+			for(size_t j = 0; j < take; j++, next++){
+				ZSL_ASSERT(next == 0 || F()(sorted.data[next - 1].key, sorted.data[next].key));
+				leaf->keys[j] = sorted.data[next].key;
+				leaf->values[j] = sorted.data[next].value;
+			}
+			nodes[n] = leaf;
+			bounds[n] = leaf->keys[take - 1];
+			previous = leaf;
+		}
+		// Each level is built from the one below it in the same arrays, a parent is never written
+		// before its children are read.
+		while(count > 1){
+			size_t parents = (count + INNER_CAPACITY) / (INNER_CAPACITY + 1);
+			next = 0;
+			for(size_t n = 0; n < parents; n++){
+				size_t take = (count - next + parents - n - 1) / (parents - n);
+				Inner* inner = self.newInner();
+				inner->count = take - 1;
+				copyElements(inner->keys, bounds + next, take - 1);
+				copyElements(inner->children, nodes + next, take);
+				nodes[n] = inner;
+				bounds[n] = bounds[next + take - 1];
+				next += take;
+			}
+			count = parents;
+			self.height++;
+		}
+		self.root = nodes[0];
+		self.size = sorted.size;
+		dealloc<allocator>(nodes);
+		dealloc<allocator>(bounds);
+		return self;
+	}
+	
+	ALWAYS_INLINE void deinit(){pool.deinit();}
+	
+	void clear(){
+		pool.deinit();
+		*this = init();
+	}
+	
+	// The scan wins when a vector covers several keys, 64 bit keys without AVX2 (pcmpgtq needs SSE4.2)
+	// take the branchless binary search instead.
+	static ALWAYS_INLINE size_t search(const K* keys, size_t count, const K& key){
+		constexpr bool isInteger = isTypeEqual<K, int32_t> || isTypeEqual<K, uint32_t> || isTypeEqual<K, int64_t> || isTypeEqual<K, uint64_t>;
+#if defined(__AVX2__)
+		constexpr bool hasScan = isInteger;
+#elif defined(__SSE2__)
+		constexpr bool hasScan = isInteger && sizeof(K) == 4;
+#else
+		constexpr bool hasScan = false;
+#endif
+		if constexpr(hasScan && isTypeEqual<F, Less>) return countLess(keys, count, key);
+		else return zsl::lowerBound(ArrayView<const K>{count, keys}, key, F());
+	}
+	
+	Leaf* findLeaf(const K& key){
+		void* node = root;
+		for(size_t level = height; level > 0; level--){
+			Inner* inner = (Inner*)node;
+			node = inner->children[search(inner->keys, inner->count, key)];
+		}
+		return (Leaf*)node;
+	}
+	
+	V* find(const K& key){
+		if(!root) return nullptr;
+		Leaf* leaf = findLeaf(key);
+		size_t i = search(leaf->keys, leaf->count, key);
+		return i < leaf->count && !F()(key, leaf->keys[i]) ? &leaf->values[i] : nullptr;
+	}
+	
+	ALWAYS_INLINE bool has(const K& key){return find(key);}
+	
+	V& get(const K& key){
+		V* value = find(key);
+		ZSL_ASSERT(value);
+		return *value;
+	}
+	
+	V& insert(const K& key, const V& value){
+		bool found;
+		V& slot = emplace(key, found);
+		ZSL_ASSERT(!found);
+		slot = value;
+		return slot;
+	}
+	
+	V& operator[](const K& key){
+		bool found;
+		V& slot = emplace(key, found);
+		if(!found) slot = V{};
+		return slot;
+	}
+	
+	// Returns the value of key, making room for it first if it isn't in the map. The value of a new
+	// key is left uninitialized, found says which one happened.
+	V& emplace(const K& key, bool& found){
+		if(!root){
+			Leaf* leaf = newLeaf();
+			leaf->count = 0;
+			root = firstLeaf = leaf;
+		}
+		V* slot;
+		K separator;
+		void* right = insertInto(root, height, key, true, slot, found, separator);
+		if(right){
+			Inner* top = newInner();
+			top->count = 1;
+			top->keys[0] = separator;
+			top->children[0] = root;
+			top->children[1] = right;
+			root = top;
+			height++;
+		}
+		if(!found) size++;
+		return *slot;
+	}
+	
+	// Returns false if key wasn't in the map.
+	bool remove(const K& key){
+		if(!root) return false;
+		bool removed = false;
+		if(removeFrom(root, height, key, removed)){
+			root = firstLeaf = nullptr;
+			height = 0;
+		}
+		if(!removed) return false;
+		size--;
+		// Drop roots left with a single child so lookups don't walk through chains of them.
+		while(height > 0 && ((Inner*)root)->count == 0){
+			void* child = ((Inner*)root)->children[0];
+			pool.put(root);
+			root = child;
+			height--;
+		}
+		return true;
+	}
+	
+	Leaf* newLeaf(){
+		Leaf* leaf = (Leaf*)pool.get();
+		leaf->previous = leaf->next = nullptr;
+		return leaf;
+	}
+	
+	ALWAYS_INLINE Inner* newInner(){return (Inner*)pool.get();}
+	
+	// Finds key or makes room for it under node. When node has to split, the new right sibling is
+	// returned and separator is set to the largest key left in node. rightmost says no key in the
+	// map is larger than the ones under node.
+	void* insertInto(void* node, size_t level, const K& key, bool rightmost, V*& slot, bool& found, K& separator){
+		if(level == 0){
+			Leaf* leaf = (Leaf*)node;
+			size_t i = search(leaf->keys, leaf->count, key);
+			if(i < leaf->count && !F()(key, leaf->keys[i])){
+				found = true;
+				slot = &leaf->values[i];
+				return nullptr;
+			}
+			found = false;
+			Leaf* right = nullptr;
+			if(leaf->count == LEAF_CAPACITY){
+				right = newLeaf();
+				// Ascending inserts would leave every leaf half empty, so appends keep the old leaf full.
+				size_t keep = rightmost && i == leaf->count ? LEAF_CAPACITY : LEAF_CAPACITY / 2;
+				right->count = leaf->count - keep;
+				copyElements(right->keys, leaf->keys + keep, right->count);
+				copyElements(right->values, leaf->values + keep, right->count);
+				leaf->count = keep;
+				right->previous = leaf;
+				right->next = leaf->next;
+				if(leaf->next) leaf->next->previous = right;
+				leaf->next = right;
+				if(i >= keep){
+					leaf = right;
+					i -= keep;
+				}
+			}
+			moveElements(leaf->keys + i + 1, leaf->keys + i, leaf->count - i);
+			moveElements(leaf->values + i + 1, leaf->values + i, leaf->count - i);
+			leaf->keys[i] = key;
+			leaf->count++;
+			slot = &leaf->values[i];
+			if(right){
+				Leaf* left = (Leaf*)node;
+				separator = left->keys[left->count - 1];
+			}
+			return right;
+		}
+		
+		Inner* inner = (Inner*)node;
+		size_t i = search(inner->keys, inner->count, key);
+		K childSeparator;
+		void* child = insertInto(inner->children[i], level - 1, key, rightmost && i == inner->count, slot, found, childSeparator);
+		if(!child) return nullptr;
+		Inner* right = nullptr;
+		if(inner->count == INNER_CAPACITY){
+			right = newInner();
+			size_t keep = rightmost && i == inner->count ? INNER_CAPACITY - 1 : INNER_CAPACITY / 2;
+			// keys[keep] bounds the last child that stays, so it moves up instead of right.
+			separator = inner->keys[keep];
+			right->count = inner->count - keep - 1;
+			copyElements(right->keys, inner->keys + keep + 1, right->count);
+			copyElements(right->children, inner->children + keep + 1, right->count + 1);
+			inner->count = keep;
+			if(i > keep){
+				inner = right;
+				i -= keep + 1;
+			}
+		}
+		// The split child keeps its place and the new one takes over its old bound.
+		moveElements(inner->keys + i + 1, inner->keys + i, inner->count - i);
+		moveElements(inner->children + i + 2, inner->children + i + 1, inner->count - i);
+		inner->keys[i] = childSeparator;
+		inner->children[i + 1] = child;
+		inner->count++;
+		return right;
+	}
+	
+	// Returns true when node ended up empty and went back to the pool.
+	bool removeFrom(void* node, size_t level, const K& key, bool& removed){
+		if(level == 0){
+			Leaf* leaf = (Leaf*)node;
+			size_t i = search(leaf->keys, leaf->count, key);
+			if(i == leaf->count || F()(key, leaf->keys[i])) return false;
+			removed = true;
+			moveElements(leaf->keys + i, leaf->keys + i + 1, leaf->count - i - 1);
+			moveElements(leaf->values + i, leaf->values + i + 1, leaf->count - i - 1);
+			leaf->count--;
+			if(leaf->count) return false;
+			if(leaf->previous) leaf->previous->next = leaf->next;
+			else firstLeaf = leaf->next;
+			if(leaf->next) leaf->next->previous = leaf->previous;
+			pool.put(leaf);
+			return true;
+		}
+		
+		Inner* inner = (Inner*)node;
+		size_t i = search(inner->keys, inner->count, key);
+		if(!removeFrom(inner->children[i], level - 1, key, removed)) return false;
+		if(inner->count == 0){
+			pool.put(inner);
+			return true;
+		}
+		// The next child takes over the range of the removed one. If it was the last child,
+		// the one before it takes over the bound from the parent instead.
+		size_t k = i < inner->count ? i : i - 1;
+		moveElements(inner->keys + k, inner->keys + k + 1, inner->count - k - 1);
+		moveElements(inner->children + i, inner->children + i + 1, inner->count - i);
+		inner->count--;
+		return false;
+	}
+	
+	struct Iterator{
+		Leaf* leaf;
+		size_t i;
+		ALWAYS_INLINE Entry operator*(){return {leaf->keys[i], leaf->values[i]};}
+		ALWAYS_INLINE void operator++(){
+			if(++i == leaf->count){
+				leaf = leaf->next;
+				i = 0;
+			}
+		}
+		ALWAYS_INLINE bool operator==(const Iterator& other) const{return leaf == other.leaf && i == other.i;}
+		ALWAYS_INLINE bool operator!=(const Iterator& other) const{return leaf != other.leaf || i != other.i;}
+	};
+	
+	struct Range{
+		Iterator first;
+		Iterator last;
+		ALWAYS_INLINE Iterator begin(){return first;}
+		ALWAYS_INLINE Iterator end(){return last;}
+	};
+	
+	ALWAYS_INLINE Iterator begin(){return {firstLeaf, 0};}
+	ALWAYS_INLINE Iterator end(){return {nullptr, 0};}
+	
+	// First entry whose key is not less than key, or end().
+	Iterator lowerBound(const K& key){
+		if(!root) return end();
+		Leaf* leaf = findLeaf(key);
+		size_t i = search(leaf->keys, leaf->count, key);
+		// Everything in the next leaf is larger than the bound we followed down here.
+		if(i == leaf->count) return {leaf->next, 0};
+		return {leaf, i};
+	}
+	
+	// First entry whose key is greater than key, or end().
+	Iterator upperBound(const K& key){
+		Iterator it = lowerBound(key);
+		if(it.leaf && !F()(key, it.leaf->keys[it.i])) ++it;
+		return it;
+	}
+	
+	// Entries with keys in [first, last) in increasing order.
+	// for(auto entry: map.range(10, 20)) sum += entry.value;
+	Range range(const K& first, const K& last){
+		ZSL_ASSERT(!F()(last, first));
+		return {lowerBound(first), lowerBound(last)};
+	}
+};
+
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include "core.h"
+#include "atomics.h"
+
+namespace zsl{
+
+// Data parallel loops run on a pool of worker threads. The pool starts the first time a loop needs it
+// and lives until exit. A loop is cut into chunks that the calling thread and the workers take from a
+// shared counter, so one slow chunk doesn't hold up the rest. Only one loop runs on the pool at a time.
+// A loop started while the pool is busy, or from inside another loop, runs on the calling thread alone,
+// so nesting can't deadlock.
+
+using ParallelFunction = void(*)(void* context, size_t chunk);
+
+// Calls function(context, chunk) for every chunk in [0, count) and returns once they have all finished.
+void parallelRun(size_t count, ParallelFunction function, void* context);
+// Workers plus the calling thread.
+size_t getParallelThreadCount();
+// Restarts the pool with threads - 1 workers, zero means one thread per processor. Waits for the running loop.
+void setParallelThreadCount(size_t threads);
+
+// The calling thread's scratch arena. Whatever a loop body allocates from it is freed when the thread
+// is done with its share of the loop. Outside of a loop, free it with a ScratchScope.
+Arena* getScratchArena();
+void* salloc(void*, size_t, size_t);
+
+// Frees everything allocated from this thread's scratch arena while it was open.
+struct ScratchScope{
+	ZSL_SCOPED_OBJECT(ScratchScope);
+	char* mark;
+	ALWAYS_INLINE ScratchScope(): mark(getScratchArena()->mark){}
+	ALWAYS_INLINE ~ScratchScope(){getScratchArena()->mark = mark;}
+};
+
+struct Add{
+	template<typename T>
+	ALWAYS_INLINE T operator()(const T& a, const T& b) const{return a + b;}
+};
+
+// How a loop over count elements is cut up. An explicit grain is the number of elements per chunk.
+// Otherwise there are about CHUNKS_PER_THREAD chunks per thread, to even out chunks that run slower,
+// but none smaller than MIN_GRAIN so waking the workers is worth it.
+struct ParallelChunks{
+	static constexpr size_t MIN_GRAIN = 1 << 12;
+	static constexpr size_t CHUNKS_PER_THREAD = 4;
+	
+	size_t count;
+	size_t size;
+	size_t chunkCount;
+	
+	static ParallelChunks init(size_t count, size_t grain = 0){
+		if(grain == 0){
+			size_t split = getParallelThreadCount() * CHUNKS_PER_THREAD;
+			grain = max(MIN_GRAIN, (count + split - 1) / split);
+		}
+		return {count, grain, (count + grain - 1) / grain};
+	}
+	
+	ALWAYS_INLINE size_t getBegin(size_t chunk){return chunk * size;}
+	ALWAYS_INLINE size_t getEnd(size_t chunk){return min(count, (chunk + 1) * size);}
+};
+
+// Calls function(i) for every i in [0, count) and returns once they have all finished. Each call is
+// its own chunk, use it for a few large tasks.
+template<typename F>
+void parallelFor(size_t count, F function){
+	parallelRun(count, [](void* context, size_t i){(*(F*)context)(i);}, &function);
+}
+
+// Calls function(begin, end) for every chunk of [0, count).
+template<typename F>
+void parallelForRange(size_t count, F function, size_t grain = 0){
+	ParallelChunks chunks = ParallelChunks::init(count, grain);
+	parallelFor(chunks.chunkCount, [&](size_t chunk){function(chunks.getBegin(chunk), chunks.getEnd(chunk));});
+}
+
+template<typename T, typename F>
+void parallelForEach(ArrayView<T> values, F function, size_t grain = 0){
+	parallelForRange(values.size, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++) function(values.data[i]);
+	}, grain);
+}
+
+// to[i] = function(from[i]), to can be from.data.
+template<typename T, typename U, typename F>
+void parallelTransform(ArrayView<T> from, U* to, F function, size_t grain = 0){
+	parallelForRange(from.size, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++) to[i] = function(from.data[i]);
+	}, grain);
+}
+
+// Folds the values with combine, which must be associative, starting from identity. Chunks are folded
+// in order and so are their results, so with the same chunks the result is the same every run,
+// floating point included.
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR, typename T, typename F = Add>
+T parallelReduce(ArrayView<T> values, T identity, F combine = F(), size_t grain = 0){
+	ParallelChunks chunks = ParallelChunks::init(values.size, grain);
+	if(chunks.chunkCount <= 1){
+		for(size_t i = 0; i < values.size; i++) identity = combine(identity, values.data[i]);
+		return identity;
+	}
+	T* partials = alloc<allocator, T>(chunks.chunkCount);
+	parallelFor(chunks.chunkCount, [&](size_t chunk){
+		T result = identity;
+		for(size_t i = chunks.getBegin(chunk); i < chunks.getEnd(chunk); i++) result = combine(result, values.data[i]);
+		partials[chunk] = result;
+	});
+	T result = identity;
+	for(size_t chunk = 0; chunk < chunks.chunkCount; chunk++) result = combine(result, partials[chunk]);
+	dealloc<allocator>(partials);
+	return result;
+}
+
+// Scans run in two passes. The first folds each chunk on its own, the chunk totals are scanned on the
+// calling thread, then the second pass scans each chunk starting from everything before it. The input
+// is read twice and the output written once.
+
+// Folds each chunk of from into totals[chunk].
+template<typename T, typename F>
+void parallelScanTotals(ArrayView<T> from, ParallelChunks& chunks, T* totals, F& combine){
+	parallelFor(chunks.chunkCount, [&](size_t chunk){
+		size_t begin = chunks.getBegin(chunk), end = chunks.getEnd(chunk);
+		T total = from.data[begin];
+		for(size_t i = begin + 1; i < end; i++) total = combine(total, from.data[i]);
+		totals[chunk] = total;
+	});
+}
+
+// to[i] = from[0] combine ... combine from[i], to can be from.data.
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR, typename T, typename F = Add>
+void parallelInclusiveScan(ArrayView<T> from, T* to, F combine = F(), size_t grain = 0){
+	if(from.size == 0) return;
+	ParallelChunks chunks = ParallelChunks::init(from.size, grain);
+	if(chunks.chunkCount <= 1){
+		to[0] = from.data[0];
+		for(size_t i = 1; i < from.size; i++) to[i] = combine(to[i - 1], from.data[i]);
+		return;
+	}
+	T* totals = alloc<allocator, T>(chunks.chunkCount);
+	parallelScanTotals(from, chunks, totals, combine);
+	// totals[chunk] becomes everything before the chunk, the first chunk has nothing before it.
+	T total = totals[0];
+	for(size_t chunk = 1; chunk < chunks.chunkCount; chunk++){
+		T value = totals[chunk];
+		totals[chunk] = total;
+		total = combine(total, value);
+	}
+	parallelFor(chunks.chunkCount, [&](size_t chunk){
+		size_t begin = chunks.getBegin(chunk), end = chunks.getEnd(chunk);
+		T total = chunk ? combine(totals[chunk], from.data[begin]) : from.data[begin];
+		to[begin] = total;
+		for(size_t i = begin + 1; i < end; i++) to[i] = total = combine(total, from.data[i]);
+	});
+	dealloc<allocator>(totals);
+}
+
+// to[i] = initial combine from[0] combine ... combine from[i - 1], to can be from.data.
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR, typename T, typename F = Add>
+void parallelExclusiveScan(ArrayView<T> from, T* to, T initial, F combine = F(), size_t grain = 0){
+	ParallelChunks chunks = ParallelChunks::init(from.size, grain);
+	if(chunks.chunkCount <= 1){
+		for(size_t i = 0; i < from.size; i++){
+			T value = from.data[i];
+			to[i] = initial;
+			initial = combine(initial, value);
+		}
+		return;
+	}
+	T* totals = alloc<allocator, T>(chunks.chunkCount);
+	parallelScanTotals(from, chunks, totals, combine);
+	T total = initial;
+	for(size_t chunk = 0; chunk < chunks.chunkCount; chunk++){
+		T value = totals[chunk];
+		totals[chunk] = total;
+		total = combine(total, value);
+	}
+	parallelFor(chunks.chunkCount, [&](size_t chunk){
+		T total = totals[chunk];
+		for(size_t i = chunks.getBegin(chunk); i < chunks.getEnd(chunk); i++){
+			T value = from.data[i];
+			to[i] = total;
+			total = combine(total, value);
+		}
+	});
+	dealloc<allocator>(totals);
+}
+
+// Copies the values predicate returns true for to to, keeping their order, and returns how many there
+// were. predicate is called once per value. to must not overlap from.
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR, typename T, typename F>
+size_t parallelFilter(ArrayView<T> from, T* to, F predicate, size_t grain = 0){
+	ParallelChunks chunks = ParallelChunks::init(from.size, grain);
+	if(chunks.chunkCount <= 1){
+		size_t count = 0;
+		for(size_t i = 0; i < from.size; i++) if(predicate(from.data[i])) to[count++] = from.data[i];
+		return count;
+	}
+	// Each chunk keeps its picks, then once the offsets are known copies them out.
+	bool* picked = alloc<allocator, bool>(from.size);
+	size_t* offsets = alloc<allocator, size_t>(chunks.chunkCount);
+	parallelFor(chunks.chunkCount, [&](size_t chunk){
+		size_t count = 0;
+		for(size_t i = chunks.getBegin(chunk); i < chunks.getEnd(chunk); i++){
+			picked[i] = predicate(from.data[i]);
+			count += picked[i];
+		}
+		offsets[chunk] = count;
+	});
+	size_t total = 0;
+	for(size_t chunk = 0; chunk < chunks.chunkCount; chunk++){
+		size_t count = offsets[chunk];
+		offsets[chunk] = total;
+		total += count;
+	}
+	parallelFor(chunks.chunkCount, [&](size_t chunk){
+		T* out = to + offsets[chunk];
+		for(size_t i = chunks.getBegin(chunk); i < chunks.getEnd(chunk); i++) if(picked[i]) *out++ = from.data[i];
+	});
+	dealloc<allocator>(offsets);
+	dealloc<allocator>(picked);
+	return total;
+}
+
+}
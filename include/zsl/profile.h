@@ -0,0 +1,114 @@
+#pragma once
+#include "core.h"
+#include "atomics.h"
+#include "clock.h"
+
+namespace zsl{
+
+struct ProfileEvent{
+	const char* name;
+	uint64_t start;// Cycles.
+	uint64_t end;
+};
+
+// Every thread records into its own ring so recording never synchronizes.
+// Once the ring is full the oldest events are overwritten.
+struct ProfileBuffer{
+	static inline constexpr size_t CAPACITY = size_t(1) << 16;// MUST BE POWER OF TWO
+	
+	ProfileBuffer* next;
+	size_t threadIndex;
+	size_t count;// Total events ever recorded, the ring holds the last CAPACITY of them.
+	ProfileEvent events[CAPACITY];
+};
+
+inline thread_local ProfileBuffer* profileBuffer = nullptr;
+ProfileBuffer* registerProfileBuffer();
+
+ALWAYS_INLINE void profileRecord(const char* name, uint64_t start){
+	uint64_t end = readCycles();
+	ProfileBuffer* buffer = profileBuffer;
+	if(!buffer) buffer = registerProfileBuffer();
+	size_t count = buffer->count;
+	buffer->events[BIT_MODULO(count, ProfileBuffer::CAPACITY)] = {name, start, end};
+	atomicStore(&buffer->count, count + 1, ORDER_RELEASE);
+}
+
+// Writes every recorded event in the Chrome trace event format (chrome://tracing, Perfetto).
+// Events recorded while exporting may come out torn, stop the threads you care about first.
+bool profileExport(const char* path);
+// Forgets every recorded event.
+void profileReset();
+
+// Records how long the rest of the enclosing scope takes. The name must outlive the export,
+// string literals are the usual choice. Define ZSL_NO_PROFILE to compile every zone out.
+#ifdef ZSL_NO_PROFILE
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) \
+		uint64_t TOKEN_PASTE(_profile_start_, __LINE__) = ::zsl::readCycles(); \
+		DEFER(::zsl::profileRecord(name, TOKEN_PASTE(_profile_start_, __LINE__)))
+#endif
+
+// --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------- Backtraces ---------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// Backtraces walk the frame pointer chain, which zsl is built to keep (-fno-omit-frame-pointer, exported
+// to everything linking it). A function compiled without frame pointers, like most of libc, can cut the
+// walk short or hide its caller, and GCC leaves them out of leaf functions regardless. The walk never
+// reads outside the stack it started on, and stacks other than a thread's own, like fibers', aren't walked.
+
+// Writes the return addresses of up to maxFrames callers to frames, the caller of captureBacktrace first.
+size_t captureBacktrace(void** frames, size_t maxFrames);
+// Writes the name of the function holding address, or module+offset when it isn't exported (link with
+// -rdynamic to export them), null terminated. Names come out mangled, c++filt undoes that.
+size_t symbolizeAddress(void* address, char* buffer, size_t size);
+// Prints the caller's backtrace to stderr.
+void printBacktrace();
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Sampling ----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+struct ProfileSample{
+	static inline constexpr size_t MAX_DEPTH = 48;
+	
+	uint64_t weight;
+	size_t depth;
+	void* frames[MAX_DEPTH];// Innermost first.
+};
+
+// Like ProfileBuffer every thread records into its own buffer, but a full buffer drops new samples
+// instead of overwriting old ones, since a profile wants every part of the run.
+struct SampleBuffer{
+	static inline constexpr size_t CAPACITY = size_t(1) << 13;
+	
+	SampleBuffer* next;
+	size_t count;// Samples recorded, the ones past CAPACITY were dropped.
+	ProfileSample samples[CAPACITY];
+};
+
+// Samples the stack of whichever thread is running every intervalNanoseconds of CPU time used by the
+// process, from a SIGPROF handler. The kernel rounds the interval up to its tick, often 4 ms. Only one
+// sampler runs per process and it owns SIGPROF and ITIMER_PROF. Threads that didn't come from threadCreate
+// only get their stacks walked once they've called getThreadStack, samplerStart does for its caller.
+bool samplerStart(uint64_t intervalNanoseconds = 1000000);
+void samplerStop();
+// Forgets every recorded sample.
+void samplerReset();
+// Writes the samples as folded stacks, one "outermost;...;innermost count" line per distinct stack. Load
+// it in speedscope or feed it to flamegraph.pl. Stop the sampler first.
+bool samplerExport(const char* path);
+
+// Bytes nalloc hands out between allocation samples on average, zero when allocation sampling is off.
+inline size_t allocationSampleInterval = 0;
+// Makes nalloc record the backtrace of about one allocation every intervalBytes, weighted by the bytes
+// it stands for. Zero turns it off.
+void setAllocationSampling(size_t intervalBytes);
+void recordAllocationSample(size_t size);
+void allocationSamplesReset();
+// Writes the allocation samples as folded stacks weighted by bytes.
+bool allocationSamplesExport(const char* path);
+
+}
@@ -0,0 +1,584 @@
+#pragma once
+#include "core.h"
+#include "parallel.h"
+#include "string.h"
+
+namespace zsl{
+
+struct Less{
+	template<typename T>
+	ALWAYS_INLINE bool operator()(const T& a, const T& b) const{return a < b;}
+};
+
+template<typename T>
+ALWAYS_INLINE void swapValues(T& a, T& b){
+	T temp = static_cast<T&&>(a);
+	a = static_cast<T&&>(b);
+	b = static_cast<T&&>(temp);
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Sorting -----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+template<typename T, typename F>
+void insertionSort(T* begin, T* end, F less){
+	if(begin == end) return;
+	for(T* current = begin + 1; current != end; current++){
+		if(!less(*current, current[-1])) continue;
+		T value = static_cast<T&&>(*current);
+		T* hole = current;
+		do{
+			*hole = static_cast<T&&>(hole[-1]);
+			hole--;
+		}while(hole != begin && less(value, hole[-1]));
+		*hole = static_cast<T&&>(value);
+	}
+}
+
+// Same as insertionSort but assumes there is an element before begin that is not greater
+// than anything in the range, which lets us drop the bounds check from the inner loop.
+template<typename T, typename F>
+void unguardedInsertionSort(T* begin, T* end, F less){
+	if(begin == end) return;
+	for(T* current = begin + 1; current != end; current++){
+		if(!less(*current, current[-1])) continue;
+		T value = static_cast<T&&>(*current);
+		T* hole = current;
+		do{
+			*hole = static_cast<T&&>(hole[-1]);
+			hole--;
+		}while(less(value, hole[-1]));
+		*hole = static_cast<T&&>(value);
+	}
+}
+
+// Gives up and returns false once it has moved more than a handful of elements,
+// so an almost sorted range finishes in linear time and anything else costs little.
+template<typename T, typename F>
+bool partialInsertionSort(T* begin, T* end, F less){
+	if(begin == end) return true;
+	size_t moved = 0;
+	for(T* current = begin + 1; current != end; current++){
+		if(moved > 8) return false;
+		if(!less(*current, current[-1])) continue;
+		T value = static_cast<T&&>(*current);
+		T* hole = current;
+		do{
+			*hole = static_cast<T&&>(hole[-1]);
+			hole--;
+		}while(hole != begin && less(value, hole[-1]));
+		*hole = static_cast<T&&>(value);
+		moved += current - hole;
+	}
+	return true;
+}
+
+template<typename T, typename F>
+void siftDown(T* data, size_t size, size_t root, F less){
+	T value = static_cast<T&&>(data[root]);
+	while(true){
+		size_t child = root * 2 + 1;
+		if(child >= size) break;
+		if(child + 1 < size && less(data[child], data[child + 1])) child++;
+		if(!less(value, data[child])) break;
+		data[root] = static_cast<T&&>(data[child]);
+		root = child;
+	}
+	data[root] = static_cast<T&&>(value);
+}
+
+template<typename T, typename F>
+void heapSort(T* begin, T* end, F less){
+	size_t size = end - begin;
+	for(size_t i = size / 2; i > 0; i--) siftDown(begin, size, i - 1, less);
+	for(size_t i = size; i > 1; i--){
+		swapValues(begin[0], begin[i - 1]);
+		siftDown(begin, i - 1, 0, less);
+	}
+}
+
+template<typename T, typename F>
+ALWAYS_INLINE void sort2(T* a, T* b, F less){
+	if(less(*b, *a)) swapValues(*a, *b);
+}
+
+template<typename T, typename F>
+ALWAYS_INLINE void sort3(T* a, T* b, T* c, F less){
+	sort2(a, b, less);
+	sort2(b, c, less);
+	sort2(a, b, less);
+}
+
+// Partitions [begin, end) around *begin. Elements equal to the pivot go right.
+// Returns the final position of the pivot and whether the range was already partitioned.
+template<typename T, typename F>
+T* partitionRight(T* begin, T* end, F less, bool& alreadyPartitioned){
+	T pivot = static_cast<T&&>(*begin);
+	T* first = begin;
+	T* last = end;
+	// The median of three guarantees an element not less than the pivot on the right,
+	// and the pivot itself stops the search from the left.
+	while(less(*++first, pivot));
+	if(first - 1 == begin) while(first < last && !less(*--last, pivot));
+	else while(!less(*--last, pivot));
+	alreadyPartitioned = first >= last;
+	while(first < last){
+		swapValues(*first, *last);
+		while(less(*++first, pivot));
+		while(!less(*--last, pivot));
+	}
+	T* pivotPosition = first - 1;
+	*begin = static_cast<T&&>(*pivotPosition);
+	*pivotPosition = static_cast<T&&>(pivot);
+	return pivotPosition;
+}
+
+// Block partitioning (Edelkamp & Weiß). Comparison results are written into offset
+// buffers instead of being branched on, which removes the mispredictions that dominate
+// partitioning random keys. Only used for trivially copyable types since it swaps a lot.
+template<typename T, typename F>
+T* partitionRightBranchless(T* begin, T* end, F less, bool& alreadyPartitioned){
+	constexpr size_t PARTITION_BLOCK_SIZE = 64;
+	T pivot = *begin;
+	T* first = begin;
+	T* last = end;
+	while(less(*++first, pivot));
+	if(first - 1 == begin) while(first < last && !less(*--last, pivot));
+	else while(!less(*--last, pivot));
+	alreadyPartitioned = first >= last;
+	if(!alreadyPartitioned){
+		swapValues(*first, *last);
+		first++;
+		
+		// offsetsLeft holds positions after leftBase of elements that belong on the right,
+		// offsetsRight positions before rightBase of elements that belong on the left.
+		alignas(64) uint8_t offsetsLeft[PARTITION_BLOCK_SIZE];
+		alignas(64) uint8_t offsetsRight[PARTITION_BLOCK_SIZE];
+		T* leftBase = first;
+		T* rightBase = last;
+		size_t countLeft = 0, countRight = 0, startLeft = 0, startRight = 0;
+		while(first < last){
+			// Refill whichever buffer ran out. Near the end the unknown elements are split between them.
+			size_t unknown = last - first;
+			size_t leftSplit = countLeft == 0 ? (countRight == 0 ? unknown / 2 : unknown) : 0;
+			size_t rightSplit = countRight == 0 ? unknown - leftSplit : 0;
+			leftSplit = min(leftSplit, PARTITION_BLOCK_SIZE);
+			rightSplit = min(rightSplit, PARTITION_BLOCK_SIZE);
+			for(size_t i = 0; i < leftSplit; i++){
+				offsetsLeft[countLeft] = (uint8_t)i;
+				countLeft += !less(*first, pivot);
+				first++;
+			}
+			for(size_t i = 0; i < rightSplit; i++){
+				offsetsRight[countRight] = (uint8_t)(i + 1);
+				countRight += less(*--last, pivot);
+			}
+			
+			size_t count = min(countLeft, countRight);
+			for(size_t i = 0; i < count; i++){
+				swapValues(leftBase[offsetsLeft[startLeft + i]], *(rightBase - offsetsRight[startRight + i]));
+			}
+			countLeft -= count;
+			countRight -= count;
+			startLeft += count;
+			startRight += count;
+			if(countLeft == 0){
+				startLeft = 0;
+				leftBase = first;
+			}
+			if(countRight == 0){
+				startRight = 0;
+				rightBase = last;
+			}
+		}
+		
+		// At most one buffer still has misplaced elements, swap them to the boundary.
+		if(countLeft){
+			while(countLeft--) swapValues(leftBase[offsetsLeft[startLeft + countLeft]], *--last);
+			first = last;
+		}
+		if(countRight){
+			while(countRight--) swapValues(*(rightBase - offsetsRight[startRight + countRight]), *first++);
+			last = first;
+		}
+	}
+	T* pivotPosition = first - 1;
+	*begin = *pivotPosition;
+	*pivotPosition = pivot;
+	return pivotPosition;
+}
+
+// Partitions [begin, end) around *begin with equal elements going left. Used when the pivot
+// equals the element before the range, in which case everything equal to it is already in place.
+template<typename T, typename F>
+T* partitionLeft(T* begin, T* end, F less){
+	T pivot = static_cast<T&&>(*begin);
+	T* first = begin;
+	T* last = end;
+	while(less(pivot, *--last));
+	if(last + 1 == end) while(first < last && !less(pivot, *++first));
+	else while(!less(pivot, *++first));
+	while(first < last){
+		swapValues(*first, *last);
+		while(less(pivot, *--last));
+		while(!less(pivot, *++first));
+	}
+	T* pivotPosition = last;
+	*begin = static_cast<T&&>(*pivotPosition);
+	*pivotPosition = static_cast<T&&>(pivot);
+	return pivotPosition;
+}
+
+// Pattern-defeating quicksort (Peters). leftmost is false when there is an element before begin
+// that is not greater than anything in the range.
+template<typename T, typename F, bool branchless>
+void pdqSortLoop(T* begin, T* end, F less, int badAllowed, bool leftmost = true){
+	constexpr ptrdiff_t INSERTION_SORT_THRESHOLD = 24;
+	constexpr ptrdiff_t NINTHER_THRESHOLD = 128;
+	while(true){
+		ptrdiff_t size = end - begin;
+		if(size < INSERTION_SORT_THRESHOLD){
+			if(leftmost) insertionSort(begin, end, less);
+			else unguardedInsertionSort(begin, end, less);
+			return;
+		}
+		
+		// Move the median of three (or pseudomedian of nine) to begin.
+		ptrdiff_t half = size / 2;
+		if(size > NINTHER_THRESHOLD){
+			sort3(begin, begin + half, end - 1, less);
+			sort3(begin + 1, begin + (half - 1), end - 2, less);
+			sort3(begin + 2, begin + (half + 1), end - 3, less);
+			sort3(begin + (half - 1), begin + half, begin + (half + 1), less);
+			swapValues(*begin, begin[half]);
+		}else{
+			sort3(begin + half, begin, end - 1, less);
+		}
+		
+		// Everything equal to the element before us is already in its final place.
+		if(!leftmost && !less(begin[-1], *begin)){
+			begin = partitionLeft(begin, end, less) + 1;
+			continue;
+		}
+		
+		bool alreadyPartitioned;
+		T* pivot;
+		if constexpr(branchless) pivot = partitionRightBranchless(begin, end, less, alreadyPartitioned);
+		else pivot = partitionRight(begin, end, less, alreadyPartitioned);
+		
+		ptrdiff_t leftSize = pivot - begin;
+		ptrdiff_t rightSize = end - (pivot + 1);
+		if(leftSize < size / 8 || rightSize < size / 8){
+			// Too many bad pivots means adversarial input, fall back to guaranteed n log n.
+			if(--badAllowed == 0){
+				heapSort(begin, end, less);
+				return;
+			}
+			// Break up whatever pattern gave us the bad pivot.
+			if(leftSize >= INSERTION_SORT_THRESHOLD){
+				swapValues(begin[0], begin[leftSize / 4]);
+				swapValues(pivot[-1], pivot[-leftSize / 4]);
+				if(leftSize > NINTHER_THRESHOLD){
+					swapValues(begin[1], begin[leftSize / 4 + 1]);
+					swapValues(begin[2], begin[leftSize / 4 + 2]);
+					swapValues(pivot[-2], pivot[-(leftSize / 4 + 1)]);
+					swapValues(pivot[-3], pivot[-(leftSize / 4 + 2)]);
+				}
+			}
+			if(rightSize >= INSERTION_SORT_THRESHOLD){
+				swapValues(pivot[1], pivot[1 + rightSize / 4]);
+				swapValues(end[-1], end[-rightSize / 4]);
+				if(rightSize > NINTHER_THRESHOLD){
+					swapValues(pivot[2], pivot[2 + rightSize / 4]);
+					swapValues(pivot[3], pivot[3 + rightSize / 4]);
+					swapValues(end[-2], end[-(1 + rightSize / 4)]);
+					swapValues(end[-3], end[-(2 + rightSize / 4)]);
+				}
+			}
+		}else if(alreadyPartitioned && partialInsertionSort(begin, pivot, less) && partialInsertionSort(pivot + 1, end, less)){
+			// A balanced partition that needed no swaps hints that the range was sorted.
+			return;
+		}
+		
+		// Recurse into the left side and loop on the right, the pivot is in its final place.
+		pdqSortLoop<T, F, branchless>(begin, pivot, less, badAllowed, leftmost);
+		begin = pivot + 1;
+		leftmost = false;
+	}
+}
+
+// Unstable in-place sort, O(n log n) worst case and linear on sorted, reversed and all equal input.
+template<typename T, typename F = Less>
+void sort(ArrayView<T> values, F less = F()){
+	if(values.size < 2) return;
+	int badAllowed = 64 - countLeadingZeros(uint64_t(values.size));
+	pdqSortLoop<T, F, isTriviallyCopyable<T>>(values.data, values.data + values.size, less, badAllowed);
+}
+
+template<typename T, typename F = Less>
+bool isSorted(ArrayView<T> values, F less = F()){
+	for(size_t i = 1; i < values.size; i++) if(less(values.data[i], values.data[i - 1])) return false;
+	return true;
+}
+
+// --------------------------------------------------------------------------------------------------------
+// --------------------------------------------- Radix Sorting --------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+template<size_t size> struct UnsignedOfSize;
+template<> struct UnsignedOfSize<1>{using Type = uint8_t;};
+template<> struct UnsignedOfSize<2>{using Type = uint16_t;};
+template<> struct UnsignedOfSize<4>{using Type = uint32_t;};
+template<> struct UnsignedOfSize<8>{using Type = uint64_t;};
+
+// Maps a key to an unsigned integer that sorts the same way. Signed integers get their sign bit flipped,
+// floats additionally get every other bit flipped when negative. NaNs sort after infinity (or before
+// negative infinity if their sign bit is set).
+template<typename T>
+ALWAYS_INLINE auto toRadixKey(T value){
+	using U = typename UnsignedOfSize<sizeof(T)>::Type;
+	constexpr U SIGN_BIT = U(1) << (sizeof(T) * 8 - 1);
+	U bits;
+	memcpy(&bits, &value, sizeof(T));
+	if constexpr(isTypeEqual<T, float> || isTypeEqual<T, double>) return (U)(bits ^ ((bits & SIGN_BIT) ? U(~U(0)) : SIGN_BIT));
+	else if constexpr(T(-1) < T(0)) return (U)(bits ^ SIGN_BIT);
+	else return bits;
+}
+
+// LSD radix sort on the bytes of key(value), stable. Needs a scratch array the size of the input.
+// Passes over bytes that are the same for every key are skipped, so small keys in wide types are cheap.
+template<typename T, typename K>
+void radixSort(ArrayView<T> values, ArrayView<T> scratch, K key){
+	static_assert(isTriviallyCopyable<T>, "radixSort moves elements with memcpy.");
+	ZSL_ASSERT(scratch.size >= values.size);
+	using Key = decltype(toRadixKey(key(values.data[0])));
+	constexpr size_t PASSES = sizeof(Key);
+	if(values.size < 2) return;
+	
+	// One read over the input builds the histogram of every pass.
+	size_t counts[PASSES][256] = {};
+	for(size_t i = 0; i < values.size; i++){
+		Key radix = toRadixKey(key(values.data[i]));
+		for(size_t pass = 0; pass < PASSES; pass++) counts[pass][(radix >> (pass * 8)) & 0xFF]++;
+	}
+	
+	T* from = values.data;
+	T* to = scratch.data;
+	for(size_t pass = 0; pass < PASSES; pass++){
+		size_t* count = counts[pass];
+		Key firstDigit = (toRadixKey(key(from[0])) >> (pass * 8)) & 0xFF;
+		if(count[firstDigit] == values.size) continue;
+		size_t offset = 0;
+		for(size_t digit = 0; digit < 256; digit++){
+			size_t digitCount = count[digit];
+			count[digit] = offset;
+			offset += digitCount;
+		}
+		for(size_t i = 0; i < values.size; i++){
+			Key digit = (toRadixKey(key(from[i])) >> (pass * 8)) & 0xFF;
+			to[count[digit]++] = from[i];
+		}
+		T* temp = from;
+		from = to;
+		to = temp;
+	}
+	if(from != values.data) memcpy((void*)values.data, (void*)from, values.size * sizeof(T));
+}
+
+template<typename T>
+void radixSort(ArrayView<T> values, ArrayView<T> scratch){
+	radixSort(values, scratch, [](const T& value){return value;});
+}
+
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR, typename T, typename K>
+void radixSort(ArrayView<T> values, K key){
+	if(values.size < 2) return;
+	T* scratch = alloc<allocator, T>(values.size);
+	radixSort(values, {values.size, scratch}, key);
+	dealloc<allocator>(scratch);
+}
+
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR, typename T>
+void radixSort(ArrayView<T> values){
+	radixSort<allocator>(values, [](const T& value){return value;});
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------- Parallel Sorting -------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+template<typename T, typename F>
+void mergeSorted(const T* left, size_t leftSize, const T* right, size_t rightSize, T* to, F less){
+	const T* leftEnd = left + leftSize;
+	const T* rightEnd = right + rightSize;
+	while(left != leftEnd && right != rightEnd){
+		bool takeRight = less(*right, *left);
+		*to++ = takeRight ? *right : *left;
+		right += takeRight;
+		left += !takeRight;
+	}
+	memcpy((void*)to, (const void*)left, (leftEnd - left) * sizeof(T));
+	to += leftEnd - left;
+	memcpy((void*)to, (const void*)right, (rightEnd - right) * sizeof(T));
+}
+
+template<typename T, typename F>
+struct ParallelSortTask{
+	// Sorts [begin, end) of from when merge is false, otherwise merges [begin, middle) and [middle, end) into to.
+	T* from;
+	T* to;
+	size_t begin;
+	size_t middle;
+	size_t end;
+	bool merge;
+	F* less;
+	
+	void run(){
+		if(merge) mergeSorted(from + begin, middle - begin, from + middle, end - middle, to + begin, *less);
+		else sort(ArrayView<T>{end - begin, from + begin}, *less);
+	}
+};
+
+// Sorts equal chunks on the worker pool, then merges them pairwise, also in parallel, through a scratch buffer.
+// Falls back to sort() for small inputs where waking the workers costs more than it saves.
+template<Allocator allocator = ZSL_DEFAULT_ALLOCATOR, typename T, typename F = Less>
+void parallelSort(ArrayView<T> values, F less = F(), size_t threads = 0){
+	static_assert(isTriviallyCopyable<T>, "parallelSort merges with memcpy.");
+	constexpr size_t MIN_CHUNK_SIZE = 1 << 14;
+	if(threads == 0) threads = getParallelThreadCount();
+	size_t chunks = 1;
+	while(chunks * 2 <= threads && values.size / (chunks * 2) >= MIN_CHUNK_SIZE) chunks *= 2;
+	if(chunks == 1){
+		sort(values, less);
+		return;
+	}
+	
+	ParallelSortTask<T, F>* tasks = alloc<allocator, ParallelSortTask<T, F>>(chunks);
+	T* scratch = alloc<allocator, T>(values.size);
+	
+	T* from = values.data;
+	T* to = scratch;
+	for(size_t i = 0; i < chunks; i++){
+		tasks[i] = {from, to, values.size * i / chunks, 0, values.size * (i + 1) / chunks, false, &less};
+	}
+	for(size_t width = 1; width <= chunks; width *= 2){
+		// The first round sorts, every round after merges pairs of the previous round's runs.
+		size_t taskCount = chunks / width;
+		if(width > 1){
+			for(size_t i = 0; i < taskCount; i++){
+				tasks[i] = {from, to, values.size * (i * width) / chunks, values.size * (i * width + width / 2) / chunks,
+					values.size * (i + 1) * width / chunks, true, &less};
+			}
+		}
+		parallelFor(taskCount, [&](size_t i){tasks[i].run();});
+		if(width > 1){
+			T* temp = from;
+			from = to;
+			to = temp;
+		}
+	}
+	if(from != values.data) memcpy((void*)values.data, (void*)from, values.size * sizeof(T));
+	
+	dealloc<allocator>(scratch);
+	dealloc<allocator>(tasks);
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------- Searching ----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// Index of the first element not less than value, or size if there is none. The loop has a fixed
+// trip count and no branch on the compare, so it never mispredicts. Since nothing is speculated
+// we prefetch both candidates for the next step instead.
+template<typename T, typename V, typename F = Less>
+size_t lowerBound(ArrayView<T> values, const V& value, F less = F()){
+	if(values.size == 0) return 0;
+	const T* base = values.data;
+	size_t size = values.size;
+	while(size > 1){
+		size_t half = size / 2;
+		__builtin_prefetch(base + half / 2);
+		__builtin_prefetch(base + half + half / 2);
+		base += less(base[half - 1], value) * half;
+		size -= half;
+	}
+	return (base - values.data) + less(*base, value);
+}
+
+// Index of the first element greater than value, or size if there is none.
+template<typename T, typename V, typename F = Less>
+size_t upperBound(ArrayView<T> values, const V& value, F less = F()){
+	if(values.size == 0) return 0;
+	const T* base = values.data;
+	size_t size = values.size;
+	while(size > 1){
+		size_t half = size / 2;
+		__builtin_prefetch(base + half / 2);
+		__builtin_prefetch(base + half + half / 2);
+		base += !less(value, base[half - 1]) * half;
+		size -= half;
+	}
+	return (base - values.data) + !less(value, *base);
+}
+
+template<typename T, typename V, typename F = Less>
+bool binarySearch(ArrayView<T> values, const V& value, F less = F()){
+	size_t i = lowerBound(values, value, less);
+	return i < values.size && !less(value, values.data[i]);
+}
+
+// A sorted array stored in breadth first (Eytzinger) order. The first levels of the tree share
+// cache lines and the next ones can be prefetched, so searches on arrays much larger than the
+// cache are several times faster than lowerBound. Read only, rebuild it to change the contents.
+template<typename T, Allocator allocator = ZSL_DEFAULT_ALLOCATOR>
+struct EytzingerArray{
+	using Self = EytzingerArray<T, allocator>;
+	
+	size_t size;
+	// One based, data[0] is unused.
+	T* data;
+	
+	static Self init(ArrayView<T> sorted){
+		Self self;
+		self.size = sorted.size;
+		self.data = alloc<allocator, T>(sorted.size + 1);
+		size_t next = 0;
+		self.fill(sorted, next, 1);
+		return self;
+	}
+	
+	void deinit(){
+		dealloc<allocator>(data);
+	}
+	
+	void fill(ArrayView<T> sorted, size_t& next, size_t k){
+		if(k > size) return;
+		fill(sorted, next, k * 2);
+		data[k] = sorted.data[next++];
+		fill(sorted, next, k * 2 + 1);
+	}
+	
+	// First element not less than value or nullptr if there is none.
+	template<typename V, typename F = Less>
+	T* lowerBound(const V& value, F less = F()){
+		constexpr size_t PER_LINE = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+		size_t k = 1;
+		while(k <= size){
+			// The descendants log2(PER_LINE) levels down are contiguous, fetch them while we compare.
+			__builtin_prefetch(data + k * PER_LINE);
+			k = k * 2 + less(data[k], value);
+		}
+		// Undo the right turns we took after the last left turn.
+		k >>= countTrailingZeros(uint64_t(~k)) + 1;
+		return k ? data + k : nullptr;
+	}
+	
+	template<typename V, typename F = Less>
+	bool contains(const V& value, F less = F()){
+		T* found = lowerBound(value, less);
+		return found && !less(value, *found);
+	}
+};
+
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include "core.h"
+#include "hash_map.h"
+#include "string_utils.h"
+
+namespace zsl{
+
+// Perfect hash maps over a key set known at compile time, for keyword, opcode and header name tables.
+// makeStaticMap runs CHD (compress, hash and displace) in the compiler: keys are hashed into buckets
+// of about four, and starting with the largest bucket each one gets the first pilot value that sends
+// all of its keys to free slots. A lookup hashes the key, reads its bucket's pilot and compares against
+// the one record that key can be in, there is no probing and nothing to build at startup.
+// Keys can be integers, enums or StringView (written as string literals in the entries). Declare the
+// map constexpr so it's built at compile time. Large key sets need a raised constexpr step limit on clang.
+
+template<typename K> using StaticKey = selectType<isTypeEqual<K, StringView>, const char*, K>;
+
+template<typename K, typename V>
+struct StaticMapEntry{
+	StaticKey<K> key;
+	V value;
+};
+
+// Little endian loads written with shifts so they run at compile time, the compiler turns each back
+// into a single load.
+ALWAYS_INLINE constexpr uint64_t staticLoad32(const char* data){
+	return uint64_t(uint8_t(data[0])) | uint64_t(uint8_t(data[1])) << 8 | uint64_t(uint8_t(data[2])) << 16 | uint64_t(uint8_t(data[3])) << 24;
+}
+
+ALWAYS_INLINE constexpr uint64_t staticLoad64(const char* data){
+	return staticLoad32(data) | staticLoad32(data + 4) << 32;
+}
+
+// Strings up to 16 bytes, which is most keywords, take two overlapping loads and one mix.
+template<typename K>
+ALWAYS_INLINE constexpr uint64_t staticHash(const K& key, uint64_t seed){
+	if constexpr(isTypeEqual<K, StringView>){
+		const char* data = key.data;
+		size_t size = key.size;
+		uint64_t hash = seed ^ (size * UINT64_C(0x9e3779b97f4a7c15));
+		if(size > 16){
+			for(; size > 16; data += 16, size -= 16) hash = mixHash(hash ^ staticLoad64(data) ^ (staticLoad64(data + 8) << 1 | staticLoad64(data + 8) >> 63));
+			data -= 16 - size;
+			size = 16;
+		}
+		uint64_t low = 0, high = 0;
+		if(size >= 8){
+			low = staticLoad64(data);
+			high = staticLoad64(data + size - 8);
+		}else if(size >= 4){
+			low = staticLoad32(data);
+			high = staticLoad32(data + size - 4);
+		}else if(size > 0){
+			low = uint64_t(uint8_t(data[0])) << 16 | uint64_t(uint8_t(data[size / 2])) << 8 | uint8_t(data[size - 1]);
+		}
+		return mixHash(hash ^ low ^ (high << 1 | high >> 63));
+	}else return mixHash((uint64_t)key ^ seed);
+}
+
+template<typename K>
+constexpr K toStaticKey(const StaticKey<K>& key){
+	if constexpr(isTypeEqual<K, StringView>){
+		size_t size = 0;
+		while(key[size]) size++;
+		return {size, key};
+	}else return key;
+}
+
+template<typename K>
+constexpr bool isStaticKeyEqual(const K& a, const K& b){
+	if constexpr(isTypeEqual<K, StringView>){
+		if(a.size != b.size) return false;
+		for(size_t i = 0; i < a.size; i++) if(a.data[i] != b.data[i]) return false;
+		return true;
+	}else return a == b;
+}
+
+// Not constexpr, so reaching one while building a map at compile time is a compile error naming the problem.
+inline void staticMapDuplicateKey(){ZSL_ASSERT(false);}
+inline void staticMapNoPerfectHash(){ZSL_ASSERT(false);}
+
+template<typename K, typename V, size_t N>
+struct StaticMap{
+	static_assert(N > 0);
+	using KeyType = K;
+	using ValueType = V;
+	static constexpr size_t SIZE = N;
+	static constexpr size_t BUCKET_COUNT = (N + 3) / 4;
+	// Load factor of 0.8, the last buckets to be placed need about five pilots each.
+	static constexpr size_t CAPACITY = N + N / 4;
+	static constexpr uint32_t MAX_PILOT = UINT16_MAX;
+	static constexpr uint32_t MAX_SEEDS = 64;
+	// A bucket this large is so unlikely that it's cheaper to try another seed than to handle it.
+	static constexpr size_t MAX_BUCKET_SIZE = 32;
+	
+	struct Record{
+		K key;
+		V value;
+	};
+	
+	uint64_t seed;
+	// Where the first entry landed. Free slots hold a copy of it, its key always lands in its own slot so they never match.
+	size_t firstSlot;
+	uint16_t pilots[BUCKET_COUNT];
+	Record records[CAPACITY];
+	
+	ALWAYS_INLINE static constexpr size_t getBucket(uint64_t hash){return reduceRange(uint32_t(hash >> 32), BUCKET_COUNT);}
+	// Multiply shift hashing with a multiplier picked by the pilot, the hash is already mixed so one multiply is enough.
+	ALWAYS_INLINE static constexpr size_t getSlot(uint64_t hash, uint32_t pilot){
+		uint64_t multiplier = uint64_t(pilot) * UINT64_C(0x3c6ef372fe94f82a) + UINT64_C(0x9e3779b97f4a7c15);
+		return reduceRange(uint32_t((hash * multiplier) >> 32), CAPACITY);
+	}
+	
+	ALWAYS_INLINE const Record* getRecord(const K& key) const{
+		uint64_t hash = staticHash(key, seed);
+		const Record& record = records[getSlot(hash, pilots[getBucket(hash)])];
+		return defaultCompare(record.key, key) ? &record : nullptr;
+	}
+	
+	ALWAYS_INLINE bool has(const K& key) const{return getRecord(key);}
+	
+	ALWAYS_INLINE const V& get(const K& key) const{
+		const Record* record = getRecord(key);
+		ZSL_ASSERT(record);
+		return record->value;
+	}
+	
+	// Returns the value for key, or fallback if it isn't in the map.
+	ALWAYS_INLINE V get(const K& key, const V& fallback) const{
+		const Record* record = getRecord(key);
+		return record ? record->value : fallback;
+	}
+	
+	// Visits the N entries in slot order, skipping the copies in free slots.
+	struct Iterator{
+		const StaticMap& map;
+		size_t i;
+		ALWAYS_INLINE Iterator(const StaticMap& m, size_t initial): map(m), i(initial){next();}
+		ALWAYS_INLINE bool isFree(){return i != map.firstSlot && defaultCompare(map.records[i].key, map.records[map.firstSlot].key);}
+		ALWAYS_INLINE void next(){while(i < CAPACITY && isFree()) i++;}
+		ALWAYS_INLINE void operator++(){i++; next();}
+		ALWAYS_INLINE bool operator==(const Iterator& other){return i == other.i;}
+		ALWAYS_INLINE bool operator!=(const Iterator& other){return i != other.i;}
+		ALWAYS_INLINE const Record& operator*(){return map.records[i];}
+	};
+	
+	ALWAYS_INLINE Iterator begin() const{return {*this, 0};}
+	ALWAYS_INLINE Iterator end() const{return {*this, CAPACITY};}
+};
+
+template<typename K, typename V, size_t N>
+constexpr StaticMap<K, V, N> makeStaticMap(const StaticMapEntry<K, V> (&entries)[N]){
+	using Map = StaticMap<K, V, N>;
+	Map map = {};
+	K keys[N] = {};
+	uint64_t hashes[N] = {};
+	for(size_t i = 0; i < N; i++) keys[i] = toStaticKey<K>(entries[i].key);
+	
+	for(uint32_t attempt = 0; attempt < Map::MAX_SEEDS; attempt++){
+		map.seed = mixHash(attempt + 1);
+		for(size_t i = 0; i < N; i++) hashes[i] = staticHash(keys[i], map.seed);
+		
+		// Counting sort of the keys by bucket, then of the buckets by size, largest first.
+		size_t bucketStarts[Map::BUCKET_COUNT + 1] = {};
+		size_t keyOrder[N] = {};
+		for(size_t i = 0; i < N; i++) bucketStarts[Map::getBucket(hashes[i]) + 1]++;
+		size_t sizeCounts[N + 2] = {};
+		for(size_t bucket = 0; bucket < Map::BUCKET_COUNT; bucket++) sizeCounts[N - bucketStarts[bucket + 1] + 1]++;
+		for(size_t bucket = 0; bucket < Map::BUCKET_COUNT; bucket++) bucketStarts[bucket + 1] += bucketStarts[bucket];
+		size_t bucketEnds[Map::BUCKET_COUNT] = {};
+		for(size_t bucket = 0; bucket < Map::BUCKET_COUNT; bucket++) bucketEnds[bucket] = bucketStarts[bucket];
+		for(size_t i = 0; i < N; i++) keyOrder[bucketEnds[Map::getBucket(hashes[i])]++] = i;
+		for(size_t size = 0; size <= N; size++) sizeCounts[size + 1] += sizeCounts[size];
+		size_t bucketOrder[Map::BUCKET_COUNT] = {};
+		for(size_t bucket = 0; bucket < Map::BUCKET_COUNT; bucket++){
+			bucketOrder[sizeCounts[N - (bucketEnds[bucket] - bucketStarts[bucket])]++] = bucket;
+		}
+		
+		bool taken[Map::CAPACITY] = {};
+		bool placed = true;
+		for(size_t b = 0; b < Map::BUCKET_COUNT && placed; b++){
+			size_t bucket = bucketOrder[b];
+			size_t first = bucketStarts[bucket], last = bucketEnds[bucket];
+			if(first == last) break;
+			// Two keys with the same hash can't be split by any pilot, either they're equal or we need a new seed.
+			bool collided = last - first > Map::MAX_BUCKET_SIZE;
+			for(size_t i = first; i < last; i++){
+				for(size_t j = first; j < i; j++){
+					if(hashes[keyOrder[i]] != hashes[keyOrder[j]]) continue;
+					if(isStaticKeyEqual(keys[keyOrder[i]], keys[keyOrder[j]])) staticMapDuplicateKey();
+					collided = true;
+				}
+			}
+			placed = false;
+			for(uint32_t pilot = 0; pilot <= Map::MAX_PILOT && !collided && !placed; pilot++){
+				size_t slots[Map::MAX_BUCKET_SIZE] = {};
+				placed = true;
+				for(size_t i = first; i < last && placed; i++){
+					slots[i - first] = Map::getSlot(hashes[keyOrder[i]], pilot);
+					if(taken[slots[i - first]]) placed = false;
+					for(size_t j = first; j < i && placed; j++) if(slots[j - first] == slots[i - first]) placed = false;
+				}
+				if(!placed) continue;
+				map.pilots[bucket] = (uint16_t)pilot;
+				for(size_t i = first; i < last; i++){
+					taken[slots[i - first]] = true;
+					if(keyOrder[i] == 0) map.firstSlot = slots[i - first];
+					map.records[slots[i - first]] = {keys[keyOrder[i]], entries[keyOrder[i]].value};
+				}
+			}
+		}
+		if(!placed) continue;
+		
+		for(size_t slot = 0; slot < Map::CAPACITY; slot++) if(!taken[slot]) map.records[slot] = {keys[0], entries[0].value};
+		return map;
+	}
+	staticMapNoPerfectHash();
+	return map;
+}
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "core.h"
+
+namespace zsl{
+
+// Vectorized byte kernels. Picked on first use from what the CPU supports (AVX2, otherwise SSE2), see cpu.h.
+// The find functions return nullptr when there is no match.
+size_t stringLength(const char*);
+bool isMemoryEqual(const void*, const void*, size_t);
+const char* findByte(const char* data, size_t size, char value);
+// First byte that is any of the bytes in set.
+const char* findAnyByte(const char* data, size_t size, const char* set, size_t setSize);
+const char* findBytes(const char* data, size_t size, const char* needle, size_t needleSize);
+// A wyhash variant. Not cryptographic, but fast on short keys and good enough for power of two tables.
+uint64_t hashBytes(const void*, size_t, uint64_t seed = 0);
+
+// A string that knows its length, doesn't own its data and isn't null terminated.
+// Has hash() and compare() so it can be used as a HashMap key directly.
+struct StringView{
+	static constexpr size_t NOT_FOUND = SIZE_MAX;
+	
+	size_t size;
+	const char* data;
+	
+	static StringView init(const char* string){return {stringLength(string), string};}
+	static StringView init(const char* string, size_t size){return {size, string};}
+	static StringView init(ArrayView<char> view){return {view.size, view.data};}
+	
+	ALWAYS_INLINE operator ArrayView<const char>() const{return {size, data};}
+	ALWAYS_INLINE char operator[](size_t i) const{ZSL_ASSERT(i < size); return data[i];}
+	ALWAYS_INLINE const char* begin() const{return data;}
+	ALWAYS_INLINE const char* end() const{return data + size;}
+	ALWAYS_INLINE StringView slice(size_t first, size_t last) const{ZSL_ASSERT(first <= last && last <= size); return {last - first, data + first};}
+	ALWAYS_INLINE StringView slice(size_t first = 0) const{ZSL_ASSERT(first <= size); return {size - first, data + first};}
+	
+	size_t hash() const{return (size_t)hashBytes(data, size);}
+	bool compare(const StringView& other) const{return size == other.size && isMemoryEqual(data, other.data, size);}
+	
+	bool startsWith(StringView prefix) const{return prefix.size <= size && isMemoryEqual(data, prefix.data, prefix.size);}
+	bool endsWith(StringView suffix) const{return suffix.size <= size && isMemoryEqual(data + size - suffix.size, suffix.data, suffix.size);}
+	
+	size_t find(char value, size_t from = 0) const{
+		ZSL_ASSERT(from <= size);
+		const char* found = findByte(data + from, size - from, value);
+		return found ? found - data : NOT_FOUND;
+	}
+	
+	size_t find(StringView needle, size_t from = 0) const{
+		ZSL_ASSERT(from <= size);
+		const char* found = findBytes(data + from, size - from, needle.data, needle.size);
+		return found ? found - data : NOT_FOUND;
+	}
+	
+	size_t findAny(StringView set, size_t from = 0) const{
+		ZSL_ASSERT(from <= size);
+		const char* found = findAnyByte(data + from, size - from, set.data, set.size);
+		return found ? found - data : NOT_FOUND;
+	}
+	
+	// Sets token to everything up to the first delimiter and drops it and the delimiter from this view.
+	// Returns false once the last token has been taken, so "a,,b" gives "a", "" and "b".
+	// while(rest.split(StringView::init(",;"), token)){...}
+	bool split(StringView delimiters, StringView& token){
+		if(!data) return false;
+		size_t end = findAny(delimiters);
+		if(end == NOT_FOUND){
+			token = *this;
+			*this = {0, nullptr};
+		}else{
+			token = slice(0, end);
+			*this = slice(end + 1);
+		}
+		return true;
+	}
+};
+
+}
@@ -0,0 +1,157 @@
+#include "string.h"
+#include "zsl/core.h"
+#include "zsl/atomics.h"
+#include "zsl/array_list.h"
+#include "zsl/sort.h"
+#include "zsl/io.h"
+#include "zsl/allocation_trace.h"
+
+namespace zsl{
+
+// Sits right before every block handed out by traceAllocation.
+struct TracedBlockHeader{
+	uint64_t block;
+	// From the start of the underlying allocation to the block.
+	uint32_t offset;
+	// As the caller asked for it, the underlying allocation is aligned to at least the header.
+	uint32_t alignment;
+};
+static_assert(sizeof(TracedBlockHeader) == 16);
+
+struct AllocationTraceBuffer{
+	static constexpr size_t CAPACITY = 4096;
+	
+	AllocationTraceBuffer* next;
+	// The trace thread and count belong to, stale buffers start over.
+	uint32_t generation;
+	uint32_t thread;
+	size_t count;
+	AllocationEvent events[CAPACITY];
+};
+
+static AllocationTraceBuffer* traceBuffers = nullptr;
+static thread_local AllocationTraceBuffer* traceBuffer = nullptr;
+
+// Written by allocationTraceStart before it sets traceRunning.
+static File traceFile;
+static uint64_t traceStartTime;
+static uint32_t traceGeneration = 0;
+static bool traceRunning = false;
+// Where the next flushed buffer goes.
+static uint64_t traceFileOffset;
+static uint32_t traceThreadCount;
+static uint64_t nextTracedBlock = 0;
+
+static AllocationTraceBuffer* registerTraceBuffer(){
+	// Never freed, stop writes out the buffers of threads that have already exited.
+	AllocationTraceBuffer* buffer = (AllocationTraceBuffer*)allocateVirtualMemory(sizeof(AllocationTraceBuffer));
+	buffer->generation = 0;
+	buffer->count = 0;
+	buffer->next = atomicLoad(&traceBuffers, ORDER_RELAXED);
+	while(!atomicCompareExchangeWeak(&traceBuffers, &buffer->next, buffer, ORDER_RELEASE, ORDER_RELAXED));
+	traceBuffer = buffer;
+	return buffer;
+}
+
+static void flushTraceBuffer(AllocationTraceBuffer* buffer, size_t count){
+	size_t bytes = count * sizeof(AllocationEvent);
+	uint64_t offset = atomicAdd(&traceFileOffset, uint64_t(bytes), ORDER_RELAXED);
+	fileWrite(traceFile, buffer->events, bytes, offset);
+}
+
+static void recordAllocationEvent(AllocationOp op, uint64_t block, size_t size, size_t alignment){
+	if(!atomicLoad(&traceRunning, ORDER_ACQUIRE)) return;
+	AllocationTraceBuffer* buffer = traceBuffer ? traceBuffer : registerTraceBuffer();
+	size_t count = buffer->count;
+	if(buffer->generation != traceGeneration){
+		buffer->generation = traceGeneration;
+		buffer->thread = atomicAdd(&traceThreadCount, uint32_t(1), ORDER_RELAXED);
+		count = 0;
+	}else if(count == AllocationTraceBuffer::CAPACITY){
+		flushTraceBuffer(buffer, count);
+		count = 0;
+	}
+	uint8_t alignmentShift = (uint8_t)countTrailingZeros(uint64_t(alignment));
+	buffer->events[count] = {getTime() - traceStartTime, block, size, buffer->thread, op, alignmentShift, 0};
+	atomicStore(&buffer->count, count + 1, ORDER_RELEASE);
+}
+
+bool allocationTraceStart(const char* path){
+	if(atomicLoad(&traceRunning, ORDER_RELAXED)) return false;
+	File file = fileOpen(path, FILE_WRITE | FILE_CREATE | FILE_TRUNCATE);
+	if(!file.isValid()) return false;
+	AllocationTraceHeader header = {{'Z', 'S', 'L', 'T', 'R', 'A', 'C', 'E'}, AllocationTraceHeader::VERSION, sizeof(AllocationEvent)};
+	if(fileWrite(file, &header, sizeof(header), 0) != (int64_t)sizeof(header)){
+		fileClose(file);
+		return false;
+	}
+	traceFile = file;
+	traceFileOffset = sizeof(header);
+	traceThreadCount = 0;
+	traceGeneration++;
+	traceStartTime = getTime();
+	atomicStore(&traceRunning, true, ORDER_RELEASE);
+	return true;
+}
+
+void allocationTraceStop(){
+	if(!atomicExchange(&traceRunning, false, ORDER_ACQ_REL)) return;
+	for(AllocationTraceBuffer* buffer = atomicLoad(&traceBuffers, ORDER_ACQUIRE); buffer; buffer = buffer->next){
+		size_t count = atomicLoad(&buffer->count, ORDER_ACQUIRE);
+		if(buffer->generation == traceGeneration && count) flushTraceBuffer(buffer, count);
+	}
+	fileClose(traceFile);
+}
+
+bool loadAllocationTrace(const char* path, ArrayList<AllocationEvent>& events){
+	events.clear();
+	File file = fileOpen(path, FILE_READ);
+	if(!file.isValid()) return false;
+	AllocationTraceHeader header;
+	int64_t size = fileSize(file);
+	bool valid = size >= (int64_t)sizeof(header) && fileRead(file, &header, sizeof(header), 0) == (int64_t)sizeof(header) &&
+		memcmp(header.magic, "ZSLTRACE", 8) == 0 && header.version == AllocationTraceHeader::VERSION &&
+		header.eventSize == sizeof(AllocationEvent);
+	if(valid){
+		size_t count = (size - sizeof(header)) / sizeof(AllocationEvent);
+		events.resize(count);
+		valid = fileRead(file, events.data, count * sizeof(AllocationEvent), sizeof(header)) == int64_t(count * sizeof(AllocationEvent));
+	}
+	fileClose(file);
+	if(!valid){
+		events.clear();
+		return false;
+	}
+	// Ties are between threads, a block's allocation still has to come before its resizes and free.
+	sort(ArrayView<AllocationEvent>(events), [](const AllocationEvent& a, const AllocationEvent& b){
+		return a.time < b.time || (a.time == b.time && a.op < b.op);
+	});
+	return true;
+}
+
+void* traceAllocation(Allocator allocator, void* ptr, size_t size, size_t alignment){
+	if(!ptr){
+		if(size == 0) return nullptr;
+		size_t baseAlignment = max(alignment, alignof(TracedBlockHeader));
+		size_t offset = align(sizeof(TracedBlockHeader), baseAlignment);
+		char* base = (char*)allocator(nullptr, size + offset, baseAlignment);
+		if(!base) return nullptr;
+		TracedBlockHeader* header = (TracedBlockHeader*)(base + offset) - 1;
+		*header = {atomicAdd(&nextTracedBlock, uint64_t(1), ORDER_RELAXED), (uint32_t)offset, (uint32_t)alignment};
+		recordAllocationEvent(ALLOCATION_ALLOC, header->block, size, alignment);
+		return base + offset;
+	}
+	TracedBlockHeader header = ((TracedBlockHeader*)ptr)[-1];
+	char* base = (char*)ptr - header.offset;
+	if(size == 0){
+		recordAllocationEvent(ALLOCATION_FREE, header.block, 0, header.alignment);
+		allocator(base, 0, 0);
+		return nullptr;
+	}
+	base = (char*)allocator(base, size + header.offset, max(size_t(header.alignment), alignof(TracedBlockHeader)));
+	if(!base) return nullptr;
+	recordAllocationEvent(ALLOCATION_RESIZE, header.block, size, header.alignment);
+	return base + header.offset;
+}
+
+}
@@ -0,0 +1,127 @@
+#include "zsl/core.h"
+#include "zsl/cpu.h"
+#include "zsl/bitset.h"
+#if defined(__x86_64__) || defined(_M_X64)
+	#include "immintrin.h"
+#endif
+
+namespace zsl{
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Scalar ------------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+#define BINARY_KERNEL(name, operation) \
+	static void name(uint64_t* to, const uint64_t* from, size_t words){ \
+		for(size_t i = 0; i < words; i++) to[i] = operation; \
+	}
+BINARY_KERNEL(bitsAndScalar, to[i] & from[i])
+BINARY_KERNEL(bitsOrScalar, to[i] | from[i])
+BINARY_KERNEL(bitsXorScalar, to[i] ^ from[i])
+BINARY_KERNEL(bitsAndNotScalar, to[i] & ~from[i])
+#undef BINARY_KERNEL
+
+static uint64_t bitsPopCountScalar(const uint64_t* words, size_t count){
+	uint64_t total = 0;
+	for(size_t i = 0; i < count; i++) total += popCount(words[i]);
+	return total;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------- x86 --------------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// Same loop, but the builtin becomes a single popcnt. Four counters hide its three cycle latency.
+ZSL_TARGET("popcnt") static uint64_t bitsPopCountPopcnt(const uint64_t* words, size_t count){
+	uint64_t total0 = 0, total1 = 0, total2 = 0, total3 = 0;
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4){
+		total0 += __builtin_popcountll(words[i]);
+		total1 += __builtin_popcountll(words[i + 1]);
+		total2 += __builtin_popcountll(words[i + 2]);
+		total3 += __builtin_popcountll(words[i + 3]);
+	}
+	for(; i < count; i++) total0 += __builtin_popcountll(words[i]);
+	return total0 + total1 + total2 + total3;
+}
+
+// Looks up the count of each nibble with a shuffle (Muła) and sums the bytes with sad.
+ZSL_TARGET("avx2") static uint64_t bitsPopCountAvx2(const uint64_t* words, size_t count){
+	const __m256i lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+	__m256i total = _mm256_setzero_si256();
+	size_t i = 0;
+	while(i + 4 <= count){
+		// A byte counter gains at most 8 per step, so flush them to 64 bit lanes every 31 steps.
+		size_t end = min(i + 4 * 31, count & ~size_t(3));
+		__m256i bytes = _mm256_setzero_si256();
+		for(; i < end; i += 4){
+			__m256i block = _mm256_loadu_si256((const __m256i*)(words + i));
+			__m256i low = _mm256_and_si256(block, lowNibbles);
+			__m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), lowNibbles);
+			bytes = _mm256_add_epi8(bytes, _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high)));
+		}
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+	}
+	uint64_t result = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) + _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+	for(; i < count; i++) result += popCount(words[i]);
+	return result;
+}
+
+#define BINARY_KERNEL(name, vector, operation) \
+	ZSL_TARGET("avx2") static void name(uint64_t* to, const uint64_t* from, size_t words){ \
+		size_t i = 0; \
+		for(; i + 4 <= words; i += 4){ \
+			__m256i a = _mm256_loadu_si256((const __m256i*)(to + i)); \
+			__m256i b = _mm256_loadu_si256((const __m256i*)(from + i)); \
+			_mm256_storeu_si256((__m256i*)(to + i), vector); \
+		} \
+		for(; i < words; i++) to[i] = operation; \
+	}
+BINARY_KERNEL(bitsAndAvx2, _mm256_and_si256(a, b), to[i] & from[i])
+BINARY_KERNEL(bitsOrAvx2, _mm256_or_si256(a, b), to[i] | from[i])
+BINARY_KERNEL(bitsXorAvx2, _mm256_xor_si256(a, b), to[i] ^ from[i])
+BINARY_KERNEL(bitsAndNotAvx2, _mm256_andnot_si256(b, a), to[i] & ~from[i])
+#undef BINARY_KERNEL
+
+static CpuDispatch<void(uint64_t*, const uint64_t*, size_t), 2> bitsAndDispatch = {{{CPU_AVX2, bitsAndAvx2}, {0, bitsAndScalar}}};
+static CpuDispatch<void(uint64_t*, const uint64_t*, size_t), 2> bitsOrDispatch = {{{CPU_AVX2, bitsOrAvx2}, {0, bitsOrScalar}}};
+static CpuDispatch<void(uint64_t*, const uint64_t*, size_t), 2> bitsXorDispatch = {{{CPU_AVX2, bitsXorAvx2}, {0, bitsXorScalar}}};
+static CpuDispatch<void(uint64_t*, const uint64_t*, size_t), 2> bitsAndNotDispatch = {{{CPU_AVX2, bitsAndNotAvx2}, {0, bitsAndNotScalar}}};
+static CpuDispatch<uint64_t(const uint64_t*, size_t), 3> bitsPopCountDispatch = {{{CPU_AVX2, bitsPopCountAvx2}, {CPU_POPCNT, bitsPopCountPopcnt}, {0, bitsPopCountScalar}}};
+
+#else
+
+static CpuDispatch<void(uint64_t*, const uint64_t*, size_t), 1> bitsAndDispatch = {{{0, bitsAndScalar}}};
+static CpuDispatch<void(uint64_t*, const uint64_t*, size_t), 1> bitsOrDispatch = {{{0, bitsOrScalar}}};
+static CpuDispatch<void(uint64_t*, const uint64_t*, size_t), 1> bitsXorDispatch = {{{0, bitsXorScalar}}};
+static CpuDispatch<void(uint64_t*, const uint64_t*, size_t), 1> bitsAndNotDispatch = {{{0, bitsAndNotScalar}}};
+static CpuDispatch<uint64_t(const uint64_t*, size_t), 1> bitsPopCountDispatch = {{{0, bitsPopCountScalar}}};
+
+#endif
+
+void bitsAnd(uint64_t* to, const uint64_t* from, size_t words){
+	bitsAndDispatch(to, from, words);
+}
+
+void bitsOr(uint64_t* to, const uint64_t* from, size_t words){
+	bitsOrDispatch(to, from, words);
+}
+
+void bitsXor(uint64_t* to, const uint64_t* from, size_t words){
+	bitsXorDispatch(to, from, words);
+}
+
+void bitsAndNot(uint64_t* to, const uint64_t* from, size_t words){
+	bitsAndNotDispatch(to, from, words);
+}
+
+uint64_t bitsPopCount(const uint64_t* words, size_t count){
+	return bitsPopCountDispatch(words, count);
+}
+
+}
@@ -0,0 +1,116 @@
+#include "stdlib.h"
+#include "string.h"
+#include "zsl/core.h"
+#include "zsl/cpu.h"
+#if defined(__x86_64__) || defined(__i386__)
+	#include "cpuid.h"
+#endif
+
+namespace zsl{
+
+static const char* cpuFeatureNames[] = {
+	"sse2", "sse3", "ssse3", "sse4.1", "sse4.2", "popcnt", "aes", "avx", "fma",
+	"avx2", "bmi1", "bmi2", "lzcnt", "avx512f", "avx512bw", "avx512vl", "erms",
+};
+
+const char* getCpuFeatureName(CpuFeature feature){
+	size_t index = __builtin_ctz(feature);
+	return index < RAW_ARRAY_SIZE(cpuFeatureNames) ? cpuFeatureNames[index] : "unknown";
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static void detectCpu(CpuInfo& info){
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+	__cpuid(0, eax, ebx, ecx, edx);
+	memcpy(info.vendor, &ebx, 4);
+	memcpy(info.vendor + 4, &edx, 4);
+	memcpy(info.vendor + 8, &ecx, 4);
+	
+	CpuFeatures features = 0;
+	bool avxState = false, avx512State = false;
+	if(maxLeaf >= 1){
+		__cpuid(1, eax, ebx, ecx, edx);
+		info.cacheLineSize = ((ebx >> 8) & 0xFF) * 8;
+		if(edx & bit_SSE2) features |= CPU_SSE2;
+		if(ecx & bit_SSE3) features |= CPU_SSE3;
+		if(ecx & bit_SSSE3) features |= CPU_SSSE3;
+		if(ecx & bit_SSE4_1) features |= CPU_SSE41;
+		if(ecx & bit_SSE4_2) features |= CPU_SSE42;
+		if(ecx & bit_POPCNT) features |= CPU_POPCNT;
+		if(ecx & bit_AES) features |= CPU_AES;
+		// The CPU having AVX isn't enough, the OS has to save the wider registers on context switches.
+		if((ecx & bit_OSXSAVE) && (ecx & bit_AVX)){
+			uint32_t xcr0Low, xcr0High;
+			asm volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+			avxState = (xcr0Low & 0x6) == 0x6;
+			avx512State = (xcr0Low & 0xE6) == 0xE6;
+		}
+		if(avxState){
+			features |= CPU_AVX;
+			if(ecx & bit_FMA) features |= CPU_FMA;
+		}
+	}
+	if(maxLeaf >= 7){
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		if(ebx & bit_BMI) features |= CPU_BMI1;
+		if(ebx & bit_BMI2) features |= CPU_BMI2;
+		if(ebx & (1u << 9)) features |= CPU_ERMS;// cpuid.h has no name for it.
+		if(avxState && (ebx & bit_AVX2)) features |= CPU_AVX2;
+		if(avx512State && (ebx & bit_AVX512F)){
+			features |= CPU_AVX512F;
+			if(ebx & bit_AVX512BW) features |= CPU_AVX512BW;
+			if(ebx & bit_AVX512VL) features |= CPU_AVX512VL;
+		}
+	}
+	
+	unsigned int maxExtendedLeaf = __get_cpuid_max(0x80000000, nullptr);
+	if(maxExtendedLeaf >= 0x80000001){
+		__cpuid(0x80000001, eax, ebx, ecx, edx);
+		if(ecx & bit_LZCNT) features |= CPU_LZCNT;
+	}
+	if(maxExtendedLeaf >= 0x80000004){
+		unsigned int* brand = (unsigned int*)info.brand;
+		for(unsigned int leaf = 0; leaf < 3; leaf++){
+			__cpuid(0x80000002 + leaf, brand[leaf * 4], brand[leaf * 4 + 1], brand[leaf * 4 + 2], brand[leaf * 4 + 3]);
+		}
+	}
+	info.features = features;
+}
+#else
+static void detectCpu(CpuInfo& info){
+	memcpy(info.vendor, "unknown", 8);
+}
+#endif
+
+static CpuInfo buildCpuInfo(){
+	CpuInfo info = {};
+	info.cacheLineSize = 64;
+	detectCpu(info);
+	if(const char* disabled = getenv("ZSL_CPU_DISABLE")){
+		while(*disabled){
+			size_t length = strcspn(disabled, ",");
+			for(size_t i = 0; i < RAW_ARRAY_SIZE(cpuFeatureNames); i++){
+				if(strlen(cpuFeatureNames[i]) == length && strncmp(cpuFeatureNames[i], disabled, length) == 0) info.features &= ~(CpuFeatures(1) << i);
+			}
+			disabled += length + (disabled[length] == ',');
+		}
+		// Keep the set consistent, code checking for AVX-512 may assume AVX2.
+		struct Dependency{CpuFeature feature; CpuFeatures needs;};
+		Dependency dependencies[] = {
+			{CPU_FMA, CPU_AVX}, {CPU_AVX2, CPU_AVX}, {CPU_AVX512F, CPU_AVX2 | CPU_FMA},
+			{CPU_AVX512BW, CPU_AVX512F}, {CPU_AVX512VL, CPU_AVX512F},
+		};
+		for(Dependency& dependency: dependencies){
+			if((info.features & dependency.needs) != dependency.needs) info.features &= ~dependency.feature;
+		}
+	}
+	return info;
+}
+
+const CpuInfo& getCpuInfo(){
+	static CpuInfo info = buildCpuInfo();
+	return info;
+}
+
+}
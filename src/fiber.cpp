@@ -0,0 +1,204 @@
+#include "zsl/core.h"
+#include "zsl/atomics.h"
+#include "zsl/fiber.h"
+
+#if !defined(__x86_64__)
+	#error "Fibers are only implemented for x86-64."
+#endif
+
+// zslSwitchContext(void** from, void* to)
+// Saves the callee-saved registers on the current stack, stores the stack pointer
+// in *from, then restores the registers from the stack pointed to by to.
+// Everything else is caller-saved so the compiler already spilled it for us.
+asm(R"(
+	.text
+	.globl zslSwitchContext
+	.hidden zslSwitchContext
+	.type zslSwitchContext, @function
+zslSwitchContext:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size zslSwitchContext, .-zslSwitchContext
+	
+	.globl zslFiberEntry
+	.hidden zslFiberEntry
+	.type zslFiberEntry, @function
+zslFiberEntry:
+	movq %r12, %rdi
+	callq *%r13
+	ud2
+	.size zslFiberEntry, .-zslFiberEntry
+)");
+
+extern "C" void zslSwitchContext(void**, void*);
+extern "C" void zslFiberEntry();
+
+namespace zsl{
+
+struct FiberWorker{
+	void* context;
+	Fiber* current;
+};
+
+static thread_local FiberWorker* currentWorker = nullptr;
+
+// A fiber can migrate between worker threads every time it yields, so the
+// thread local must be reread after each switch. Keeping this out of line stops
+// the compiler from caching the thread local address across a switch.
+__attribute__((noinline)) static FiberWorker* getCurrentWorker(){
+	return currentWorker;
+}
+
+Fiber* getCurrentFiber(){
+	FiberWorker* worker = getCurrentWorker();
+	return worker ? worker->current : nullptr;
+}
+
+void fiberYield(){
+	Fiber* fiber = getCurrentFiber();
+	ZSL_ASSERT(fiber);
+	zslSwitchContext(&fiber->context, getCurrentWorker()->context);
+}
+
+static void fiberMain(Fiber* fiber){
+	fiber->function(fiber->userData);
+	fiber->done = true;
+	zslSwitchContext(&fiber->context, getCurrentWorker()->context);
+}
+
+static void fiberWorkerMain(void* userData){
+	FiberScheduler* scheduler = (FiberScheduler*)userData;
+	FiberWorker worker = {nullptr, nullptr};
+	currentWorker = &worker;
+	
+	scheduler->mutex.lock();
+	while(true){
+		while(!scheduler->head && !scheduler->quit) scheduler->ready.wait(&scheduler->mutex);
+		Fiber* fiber = scheduler->head;
+		if(!fiber) break;
+		scheduler->head = fiber->next;
+		if(!scheduler->head) scheduler->tail = nullptr;
+		scheduler->mutex.unlock();
+		
+		worker.current = fiber;
+		zslSwitchContext(&worker.context, fiber->context);
+		worker.current = nullptr;
+		
+		scheduler->mutex.lock();
+		if(fiber->done){
+			fiber->next = scheduler->freeFibers;
+			scheduler->freeFibers = fiber;
+			if(--scheduler->activeFibers == 0) scheduler->idle.broadcast();
+		}else{
+			// Yielded, put it at the back of the queue.
+			fiber->next = nullptr;
+			if(scheduler->tail) scheduler->tail->next = fiber;
+			else scheduler->head = fiber;
+			scheduler->tail = fiber;
+		}
+	}
+	scheduler->mutex.unlock();
+	
+	currentWorker = nullptr;
+	scheduler->exited.post();
+}
+
+void FiberScheduler::init(size_t threads, size_t fibers, size_t size){
+	if(threads == 0) threads = getProcessorCount();
+	size_t pageSize = getPageSize();
+	stackSize = align(max(size, pageSize), pageSize);
+	maxFibers = fibers;
+	stacks = (char*)reserveVirtualMemory(stackSize * maxFibers);
+	committed = stacks;
+	mark = stacks;
+	
+	freeFibers = nullptr;
+	head = nullptr;
+	tail = nullptr;
+	activeFibers = 0;
+	workerCount = threads;
+	quit = false;
+	
+	mutex.init();
+	ready.init();
+	idle.init();
+	exited.init();
+	for(size_t i = 0; i < workerCount; i++) threadCreate(fiberWorkerMain, this);
+}
+
+void FiberScheduler::deinit(){
+	mutex.lock();
+	quit = true;
+	ready.broadcast();
+	mutex.unlock();
+	exited.wait(workerCount);
+	
+	exited.deinit();
+	idle.deinit();
+	ready.deinit();
+	mutex.deinit();
+	freeVirtualMemory(stacks, stackSize * maxFibers);
+}
+
+void FiberScheduler::spawn(FiberFunction function, void* userData){
+	LockScope lock(mutex);
+	Fiber* fiber = freeFibers;
+	if(fiber){
+		freeFibers = fiber->next;
+	}else{
+		ZSL_ASSERT(mark < stacks + stackSize * maxFibers);
+		char* stack = mark;
+		mark += stackSize;
+		if(mark > committed){
+			size_t commitSize = min(stackSize * COMMIT_STACKS, (size_t)(stacks + stackSize * maxFibers - committed));
+			commitVirtualMemory(committed, commitSize);
+			committed += commitSize;
+		}
+		// The fiber header lives at the very top of its own stack.
+		fiber = (Fiber*)(stack + stackSize) - 1;
+	}
+	
+	fiber->next = nullptr;
+	fiber->function = function;
+	fiber->userData = userData;
+	fiber->done = false;
+	
+	// Build a frame zslSwitchContext can pop: r15, r14, r13, r12, rbx, rbp, return address.
+	// The entry stub calls r13(r12) with a 16 byte aligned stack.
+	void** sp = (void**)(alignFloor((char*)fiber, 16) - 7 * sizeof(void*));
+	sp[0] = nullptr;
+	sp[1] = nullptr;
+	sp[2] = (void*)fiberMain;
+	sp[3] = (void*)fiber;
+	sp[4] = nullptr;
+	sp[5] = nullptr;
+	sp[6] = (void*)zslFiberEntry;
+	fiber->context = (void*)sp;
+	
+	activeFibers++;
+	if(tail) tail->next = fiber;
+	else head = fiber;
+	tail = fiber;
+	ready.signal();
+}
+
+void FiberScheduler::wait(){
+	ZSL_ASSERT(!getCurrentFiber());
+	LockScope lock(mutex);
+	while(activeFibers != 0) idle.wait(&mutex);
+}
+
+}
@@ -0,0 +1,53 @@
+#include "zsl/core.h"
+#include "zsl/interner.h"
+
+namespace zsl{
+
+void Interner::init(size_t maxCount){
+	ZSL_ASSERT(maxCount <= NONE);
+	mutex.init();
+	arena.init();
+	strings = VirtualArrayList<StringView>::init(maxCount);
+	count = 0;
+	ids = HashMap<StringView, InternId>::init();
+}
+
+void Interner::deinit(){
+	ids.deinit();
+	strings.deinit();
+	arena.deinit();
+	mutex.deinit();
+}
+
+InternId Interner::internLocked(StringView string){
+	auto record = ids.getRecord(string);
+	if(record) return record->value;
+	ZSL_ASSERT(count < strings.maxCapacity);
+	char* copy = (char*)arena.alloc(nullptr, string.size + 1, 1);
+	memcpy(copy, string.data, string.size);
+	copy[string.size] = '\0';
+	StringView interned = {string.size, copy};
+	InternId id = (InternId)count;
+	strings.append(interned);
+	ids.insert(interned, id);
+	atomicStore(&count, count + 1, ORDER_RELEASE);
+	return id;
+}
+
+InternId Interner::intern(StringView string){
+	LockScope lock(mutex);
+	return internLocked(string);
+}
+
+void Interner::intern(ArrayView<StringView> values, InternId* results){
+	LockScope lock(mutex);
+	for(size_t i = 0; i < values.size; i++) results[i] = internLocked(values.data[i]);
+}
+
+InternId Interner::find(StringView string){
+	LockScope lock(mutex);
+	auto record = ids.getRecord(string);
+	return record ? record->value : NONE;
+}
+
+}
@@ -0,0 +1,418 @@
+#include "zsl/core.h"
+#include "zsl/atomics.h"
+#include "zsl/io.h"
+#include "string.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "sys/uio.h"
+#include "sys/syscall.h"
+#include "linux/io_uring.h"
+
+namespace zsl{
+
+bool File::isValid(){
+	return handle >= 0;
+}
+
+File fileOpen(const char* path, uint32_t mode){
+	int flags = O_CLOEXEC;
+	if((mode & FILE_READ) && (mode & FILE_WRITE)) flags |= O_RDWR;
+	else if(mode & FILE_WRITE) flags |= O_WRONLY;
+	else flags |= O_RDONLY;
+	if(mode & FILE_CREATE) flags |= O_CREAT;
+	if(mode & FILE_TRUNCATE) flags |= O_TRUNC;
+	if(mode & FILE_APPEND) flags |= O_APPEND;
+	if(mode & FILE_DIRECT) flags |= O_DIRECT;
+	return {open(path, flags, 0644)};
+}
+
+void fileClose(File file){
+	close(file.handle);
+}
+
+int64_t fileRead(File file, void* buffer, size_t size, size_t offset){
+	return pread(file.handle, buffer, size, offset);
+}
+
+int64_t fileWrite(File file, const void* buffer, size_t size, size_t offset){
+	return pwrite(file.handle, buffer, size, offset);
+}
+
+bool fileSync(File file){
+	return fsync(file.handle) == 0;
+}
+
+int64_t fileSize(File file){
+	struct stat info;
+	if(fstat(file.handle, &info) != 0) return -1;
+	return info.st_size;
+}
+
+ArrayView<char> mapFile(const char* path, uint32_t flags){
+	File file = fileOpen(path, (flags & MAPPING_WRITE) ? FILE_READ | FILE_WRITE : FILE_READ);
+	if(!file.isValid()) return {0, nullptr};
+	// The mapping keeps its own reference to the file.
+	ArrayView<char> view = mapFile(file, flags);
+	fileClose(file);
+	return view;
+}
+
+ArrayView<char> mapFile(File file, uint32_t flags){
+	int64_t size = fileSize(file);
+	if(size <= 0) return {0, nullptr};
+	int protection = PROT_READ;
+	if(flags & MAPPING_WRITE) protection |= PROT_WRITE;
+	int mapFlags = MAP_SHARED;
+	if(flags & MAPPING_POPULATE) mapFlags |= MAP_POPULATE;
+	void* data = mmap(nullptr, size, protection, mapFlags, file.handle, 0);
+	if(data == MAP_FAILED) return {0, nullptr};
+	ArrayView<char> view = {(size_t)size, (char*)data};
+	adviseMapping(view, flags);
+	return view;
+}
+
+void unmapFile(ArrayView<char> view){
+	if(view.data) munmap(view.data, view.size);
+}
+
+void adviseMapping(ArrayView<char> view, uint32_t flags){
+	// madvise wants a page aligned start.
+	char* start = alignFloor(view.data, getPageSize());
+	size_t size = view.size + (view.data - start);
+	if(flags & MAPPING_SEQUENTIAL) madvise(start, size, MADV_SEQUENTIAL);
+	if(flags & MAPPING_RANDOM) madvise(start, size, MADV_RANDOM);
+	if(flags & MAPPING_WILL_NEED) madvise(start, size, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+	if(flags & MAPPING_HUGE_PAGES) madvise(start, size, MADV_HUGEPAGE);
+#endif
+}
+
+void releaseMapping(ArrayView<char> view){
+	// Only release whole pages so we never drop a page the caller still uses.
+	size_t pageSize = getPageSize();
+	char* start = align(view.data, pageSize);
+	char* end = alignFloor(view.data + view.size, pageSize);
+	if(end > start) madvise(start, end - start, MADV_DONTNEED);
+}
+
+FileReader FileReader::init(const char* path, size_t windowSize){
+	FileReader reader;
+	reader.file = mapFile(path, MAPPING_SEQUENTIAL);
+	reader.windowSize = align(max(windowSize, getPageSize()), getPageSize());
+	reader.position = 0;
+	reader.released = 0;
+	if(reader.file.data) adviseMapping({min(reader.windowSize, reader.file.size), reader.file.data}, MAPPING_WILL_NEED);
+	return reader;
+}
+
+ArrayView<char> FileReader::next(){
+	if(isDone()) return {0, nullptr};
+	size_t end = min(position + windowSize, file.size);
+	ArrayView<char> window = {end - position, file.data + position};
+	
+	// Prefetch the window after this one.
+	if(end < file.size) adviseMapping({min(windowSize, file.size - end), file.data + end}, MAPPING_WILL_NEED);
+	// Release everything before the previous window, the caller may still hold on to that one.
+	if(position > windowSize && position - windowSize > released){
+		size_t until = position - windowSize;
+		releaseMapping({until - released, file.data + released});
+		released = alignFloor(until, getPageSize());
+	}
+	
+	position = end;
+	return window;
+}
+
+void FileReader::unread(size_t bytes){
+	ZSL_ASSERT(bytes <= position);
+	position -= bytes;
+}
+
+void FileReader::deinit(){
+	unmapFile(file);
+}
+
+static int ioUringSetup(uint32_t entries, io_uring_params* params){
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int ring, uint32_t submit, uint32_t minimum, uint32_t flags){
+	return (int)syscall(__NR_io_uring_enter, ring, submit, minimum, flags, nullptr, 0);
+}
+
+static int ioUringRegister(int ring, uint32_t opcode, void* arg, uint32_t count){
+	return (int)syscall(__NR_io_uring_register, ring, opcode, arg, count);
+}
+
+#define RING_PTR(ring, offset) ((uint32_t*)((char*)(ring) + (offset)))
+
+void IoQueue::init(uint32_t requested, bool polling){
+	entries = (uint32_t)nextPow2(max(requested, UINT32_C(1)));
+	localTail = 0;
+	kernelPolling = false;
+	pending = ArrayList<IoRequest>::init();
+	completed = ArrayList<IoCompletion>::init();
+	submitMutex.init();
+	completeMutex.init();
+	
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	if(polling) params.flags |= IORING_SETUP_SQPOLL;
+	ring = ioUringSetup(entries, &params);
+	if(ring < 0 && polling){
+		memset(&params, 0, sizeof(params));
+		ring = ioUringSetup(entries, &params);
+	}else if(ring >= 0){
+		kernelPolling = polling;
+	}
+	if(ring < 0) return;
+	entries = params.sq_entries;
+	
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) cqRing = sqRing;
+	else cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+	sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED){
+		// Something is restricting io_uring, use the blocking path instead.
+		if(sqes != MAP_FAILED) munmap(sqes, sqesSize);
+		if(cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+		if(sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+		close(ring);
+		ring = -1;
+		kernelPolling = false;
+		return;
+	}
+	
+	sqHead = RING_PTR(sqRing, params.sq_off.head);
+	sqTail = RING_PTR(sqRing, params.sq_off.tail);
+	sqMask = RING_PTR(sqRing, params.sq_off.ring_mask);
+	sqFlags = RING_PTR(sqRing, params.sq_off.flags);
+	sqArray = RING_PTR(sqRing, params.sq_off.array);
+	cqHead = RING_PTR(cqRing, params.cq_off.head);
+	cqTail = RING_PTR(cqRing, params.cq_off.tail);
+	cqMask = RING_PTR(cqRing, params.cq_off.ring_mask);
+	cqes = (char*)cqRing + params.cq_off.cqes;
+	localTail = *sqTail;
+}
+
+#undef RING_PTR
+
+void IoQueue::deinit(){
+	if(ring >= 0){
+		munmap(sqes, sqesSize);
+		if(cqRing != sqRing) munmap(cqRing, cqRingSize);
+		munmap(sqRing, sqRingSize);
+		close(ring);
+	}
+	completeMutex.deinit();
+	submitMutex.deinit();
+	completed.deinit();
+	pending.deinit();
+}
+
+bool IoQueue::registerBuffers(ArrayView<ArrayView<char>> buffers){
+	if(ring < 0) return true;
+	iovec* vectors = alloc<nalloc, iovec>(buffers.size);
+	for(size_t i = 0; i < buffers.size; i++) vectors[i] = {buffers[i].data, buffers[i].size};
+	int err = ioUringRegister(ring, IORING_REGISTER_BUFFERS, vectors, (uint32_t)buffers.size);
+	dealloc<nalloc>(vectors);
+	return err == 0;
+}
+
+// Performs a request with a blocking call.
+static int64_t fileTransfer(const IoRequest& request){
+	int64_t result = 0;
+	switch(request.operation){
+		case IoOperation::READ:
+		case IoOperation::READ_FIXED:
+			result = fileRead(request.file, request.buffer, request.size, request.offset);
+			break;
+		case IoOperation::WRITE:
+		case IoOperation::WRITE_FIXED:
+			result = fileWrite(request.file, request.buffer, request.size, request.offset);
+			break;
+		case IoOperation::SYNC:
+			result = fileSync(request.file) ? 0 : -1;
+			break;
+	}
+	// Match io_uring and report errors as negative error codes.
+	return result < 0 ? -errno : result;
+}
+
+void IoQueue::queue(const IoRequest& request){
+	LockScope lock(submitMutex);
+	// The length field of an entry is 32 bits.
+	if(request.size > UINT32_MAX){
+		complete(request.userData, -EINVAL);
+		return;
+	}
+	if(ring < 0){
+		pending.append(request);
+		return;
+	}
+	
+	// The submission ring is full, hand what we have to the kernel to make room.
+	while(localTail - atomicLoad(sqHead, ORDER_ACQUIRE) >= entries){
+		if(kernelPolling){
+			flush();
+			threadYield();
+		}else if(flush() < 0){
+			// The kernel won't take anything, so the ring won't drain either.
+			complete(request.userData, fileTransfer(request));
+			return;
+		}
+	}
+	
+	uint32_t index = localTail & *sqMask;
+	io_uring_sqe* sqe = (io_uring_sqe*)sqes + index;
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	switch(request.operation){
+		case IoOperation::READ:        sqe->opcode = IORING_OP_READ; break;
+		case IoOperation::WRITE:       sqe->opcode = IORING_OP_WRITE; break;
+		case IoOperation::READ_FIXED:  sqe->opcode = IORING_OP_READ_FIXED; break;
+		case IoOperation::WRITE_FIXED: sqe->opcode = IORING_OP_WRITE_FIXED; break;
+		case IoOperation::SYNC:        sqe->opcode = IORING_OP_FSYNC; break;
+	}
+	sqe->fd = request.file.handle;
+	sqe->addr = (uint64_t)request.buffer;
+	sqe->len = (uint32_t)request.size;
+	sqe->off = request.offset;
+	sqe->buf_index = (uint16_t)request.bufferIndex;
+	sqe->user_data = (uint64_t)request.userData;
+	sqArray[index] = index;
+	localTail++;
+}
+
+void IoQueue::read(File file, void* buffer, size_t size, size_t offset, void* userData){
+	queue({IoOperation::READ, 0, file, buffer, size, offset, userData});
+}
+
+void IoQueue::write(File file, const void* buffer, size_t size, size_t offset, void* userData){
+	queue({IoOperation::WRITE, 0, file, (void*)buffer, size, offset, userData});
+}
+
+void IoQueue::readFixed(File file, uint32_t bufferIndex, void* buffer, size_t size, size_t offset, void* userData){
+	queue({IoOperation::READ_FIXED, bufferIndex, file, buffer, size, offset, userData});
+}
+
+void IoQueue::writeFixed(File file, uint32_t bufferIndex, const void* buffer, size_t size, size_t offset, void* userData){
+	queue({IoOperation::WRITE_FIXED, bufferIndex, file, (void*)buffer, size, offset, userData});
+}
+
+void IoQueue::sync(File file, void* userData){
+	queue({IoOperation::SYNC, 0, file, nullptr, 0, 0, userData});
+}
+
+uint32_t IoQueue::submit(){
+	LockScope lock(submitMutex);
+	if(ring < 0){
+		uint32_t count = (uint32_t)pending.size;
+		for(IoRequest& request: pending){
+			complete(request.userData, fileTransfer(request));
+		}
+		pending.clear();
+		return count;
+	}
+	
+	uint32_t count = localTail - *sqTail;
+	flush();
+	return count;
+}
+
+int IoQueue::enter(uint32_t submit, uint32_t minimum, uint32_t flags){
+	while(true){
+		int result = ioUringEnter(ring, submit, minimum, flags);
+		if(result >= 0) return result;
+		int error = errno;
+		if(error == EBUSY){
+			// Completions the kernel couldn't post are backed up behind a full completion ring.
+			if(!stashCompletions()) threadYield();
+		}else if(error == EAGAIN){
+			threadYield();
+		}else if(error != EINTR){
+			return -error;
+		}
+	}
+}
+
+int IoQueue::flush(){
+	atomicStore(sqTail, localTail, ORDER_RELEASE);
+	if(kernelPolling){
+		if(atomicLoad(sqFlags, ORDER_RELAXED) & IORING_SQ_NEED_WAKEUP) return min(enter(0, 0, IORING_ENTER_SQ_WAKEUP), 0);
+		return 0;
+	}
+	// The kernel moves sqHead past what it took, whatever a failed or partial enter left is still ahead of it.
+	while(uint32_t count = localTail - atomicLoad(sqHead, ORDER_ACQUIRE)){
+		int result = enter(count, 0, 0);
+		if(result < 0) return result;
+		if(result == 0) threadYield();
+	}
+	return 0;
+}
+
+bool IoQueue::stashCompletions(){
+	LockScope lock(completeMutex);
+	uint32_t head = *cqHead;
+	uint32_t tail = atomicLoad(cqTail, ORDER_ACQUIRE);
+	for(uint32_t i = head; i != tail; i++){
+		io_uring_cqe* cqe = (io_uring_cqe*)cqes + (i & *cqMask);
+		completed.append({(void*)cqe->user_data, cqe->res});
+	}
+	atomicStore(cqHead, tail, ORDER_RELEASE);
+	return head != tail;
+}
+
+void IoQueue::complete(void* userData, int64_t result){
+	LockScope lock(completeMutex);
+	completed.append({userData, result});
+}
+
+size_t IoQueue::poll(ArrayView<IoCompletion> completions){
+	LockScope lock(completeMutex);
+	// Completions set aside while the ring was backed up or a request was refused go first.
+	size_t count = min(completions.size, completed.size);
+	memcpy(completions.data, completed.data, count * sizeof(IoCompletion));
+	memmove(completed.data, completed.data + count, (completed.size - count) * sizeof(IoCompletion));
+	completed.size -= count;
+	if(ring < 0) return count;
+	
+	uint32_t head = *cqHead;
+	uint32_t tail = atomicLoad(cqTail, ORDER_ACQUIRE);
+	while(head != tail && count < completions.size){
+		io_uring_cqe* cqe = (io_uring_cqe*)cqes + (head & *cqMask);
+		completions[count++] = {(void*)cqe->user_data, cqe->res};
+		head++;
+	}
+	atomicStore(cqHead, head, ORDER_RELEASE);
+	return count;
+}
+
+size_t IoQueue::wait(ArrayView<IoCompletion> completions, size_t minimum){
+	minimum = min(minimum, completions.size);
+	int error = 0;
+	if(ring < 0){
+		submit();
+	}else{
+		LockScope lock(submitMutex);
+		error = flush();
+	}
+	size_t count = poll(completions);
+	// The blocking fallback finished everything inside submit() so there is nothing to wait on. If the
+	// kernel refused the requests they won't finish either.
+	while(count < minimum && ring >= 0 && error == 0){
+		error = enter(0, (uint32_t)(minimum - count), IORING_ENTER_GETEVENTS);
+		error = min(error, 0);
+		count += poll({completions.size - count, completions.data + count});
+	}
+	return count;
+}
+
+}
@@ -2,6 +2,7 @@
 #include "string.h"
 #include "zsl/core.h"
 #include "zsl/atomics.h"
+#include "zsl/profile.h"
 
 namespace zsl{
 
@@ -20,23 +21,36 @@ struct BlockData{
 	}
 	
 	BlockPointer* getBlock(){
-		return alignFloor((BlockPointer*)this, alignment);
+		if(alignment > alignof(BlockData)) return ((BlockPointer**)this)[-1];
+		return (BlockPointer*)this;
 	}
 };
 static_assert(alignof(BlockPointer*) <= alignof(BlockData));
 
+// Blocks themselves are only aligned to BlockData, so data aligned past that lands somewhere inside
+// its block. Those blocks keep a pointer back to the block's start just before their BlockData.
+static bool isOverAligned(size_t alignment){
+	return alignment > alignof(BlockData);
+}
+
 void* buildBlock(BlockPointer* ptr, size_t size, size_t alignment){
-	BlockData* data = align((BlockData*)ptr + 1, alignment) - 1;
+	if(!isOverAligned(alignment)){
+		BlockData* data = (BlockData*)ptr;
+		*data = {size, alignment};
+		return (void*)(data + 1);
+	}
+	char* start = align((char*)ptr + sizeof(BlockPointer*) + sizeof(BlockData), alignment);
+	BlockData* data = (BlockData*)start - 1;
 	*data = {size, alignment};
-	return (void*)(data + 1);
+	((BlockPointer**)data)[-1] = ptr;
+	return (void*)start;
 }
 
 size_t getIndex(size_t size, size_t alignment){
 	// All blocks are aligned to BlockData.
-	// If alignment greater than sizeof of BlockData,
-	// add 'alignment - sizeof(BlockData)' to make sure
-	// We have room to align the data.
-	size_t padding = alignment > sizeof(BlockData) ? alignment - sizeof(BlockData) : 0;
+	// If alignment is greater than that, add room for the block pointer
+	// and 'alignment - alignof(BlockData)' to make sure we can align the data.
+	size_t padding = isOverAligned(alignment) ? alignment - alignof(BlockData) + sizeof(BlockPointer*) : 0;
 	// First couple pools are so small just ignore them.
 	return log2Ceil(max(sizeof(size_t), size + padding));
 }
@@ -84,35 +98,100 @@ BlockPointer* popBlock(size_t index){
 	return block;
 }
 
+// Large blocks get their own mapping, with the BlockData just before the data like pooled blocks.
+// Whether a block is mapped follows from its size and alignment, so nothing else has to be stored.
+// Alignments above a page can't be had from mmap, those blocks stay in the pools.
+static size_t getPageSizeCached(){
+	static size_t pageSize = getPageSize();
+	return pageSize;
+}
+
+static bool isMapped(size_t size, size_t alignment){
+	return size >= NALLOC_DIRECT_SIZE && alignment <= getPageSizeCached();
+}
+
+// Where buildBlock puts the data in a page aligned block. The block pointer of an over aligned mapped
+// block goes stale when it's remapped, but mapped blocks are found from this offset instead.
+static size_t getMapOffset(size_t alignment){
+	if(!isOverAligned(alignment)) return sizeof(BlockData);
+	return align(sizeof(BlockPointer*) + sizeof(BlockData), alignment);
+}
+
+// Mappings are rounded up to a sixteenth of the size's power of two, so a block that grows a little
+// at a time is remapped about sixteen times per doubling instead of on every call.
+static size_t getMapSize(size_t size, size_t alignment){
+	size += getMapOffset(alignment);
+	return align(size, max(getPageSizeCached(), size_t(nextPow2(uint64_t(size)) / 16)));
+}
+
+static void* allocMapped(size_t size, size_t alignment){
+	char* map = (char*)allocateVirtualMemory(getMapSize(size, alignment));
+	if(!map) return nullptr;
+	return buildBlock((BlockPointer*)map, size, alignment);
+}
+
+static void freeMapped(BlockData* blockData){
+	char* map = (char*)blockData + sizeof(BlockData) - getMapOffset(blockData->alignment);
+	freeVirtualMemory(map, getMapSize(blockData->size, blockData->alignment));
+}
+
+static void* resizeMapped(BlockData* blockData, size_t size){
+	size_t alignment = blockData->alignment;
+	size_t offset = getMapOffset(alignment);
+	size_t oldMapSize = getMapSize(blockData->size, alignment);
+	size_t newMapSize = getMapSize(size, alignment);
+	char* map = (char*)blockData + sizeof(BlockData) - offset;
+	if(oldMapSize != newMapSize){
+		map = (char*)resizeVirtualMemory(map, oldMapSize, newMapSize);
+		if(!map) return nullptr;
+	}
+	blockData = (BlockData*)(map + offset) - 1;
+	blockData->size = size;
+	return map + offset;
+}
+
 void* nalloc(void* ptr, size_t size, size_t alignment){
 	// Allocate new block.
-	if(!ptr) return buildBlock(popBlock(getIndex(size, alignment)), size, alignment);
+	if(!ptr){
+		// See setAllocationSampling.
+		if(atomicLoad(&allocationSampleInterval, ORDER_RELAXED)) recordAllocationSample(size);
+		if(isMapped(size, alignment)) return allocMapped(size, alignment);
+		return buildBlock(popBlock(getIndex(size, alignment)), size, alignment);
+	}
 	// Get existing block.
 	BlockData* blockData = BlockData::get(ptr);
 	// Alignment must be same as previous allocations of this data.
 	alignment = blockData->alignment;
+	bool mapped = isMapped(blockData->size, alignment);
 	// Get index of existing block.
 	size_t index = getIndex(blockData->size, alignment);
 	if(size == 0){
 		// Deallocate existing block.
-		pushBlock(index, blockData->getBlock());
+		if(mapped) freeMapped(blockData);
+		else pushBlock(index, blockData->getBlock());
 		return nullptr;
 	}
 	
+	if(size > blockData->size && atomicLoad(&allocationSampleInterval, ORDER_RELAXED)) recordAllocationSample(size - blockData->size);
+	bool newMapped = isMapped(size, alignment);
+	// Mapped to mapped, the pages are moved instead of copied.
+	if(mapped && newMapped) return resizeMapped(blockData, size);
 	// Get index of new block.
 	size_t newIndex = getIndex(size, alignment);
 	// If size is smaller, don't reallocate, just resize.
-	if(newIndex <= index){
+	if(!mapped && !newMapped && newIndex <= index){
 		blockData->size = size;
 		return ptr;
 	}
 	
-	// Size is larger so we must allocate new block.
-	void* newPtr = buildBlock(popBlock(newIndex), size, alignment);
+	// Size is larger or the block moves between the pools and its own mapping, so we must allocate new block.
+	void* newPtr = newMapped ? allocMapped(size, alignment) : buildBlock(popBlock(newIndex), size, alignment);
+	if(!newPtr) return nullptr;
 	// Copy data to new block.
-	memcpy(newPtr, ptr, blockData->size);
+	memcpy(newPtr, ptr, min(size, blockData->size));
 	// Deallocate the old block.
-	pushBlock(index, blockData->getBlock());
+	if(mapped) freeMapped(blockData);
+	else pushBlock(index, blockData->getBlock());
 	return newPtr;
 }
 
@@ -3,12 +3,15 @@
 #include "string.h"
 #include "unistd.h"
 #include "sys/mman.h"
+#include "sched.h"
+#include "time.h"
 //#include "pthread.h"
 
 namespace zsl{
 
 void* allocateVirtualMemory(size_t size){
-	return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return ptr == MAP_FAILED ? nullptr : ptr;
 }
 
 void* reserveVirtualMemory(size_t size){
@@ -18,7 +21,14 @@ void* reserveVirtualMemory(size_t size){
 void commitVirtualMemory(void* ptr, size_t size){
 	void* alignPtr = alignFloor(ptr, sysconf(_SC_PAGE_SIZE));
 	size += (size_t)ptr - (size_t)alignPtr;
-	mprotect(ptr, size, PROT_READ | PROT_WRITE);
+	mprotect(alignPtr, size, PROT_READ | PROT_WRITE);
+}
+
+void decommitVirtualMemory(void* ptr, size_t size){
+	void* alignPtr = alignFloor(ptr, sysconf(_SC_PAGE_SIZE));
+	size += (size_t)ptr - (size_t)alignPtr;
+	madvise(alignPtr, size, MADV_DONTNEED);
+	mprotect(alignPtr, size, PROT_NONE);
 }
 
 void freeVirtualMemory(void* ptr, size_t size){
@@ -27,12 +37,42 @@ void freeVirtualMemory(void* ptr, size_t size){
 	munmap(alignPtr, size);
 }
 
+void* resizeVirtualMemory(void* ptr, size_t oldSize, size_t newSize){
+	void* newPtr = mremap(ptr, oldSize, newSize, MREMAP_MAYMOVE);
+	return newPtr == MAP_FAILED ? nullptr : newPtr;
+}
+
+size_t getProcessorCount(){
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (size_t)count : 1;
+}
+
+size_t getPageSize(){
+	return sysconf(_SC_PAGE_SIZE);
+}
+
 struct ThreadData{
 	ThreadFunction function;
 	void* userData;
 };
 
+static thread_local StackRange threadStack __attribute__((tls_model("initial-exec"))) = {nullptr, nullptr};
+
+StackRange getThreadStack(bool lookup){
+	if(!threadStack.high && lookup){
+		pthread_attr_t attr;
+		if(pthread_getattr_np(pthread_self(), &attr) == 0){
+			void* low;
+			size_t size;
+			if(pthread_attr_getstack(&attr, &low, &size) == 0) threadStack = {(char*)low, (char*)low + size};
+			pthread_attr_destroy(&attr);
+		}
+	}
+	return threadStack;
+}
+
 static void* threadWrapperFunction(void* voidData){
+	getThreadStack();
 	ThreadData data = *(ThreadData*)voidData;
 	dealloc<nalloc>((ThreadData*)voidData);
 	data.function(data.userData);
@@ -56,6 +96,27 @@ void threadCreate(ThreadFunction function, void* userData){
 	if(err != 0) dealloc<nalloc>(data);
 }
 
+void threadYield(){
+	sched_yield();
+}
+
+void threadSleep(uint64_t nanoseconds){
+	timespec duration = {(time_t)(nanoseconds / 1000000000), (long)(nanoseconds % 1000000000)};
+	while(nanosleep(&duration, &duration) != 0);
+}
+
+uint64_t getTime(){
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+uint64_t getProcessTime(){
+	timespec time;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+	return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
 void Mutex::init(){
 	int err = pthread_mutex_init(&mutex, nullptr);
 }
@@ -65,7 +126,7 @@ void Mutex::lock(){
 }
 
 bool Mutex::tryLock(){
-	return pthread_mutex_trylock(&mutex);
+	return pthread_mutex_trylock(&mutex) == 0;
 }
 
 void Mutex::unlock(){
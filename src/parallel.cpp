@@ -0,0 +1,139 @@
+#include "zsl/core.h"
+#include "zsl/parallel.h"
+
+namespace zsl{
+
+// Only threads that ask for scratch memory reserve an arena.
+struct ScratchArena{
+	Arena arena;
+	bool used;
+	~ScratchArena(){if(used) arena.deinit();}
+};
+
+static thread_local ScratchArena scratchArena;
+
+Arena* getScratchArena(){
+	if(!scratchArena.used){
+		scratchArena.arena.init();
+		scratchArena.used = true;
+	}
+	return &scratchArena.arena;
+}
+
+void* salloc(void* ptr, size_t size, size_t alignment){return getScratchArena()->alloc(ptr, size, alignment);}
+
+struct ParallelJob{
+	ParallelFunction function;
+	void* context;
+	size_t count;
+	size_t next;// The next chunk to take.
+};
+
+struct ThreadPool{
+	// Held by whoever has a loop on the pool, or is restarting it.
+	Mutex mutex;
+	// Posted once per worker that should take a share of job, or quit.
+	Semaphore wake;
+	// Posted once by every worker that was woken, after it's done with job.
+	Semaphore done;
+	ParallelJob* job;
+	size_t workerCount;
+	bool quit;
+	
+	void init();
+	void deinit();
+	void start(size_t threads);
+	void stop();
+};
+
+// True on workers, and on a caller while its loop is on the pool.
+static thread_local bool inParallelRun = false;
+
+static void runChunks(ParallelJob* job){
+	char* mark = scratchArena.used ? scratchArena.arena.mark : nullptr;
+	while(true){
+		size_t chunk = atomicAdd(&job->next, size_t(1), ORDER_RELAXED);
+		if(chunk >= job->count) break;
+		job->function(job->context, chunk);
+	}
+	// The arena may have been first used by this loop.
+	if(scratchArena.used) scratchArena.arena.mark = mark ? mark : scratchArena.arena.data;
+}
+
+static void parallelWorkerMain(void* userData){
+	ThreadPool* pool = (ThreadPool*)userData;
+	inParallelRun = true;
+	while(true){
+		pool->wake.wait();
+		if(pool->quit) break;
+		runChunks(pool->job);
+		pool->done.post();
+	}
+	pool->done.post();
+}
+
+void ThreadPool::init(){
+	mutex.init();
+	wake.init();
+	done.init();
+	job = nullptr;
+	workerCount = 0;
+	quit = false;
+	start(0);
+}
+
+void ThreadPool::deinit(){
+	mutex.lock();
+	stop();
+	mutex.unlock();
+	done.deinit();
+	wake.deinit();
+	mutex.deinit();
+}
+
+void ThreadPool::start(size_t threads){
+	if(threads == 0) threads = getProcessorCount();
+	atomicStore(&workerCount, threads - 1, ORDER_RELAXED);
+	for(size_t i = 0; i < workerCount; i++) threadCreate(parallelWorkerMain, this);
+}
+
+void ThreadPool::stop(){
+	quit = true;
+	wake.post(workerCount);
+	done.wait(workerCount);
+	quit = false;
+}
+
+static ThreadPool* getThreadPool(){static GlobalVar<ThreadPool> pool; return &pool.var;}
+
+size_t getParallelThreadCount(){return atomicLoad(&getThreadPool()->workerCount, ORDER_RELAXED) + 1;}
+
+void setParallelThreadCount(size_t threads){
+	ThreadPool* pool = getThreadPool();
+	LockScope lock(pool->mutex);
+	pool->stop();
+	pool->start(threads);
+}
+
+void parallelRun(size_t count, ParallelFunction function, void* context){
+	ParallelJob job = {function, context, count, 0};
+	if(count <= 1 || inParallelRun){
+		runChunks(&job);
+		return;
+	}
+	ThreadPool* pool = getThreadPool();
+	if(!pool->mutex.tryLock()){
+		runChunks(&job);
+		return;
+	}
+	size_t helpers = min(pool->workerCount, count - 1);
+	pool->job = &job;
+	inParallelRun = true;
+	if(helpers) pool->wake.post(helpers);
+	runChunks(&job);
+	if(helpers) pool->done.wait(helpers);
+	inParallelRun = false;
+	pool->mutex.unlock();
+}
+
+}
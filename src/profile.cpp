@@ -0,0 +1,346 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "signal.h"
+#include "dlfcn.h"
+#include "ucontext.h"
+#include "sys/time.h"
+#include "zsl/core.h"
+#include "zsl/atomics.h"
+#include "zsl/array_list.h"
+#include "zsl/hash_map.h"
+#include "zsl/dense_map.h"
+#include "zsl/string_utils.h"
+#include "zsl/io.h"
+#include "zsl/clock.h"
+#include "zsl/profile.h"
+
+namespace zsl{
+
+static double calibrateCycles(){
+	// Sample both clocks over a few milliseconds. Long enough that the
+	// syscall overhead of getTime disappears in the noise.
+	uint64_t startTime = getTime();
+	uint64_t startCycles = readCyclesSerialized();
+	threadSleep(10000000);
+	uint64_t endTime = getTime();
+	uint64_t endCycles = readCyclesSerialized();
+	return (double)(endCycles - startCycles) / (double)(endTime - startTime);
+}
+
+double getCyclesPerNanosecond(){
+	static double cyclesPerNanosecond = calibrateCycles();
+	return cyclesPerNanosecond;
+}
+
+static ProfileBuffer* profileBuffers = nullptr;
+static size_t profileThreadCount = 0;
+
+ProfileBuffer* registerProfileBuffer(){
+	// Buffers are never freed since the thread that owns it may exit long before we export.
+	// Pages are only committed as the ring fills up.
+	ProfileBuffer* buffer = (ProfileBuffer*)allocateVirtualMemory(sizeof(ProfileBuffer));
+	buffer->threadIndex = atomicAdd(&profileThreadCount, size_t(1));
+	buffer->count = 0;
+	buffer->next = atomicLoad(&profileBuffers, ORDER_RELAXED);
+	while(!atomicCompareExchangeWeak(&profileBuffers, &buffer->next, buffer, ORDER_RELEASE, ORDER_RELAXED));
+	profileBuffer = buffer;
+	return buffer;
+}
+
+void profileReset(){
+	for(ProfileBuffer* buffer = atomicLoad(&profileBuffers, ORDER_ACQUIRE); buffer; buffer = buffer->next){
+		atomicStore(&buffer->count, size_t(0), ORDER_RELEASE);
+	}
+}
+
+static void appendString(ArrayList<char>& json, const char* string, size_t length){
+	json.reserve(json.size + length);
+	memcpy(json.data + json.size, string, length);
+	json.size += length;
+}
+
+static bool writeWholeFile(const char* path, ArrayList<char>& text){
+	File file = fileOpen(path, FILE_WRITE | FILE_CREATE | FILE_TRUNCATE);
+	bool success = file.isValid() && fileWrite(file, text.data, text.size, 0) == (int64_t)text.size;
+	if(file.isValid()) fileClose(file);
+	return success;
+}
+
+bool profileExport(const char* path){
+	ProfileBuffer* buffers = atomicLoad(&profileBuffers, ORDER_ACQUIRE);
+	
+	// Chrome wants microseconds, start from the earliest event to keep the numbers small.
+	uint64_t base = UINT64_MAX;
+	for(ProfileBuffer* buffer = buffers; buffer; buffer = buffer->next){
+		size_t count = atomicLoad(&buffer->count, ORDER_ACQUIRE);
+		for(size_t i = count > ProfileBuffer::CAPACITY ? count - ProfileBuffer::CAPACITY : 0; i < count; i++){
+			base = min(base, buffer->events[BIT_MODULO(i, ProfileBuffer::CAPACITY)].start);
+		}
+	}
+	double cyclesPerMicrosecond = getCyclesPerNanosecond() * 1000.0;
+	
+	auto json = ArrayList<char>::init(4096);
+	const char header[] = "{\"traceEvents\":[";
+	appendString(json, header, sizeof(header) - 1);
+	bool first = true;
+	char line[128];
+	for(ProfileBuffer* buffer = buffers; buffer; buffer = buffer->next){
+		size_t count = atomicLoad(&buffer->count, ORDER_ACQUIRE);
+		for(size_t i = count > ProfileBuffer::CAPACITY ? count - ProfileBuffer::CAPACITY : 0; i < count; i++){
+			ProfileEvent& event = buffer->events[BIT_MODULO(i, ProfileBuffer::CAPACITY)];
+			if(!first) json.append(',');
+			first = false;
+			appendString(json, "{\"name\":\"", 9);
+			for(const char* c = event.name; *c; c++){
+				if(*c == '"' || *c == '\\') json.append('\\');
+				json.append(*c);
+			}
+			int length = snprintf(line, sizeof(line), "\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->threadIndex, (event.start - base) / cyclesPerMicrosecond, (event.end - event.start) / cyclesPerMicrosecond);
+			appendString(json, line, length);
+		}
+	}
+	appendString(json, "]}\n", 3);
+	
+	bool success = writeWholeFile(path, json);
+	json.deinit();
+	return success;
+}
+
+
+// --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------- Backtraces ---------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// Every frame starts with the caller's frame pointer followed by the return address. A frame must lie
+// above the last one and inside [low, high), so a garbage frame pointer ends the walk instead of faulting.
+static size_t walkFrames(void** fp, char* low, char* high, void** frames, size_t depth, size_t maxFrames){
+	while(depth < maxFrames){
+		char* frame = (char*)fp;
+		if(frame < low || frame + 2 * sizeof(void*) > high || ((uintptr_t)frame & (sizeof(void*) - 1))) break;
+		void* address = fp[1];
+		if(!address) break;
+		frames[depth++] = address;
+		low = frame + 2 * sizeof(void*);
+		fp = (void**)fp[0];
+	}
+	return depth;
+}
+
+__attribute__((noinline)) size_t captureBacktrace(void** frames, size_t maxFrames){
+	StackRange stack = getThreadStack();
+	char* fp = (char*)__builtin_frame_address(0);
+	// Fibers run on stacks of their own, which aren't walked.
+	if(fp < stack.low || fp >= stack.high) return 0;
+	return walkFrames((void**)fp, fp, stack.high, frames, 0, maxFrames);
+}
+
+size_t symbolizeAddress(void* address, char* buffer, size_t size){
+	Dl_info info;
+	bool found = dladdr(address, &info) != 0;
+	int length;
+	if(found && info.dli_sname){
+		length = snprintf(buffer, size, "%s", info.dli_sname);
+	}else if(found && info.dli_fname){
+		const char* module = strrchr(info.dli_fname, '/');
+		length = snprintf(buffer, size, "%s+0x%zx", module ? module + 1 : info.dli_fname, (size_t)((char*)address - (char*)info.dli_fbase));
+	}else{
+		length = snprintf(buffer, size, "0x%zx", (size_t)address);
+	}
+	return length < 0 ? 0 : min((size_t)length, size - 1);
+}
+
+void printBacktrace(){
+	void* frames[64];
+	char name[256];
+	size_t depth = captureBacktrace(frames, 64);
+	for(size_t i = 0; i < depth; i++){
+		// Return addresses point past the call, step back into it.
+		symbolizeAddress((char*)frames[i] - 1, name, sizeof(name));
+		fprintf(stderr, "  #%zu %p %s\n", i, frames[i], name);
+	}
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Sampling ----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+// Initial exec so that touching them from the signal handler never allocates.
+#define ZSL_SIGNAL_SAFE_TLS __attribute__((tls_model("initial-exec")))
+
+static SampleBuffer* cpuSampleBuffers = nullptr;
+static SampleBuffer* allocationSampleBuffers = nullptr;
+static thread_local SampleBuffer* cpuSampleBuffer ZSL_SIGNAL_SAFE_TLS = nullptr;
+static thread_local SampleBuffer* allocationSampleBuffer ZSL_SIGNAL_SAFE_TLS = nullptr;
+static bool samplerRunning = false;
+
+static SampleBuffer* registerSampleBuffer(SampleBuffer** buffers){
+	// Never freed, like ProfileBuffer. mmap is safe to call from a signal handler, nalloc isn't.
+	SampleBuffer* buffer = (SampleBuffer*)allocateVirtualMemory(sizeof(SampleBuffer));
+	buffer->count = 0;
+	buffer->next = atomicLoad(buffers, ORDER_RELAXED);
+	while(!atomicCompareExchangeWeak(buffers, &buffer->next, buffer, ORDER_RELEASE, ORDER_RELAXED));
+	return buffer;
+}
+
+static void samplerHandler(int, siginfo_t*, void* context){
+	if(!atomicLoad(&samplerRunning, ORDER_RELAXED)) return;
+	int savedErrno = errno;
+	SampleBuffer* buffer = cpuSampleBuffer;
+	if(!buffer) buffer = cpuSampleBuffer = registerSampleBuffer(&cpuSampleBuffers);
+	size_t count = buffer->count;
+	if(count < SampleBuffer::CAPACITY){
+		ProfileSample& sample = buffer->samples[count];
+		mcontext_t& machine = ((ucontext_t*)context)->uc_mcontext;
+#if defined(__x86_64__)
+		char* pc = (char*)machine.gregs[REG_RIP];
+		char* sp = (char*)machine.gregs[REG_RSP];
+		void** fp = (void**)machine.gregs[REG_RBP];
+#elif defined(__aarch64__)
+		char* pc = (char*)machine.pc;
+		char* sp = (char*)machine.sp;
+		void** fp = (void**)machine.regs[29];
+#endif
+		// One past the interrupted instruction, so every frame is symbolized like a return address.
+		sample.frames[0] = pc + 1;
+		sample.depth = 1;
+		sample.weight = 1;
+		StackRange stack = getThreadStack(false);
+		if(sp >= stack.low && sp < stack.high) sample.depth = walkFrames(fp, sp, stack.high, sample.frames, 1, ProfileSample::MAX_DEPTH);
+	}
+	atomicStore(&buffer->count, count + 1, ORDER_RELEASE);
+	errno = savedErrno;
+}
+
+bool samplerStart(uint64_t intervalNanoseconds){
+	// Most likely the main thread, which didn't come from threadCreate.
+	getThreadStack();
+	struct sigaction action = {};
+	action.sa_sigaction = samplerHandler;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if(sigaction(SIGPROF, &action, nullptr) != 0) return false;
+	atomicStore(&samplerRunning, true);
+	uint64_t microseconds = max(intervalNanoseconds / 1000, uint64_t(1));
+	itimerval timer = {};
+	timer.it_interval = {(time_t)(microseconds / 1000000), (suseconds_t)(microseconds % 1000000)};
+	timer.it_value = timer.it_interval;
+	if(setitimer(ITIMER_PROF, &timer, nullptr) == 0) return true;
+	atomicStore(&samplerRunning, false);
+	return false;
+}
+
+void samplerStop(){
+	itimerval timer = {};
+	setitimer(ITIMER_PROF, &timer, nullptr);
+	// The handler stays installed, a SIGPROF already on its way would kill the process otherwise.
+	atomicStore(&samplerRunning, false);
+}
+
+static void resetSamples(SampleBuffer* buffers){
+	for(SampleBuffer* buffer = buffers; buffer; buffer = buffer->next){
+		atomicStore(&buffer->count, size_t(0), ORDER_RELEASE);
+	}
+}
+
+void samplerReset(){resetSamples(atomicLoad(&cpuSampleBuffers, ORDER_ACQUIRE));}
+void allocationSamplesReset(){resetSamples(atomicLoad(&allocationSampleBuffers, ORDER_ACQUIRE));}
+
+// Bytes allocated since the last sample, and how many trigger the next one.
+static thread_local size_t allocatedSinceSample = 0;
+static thread_local size_t nextAllocationSample = 0;
+
+void setAllocationSampling(size_t intervalBytes){
+	getThreadStack();
+	atomicStore(&allocationSampleInterval, intervalBytes, ORDER_RELAXED);
+}
+
+void recordAllocationSample(size_t size){
+	size_t interval = atomicLoad(&allocationSampleInterval, ORDER_RELAXED);
+	if(!interval) return;
+	allocatedSinceSample += size;
+	if(allocatedSinceSample < nextAllocationSample) return;
+	// Jitter the gap between samples so allocations that repeat on a fixed stride can't dodge them.
+	nextAllocationSample = interval / 2 + mixHash(readCycles()) % interval;
+	SampleBuffer* buffer = allocationSampleBuffer;
+	if(!buffer) buffer = allocationSampleBuffer = registerSampleBuffer(&allocationSampleBuffers);
+	size_t count = buffer->count;
+	if(count < SampleBuffer::CAPACITY){
+		ProfileSample& sample = buffer->samples[count];
+		sample.weight = allocatedSinceSample;
+		sample.depth = captureBacktrace(sample.frames, ProfileSample::MAX_DEPTH);
+		// Leave this function out, stacks end at the allocator.
+		if(sample.depth){
+			sample.depth--;
+			memmove(sample.frames, sample.frames + 1, sample.depth * sizeof(void*));
+		}
+	}
+	allocatedSinceSample = 0;
+	atomicStore(&buffer->count, count + 1, ORDER_RELEASE);
+}
+
+static bool exportSamples(SampleBuffer* buffers, const char* path){
+	// Addresses are looked up once each, dladdr searches the whole symbol table. Samples from different
+	// places in the same functions fold into one line.
+	Arena names;
+	names.init();
+	auto symbols = HashMap<uintptr_t, StringView>::init();
+	auto stacks = DenseMap<StringView, uint64_t>::init();
+	auto line = ArrayList<char>::init(1024);
+	char name[512];
+	for(SampleBuffer* buffer = buffers; buffer; buffer = buffer->next){
+		size_t count = min(atomicLoad(&buffer->count, ORDER_ACQUIRE), SampleBuffer::CAPACITY);
+		for(size_t s = 0; s < count; s++){
+			ProfileSample& sample = buffer->samples[s];
+			if(!sample.depth) continue;
+			line.clear();
+			for(size_t i = sample.depth; i-- > 0;){
+				uintptr_t address = (uintptr_t)sample.frames[i] - 1;
+				auto record = symbols.getRecord(address);
+				StringView symbol;
+				if(record){
+					symbol = record->value;
+				}else{
+					size_t length = symbolizeAddress((void*)address, name, sizeof(name));
+					// The separators of the format can't appear in a frame name.
+					for(size_t c = 0; c < length; c++) if(name[c] == ';' || name[c] == ' ' || name[c] == '\n') name[c] = '_';
+					char* copy = (char*)names.alloc(nullptr, max(length, size_t(1)), 1);
+					memcpy(copy, name, length);
+					symbol = {length, copy};
+					symbols.insert(address, symbol);
+				}
+				if(i + 1 < sample.depth) line.append(';');
+				appendString(line, symbol.data, symbol.size);
+			}
+			StringView stack = {line.size, line.data};
+			auto entry = stacks.getEntry(stack);
+			if(entry){
+				entry->value += sample.weight;
+			}else{
+				char* copy = (char*)names.alloc(nullptr, line.size, 1);
+				memcpy(copy, line.data, line.size);
+				stacks.insert({line.size, copy}, sample.weight);
+			}
+		}
+	}
+	
+	auto text = ArrayList<char>::init(4096);
+	for(auto& entry: stacks){
+		appendString(text, entry.key.data, entry.key.size);
+		int length = snprintf(name, sizeof(name), " %llu\n", (unsigned long long)entry.value);
+		appendString(text, name, length);
+	}
+	bool success = writeWholeFile(path, text);
+	text.deinit();
+	line.deinit();
+	stacks.deinit();
+	symbols.deinit();
+	names.deinit();
+	return success;
+}
+
+bool samplerExport(const char* path){return exportSamples(atomicLoad(&cpuSampleBuffers, ORDER_ACQUIRE), path);}
+bool allocationSamplesExport(const char* path){return exportSamples(atomicLoad(&allocationSampleBuffers, ORDER_ACQUIRE), path);}
+}
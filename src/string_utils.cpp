@@ -0,0 +1,371 @@
+#include "string.h"
+#include "zsl/core.h"
+#include "zsl/string_utils.h"
+#include "zsl/cpu.h"
+#if defined(__x86_64__) || defined(_M_X64)
+	#define ZSL_X86_64
+	#include "immintrin.h"
+#endif
+
+namespace zsl{
+
+ALWAYS_INLINE static uint64_t readU64(const char* data){uint64_t value; memcpy(&value, data, 8); return value;}
+ALWAYS_INLINE static uint64_t readU32(const char* data){uint32_t value; memcpy(&value, data, 4); return value;}
+ALWAYS_INLINE static uint32_t lowestBit(uint32_t mask){return __builtin_ctz(mask);}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Scalar ------------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+static const char* findByteScalar(const char* data, size_t size, char value){
+	for(size_t i = 0; i < size; i++) if(data[i] == value) return data + i;
+	return nullptr;
+}
+
+static const char* findAnyByteTable(const char* data, size_t size, const char* set, size_t setSize){
+	bool table[256] = {};
+	for(size_t i = 0; i < setSize; i++) table[(uint8_t)set[i]] = true;
+	for(size_t i = 0; i < size; i++) if(table[(uint8_t)data[i]]) return data + i;
+	return nullptr;
+}
+
+static const char* findBytesScalar(const char* data, size_t size, const char* needle, size_t needleSize){
+	if(needleSize == 0) return data;
+	for(size_t i = 0; i + needleSize <= size; i++){
+		if(data[i] == needle[0] && memcmp(data + i, needle, needleSize) == 0) return data + i;
+	}
+	return nullptr;
+}
+
+#ifdef ZSL_X86_64
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------- SSE2 -------------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+// Every x86-64 CPU has SSE2 so these need no check.
+
+// Aligned loads never cross a page, so reading the whole block around the terminator can't fault.
+static size_t stringLengthSse2(const char* string){
+	const char* block = alignFloor(string, 16);
+	__m128i zero = _mm_setzero_si128();
+	uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)block), zero));
+	mask &= UINT32_MAX << (string - block);
+	while(!mask){
+		block += 16;
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)block), zero));
+	}
+	return block + lowestBit(mask) - string;
+}
+
+static bool isMemoryEqualSse2(const void* aPointer, const void* bPointer, size_t size){
+	const char* a = (const char*)aPointer;
+	const char* b = (const char*)bPointer;
+	if(size < 16){
+		// Two overlapping reads cover every size from 8 to 15, and likewise for 4 to 7.
+		if(size >= 8) return ((readU64(a) ^ readU64(b)) | (readU64(a + size - 8) ^ readU64(b + size - 8))) == 0;
+		if(size >= 4) return ((readU32(a) ^ readU32(b)) | (readU32(a + size - 4) ^ readU32(b + size - 4))) == 0;
+		for(size_t i = 0; i < size; i++) if(a[i] != b[i]) return false;
+		return true;
+	}
+	size_t i = 0;
+	for(; i + 16 <= size; i += 16){
+		__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+		if(_mm_movemask_epi8(equal) != 0xFFFF) return false;
+	}
+	if(i == size) return true;
+	__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + size - 16)), _mm_loadu_si128((const __m128i*)(b + size - 16)));
+	return _mm_movemask_epi8(equal) == 0xFFFF;
+}
+
+static const char* findByteSse2(const char* data, size_t size, char value){
+	__m128i needle = _mm_set1_epi8(value);
+	size_t i = 0;
+	for(; i + 16 <= size; i += 16){
+		uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), needle));
+		if(mask) return data + i + lowestBit(mask);
+	}
+	return findByteScalar(data + i, size - i, value);
+}
+
+static const char* findAnyByteSse2(const char* data, size_t size, const char* set, size_t setSize){
+	// One compare per set byte, so past a handful of bytes the lookup table wins.
+	if(setSize > 8) return findAnyByteTable(data, size, set, setSize);
+	if(setSize == 1) return findByteSse2(data, size, set[0]);
+	__m128i needles[8];
+	for(size_t j = 0; j < setSize; j++) needles[j] = _mm_set1_epi8(set[j]);
+	size_t i = 0;
+	for(; i + 16 <= size; i += 16){
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i found = _mm_setzero_si128();
+		for(size_t j = 0; j < setSize; j++) found = _mm_or_si128(found, _mm_cmpeq_epi8(block, needles[j]));
+		uint32_t mask = _mm_movemask_epi8(found);
+		if(mask) return data + i + lowestBit(mask);
+	}
+	return findAnyByteTable(data + i, size - i, set, setSize);
+}
+
+// Compares the first and last byte of the needle at 16 positions at once (Muła) and
+// only checks the rest at positions where both match.
+static const char* findBytesSse2(const char* data, size_t size, const char* needle, size_t needleSize){
+	if(needleSize == 0) return data;
+	if(needleSize == 1) return findByteSse2(data, size, needle[0]);
+	if(needleSize > size) return nullptr;
+	__m128i first = _mm_set1_epi8(needle[0]);
+	__m128i last = _mm_set1_epi8(needle[needleSize - 1]);
+	size_t i = 0;
+	for(; i + needleSize - 1 + 16 <= size; i += 16){
+		__m128i blockFirst = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i blockLast = _mm_loadu_si128((const __m128i*)(data + i + needleSize - 1));
+		uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+		while(mask){
+			size_t position = i + lowestBit(mask);
+			if(isMemoryEqualSse2(data + position + 1, needle + 1, needleSize - 2)) return data + position;
+			mask &= mask - 1;
+		}
+	}
+	return findBytesScalar(data + i, size - i, needle, needleSize);
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------- AVX2 -------------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+ZSL_TARGET("avx2") static size_t stringLengthAvx2(const char* string){
+	const char* block = alignFloor(string, 32);
+	__m256i zero = _mm256_setzero_si256();
+	uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)block), zero));
+	mask &= UINT32_MAX << (string - block);
+	while(!mask){
+		block += 32;
+		if(((size_t)block & 127) == 0) break;
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)block), zero));
+	}
+	if(mask) return block + lowestBit(mask) - string;
+	// Four blocks per iteration. Being 128 byte aligned they all sit in the same page.
+	while(true){
+		__m256i zero0 = _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)block), zero);
+		__m256i zero1 = _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)(block + 32)), zero);
+		__m256i zero2 = _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)(block + 64)), zero);
+		__m256i zero3 = _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)(block + 96)), zero);
+		__m256i any = _mm256_or_si256(_mm256_or_si256(zero0, zero1), _mm256_or_si256(zero2, zero3));
+		if(!_mm256_testz_si256(any, any)){
+			uint64_t low = (uint32_t)_mm256_movemask_epi8(zero0) | (uint64_t)(uint32_t)_mm256_movemask_epi8(zero1) << 32;
+			if(low) return block + __builtin_ctzll(low) - string;
+			uint64_t high = (uint32_t)_mm256_movemask_epi8(zero2) | (uint64_t)(uint32_t)_mm256_movemask_epi8(zero3) << 32;
+			return block + 64 + __builtin_ctzll(high) - string;
+		}
+		block += 128;
+	}
+}
+
+ZSL_TARGET("avx2") static bool isMemoryEqualAvx2(const void* aPointer, const void* bPointer, size_t size){
+	if(size < 32) return isMemoryEqualSse2(aPointer, bPointer, size);
+	const char* a = (const char*)aPointer;
+	const char* b = (const char*)bPointer;
+	size_t i = 0;
+	for(; i + 32 <= size; i += 32){
+		__m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+		if((uint32_t)_mm256_movemask_epi8(equal) != UINT32_MAX) return false;
+	}
+	if(i == size) return true;
+	__m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + size - 32)), _mm256_loadu_si256((const __m256i*)(b + size - 32)));
+	return (uint32_t)_mm256_movemask_epi8(equal) == UINT32_MAX;
+}
+
+ZSL_TARGET("avx2") static const char* findByteAvx2(const char* data, size_t size, char value){
+	__m256i needle = _mm256_set1_epi8(value);
+	size_t i = 0;
+	// Four vectors per iteration with a single test, the tail goes one vector at a time.
+	for(; i + 128 <= size; i += 128){
+		__m256i found0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i)), needle);
+		__m256i found1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i + 32)), needle);
+		__m256i found2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i + 64)), needle);
+		__m256i found3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i + 96)), needle);
+		__m256i any = _mm256_or_si256(_mm256_or_si256(found0, found1), _mm256_or_si256(found2, found3));
+		if(!_mm256_testz_si256(any, any)){
+			uint64_t low = (uint32_t)_mm256_movemask_epi8(found0) | (uint64_t)(uint32_t)_mm256_movemask_epi8(found1) << 32;
+			if(low) return data + i + __builtin_ctzll(low);
+			uint64_t high = (uint32_t)_mm256_movemask_epi8(found2) | (uint64_t)(uint32_t)_mm256_movemask_epi8(found3) << 32;
+			return data + i + 64 + __builtin_ctzll(high);
+		}
+	}
+	for(; i + 32 <= size; i += 32){
+		uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(data + i)), needle));
+		if(mask) return data + i + lowestBit(mask);
+	}
+	return findByteSse2(data + i, size - i, value);
+}
+
+ZSL_TARGET("avx2") static const char* findAnyByteAvx2(const char* data, size_t size, const char* set, size_t setSize){
+	if(setSize > 8) return findAnyByteTable(data, size, set, setSize);
+	if(setSize == 1) return findByteAvx2(data, size, set[0]);
+	__m256i needles[8];
+	for(size_t j = 0; j < setSize; j++) needles[j] = _mm256_set1_epi8(set[j]);
+	size_t i = 0;
+	for(; i + 32 <= size; i += 32){
+		__m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i found = _mm256_setzero_si256();
+		for(size_t j = 0; j < setSize; j++) found = _mm256_or_si256(found, _mm256_cmpeq_epi8(block, needles[j]));
+		uint32_t mask = _mm256_movemask_epi8(found);
+		if(mask) return data + i + lowestBit(mask);
+	}
+	return findAnyByteSse2(data + i, size - i, set, setSize);
+}
+
+ZSL_TARGET("avx2") static const char* findBytesAvx2(const char* data, size_t size, const char* needle, size_t needleSize){
+	if(needleSize == 0) return data;
+	if(needleSize == 1) return findByteAvx2(data, size, needle[0]);
+	if(needleSize > size) return nullptr;
+	__m256i first = _mm256_set1_epi8(needle[0]);
+	__m256i last = _mm256_set1_epi8(needle[needleSize - 1]);
+	size_t i = 0;
+	for(; i + needleSize - 1 + 32 <= size; i += 32){
+		__m256i blockFirst = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i blockLast = _mm256_loadu_si256((const __m256i*)(data + i + needleSize - 1));
+		uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+		while(mask){
+			size_t position = i + lowestBit(mask);
+			if(isMemoryEqualAvx2(data + position + 1, needle + 1, needleSize - 2)) return data + position;
+			mask &= mask - 1;
+		}
+	}
+	return findBytesSse2(data + i, size - i, needle, needleSize);
+}
+
+#endif
+
+// --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------- Dispatch -----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+#ifdef ZSL_X86_64
+static CpuDispatch<size_t(const char*), 2> stringLengthDispatch = {{{CPU_AVX2, stringLengthAvx2}, {0, stringLengthSse2}}};
+static CpuDispatch<bool(const void*, const void*, size_t), 2> isMemoryEqualDispatch = {{{CPU_AVX2, isMemoryEqualAvx2}, {0, isMemoryEqualSse2}}};
+static CpuDispatch<const char*(const char*, size_t, char), 2> findByteDispatch = {{{CPU_AVX2, findByteAvx2}, {0, findByteSse2}}};
+static CpuDispatch<const char*(const char*, size_t, const char*, size_t), 2> findAnyByteDispatch = {{{CPU_AVX2, findAnyByteAvx2}, {0, findAnyByteSse2}}};
+static CpuDispatch<const char*(const char*, size_t, const char*, size_t), 2> findBytesDispatch = {{{CPU_AVX2, findBytesAvx2}, {0, findBytesSse2}}};
+#else
+static bool isMemoryEqualScalar(const void* a, const void* b, size_t size){return memcmp(a, b, size) == 0;}
+static CpuDispatch<size_t(const char*), 1> stringLengthDispatch = {{{0, strlen}}};
+static CpuDispatch<bool(const void*, const void*, size_t), 1> isMemoryEqualDispatch = {{{0, isMemoryEqualScalar}}};
+static CpuDispatch<const char*(const char*, size_t, char), 1> findByteDispatch = {{{0, findByteScalar}}};
+static CpuDispatch<const char*(const char*, size_t, const char*, size_t), 1> findAnyByteDispatch = {{{0, findAnyByteTable}}};
+static CpuDispatch<const char*(const char*, size_t, const char*, size_t), 1> findBytesDispatch = {{{0, findBytesScalar}}};
+#endif
+
+size_t stringLength(const char* string){
+	return stringLengthDispatch(string);
+}
+
+bool isMemoryEqual(const void* a, const void* b, size_t size){
+	return isMemoryEqualDispatch(a, b, size);
+}
+
+const char* findByte(const char* data, size_t size, char value){
+	return findByteDispatch(data, size, value);
+}
+
+const char* findAnyByte(const char* data, size_t size, const char* set, size_t setSize){
+	return findAnyByteDispatch(data, size, set, setSize);
+}
+
+const char* findBytes(const char* data, size_t size, const char* needle, size_t needleSize){
+	return findBytesDispatch(data, size, needle, needleSize);
+}
+
+bool isStringEqual(const char* a, const char* b){
+#ifdef ZSL_X86_64
+	// 16 bytes at a time while neither read can run into the next page, which might not be mapped.
+	constexpr size_t PAGE_MASK = 4095;
+	while(true){
+		if(((size_t)a & PAGE_MASK) <= PAGE_MASK + 1 - 16 && ((size_t)b & PAGE_MASK) <= PAGE_MASK + 1 - 16){
+			__m128i blockA = _mm_loadu_si128((const __m128i*)a);
+			__m128i blockB = _mm_loadu_si128((const __m128i*)b);
+			uint32_t differentOrEnd = ~_mm_movemask_epi8(_mm_cmpeq_epi8(blockA, blockB)) | _mm_movemask_epi8(_mm_cmpeq_epi8(blockA, _mm_setzero_si128()));
+			differentOrEnd &= 0xFFFF;
+			if(differentOrEnd){
+				size_t i = lowestBit(differentOrEnd);
+				return a[i] == b[i];
+			}
+			a += 16;
+			b += 16;
+		}else{
+			for(size_t i = 0; i < 16; i++){
+				if(a[i] != b[i]) return false;
+				if(a[i] == '\0') return true;
+			}
+			a += 16;
+			b += 16;
+		}
+	}
+#else
+	size_t i = 0;
+	while(true){
+		if(a[i] != b[i]) return false;
+		if(a[i] == '\0') return true;
+		i++;
+	}
+#endif
+}
+
+// --------------------------------------------------------------------------------------------------------
+// ------------------------------------------------ Hashing -----------------------------------------------
+// --------------------------------------------------------------------------------------------------------
+
+ALWAYS_INLINE static uint64_t multiplyMix(uint64_t a, uint64_t b){
+#if defined(__SIZEOF_INT128__)
+	__uint128_t product = (__uint128_t)a * b;
+	return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+	uint64_t aHigh = a >> 32, aLow = (uint32_t)a, bHigh = b >> 32, bLow = (uint32_t)b;
+	uint64_t high = aHigh * bHigh, middle0 = aHigh * bLow, middle1 = aLow * bHigh, low = aLow * bLow;
+	uint64_t carry = ((low >> 32) + (uint32_t)middle0 + (uint32_t)middle1) >> 32;
+	return (low + (middle0 << 32) + (middle1 << 32)) ^ (high + (middle0 >> 32) + (middle1 >> 32) + carry);
+#endif
+}
+
+uint64_t hashBytes(const void* pointer, size_t size, uint64_t seed){
+	constexpr uint64_t P0 = UINT64_C(0xa0761d6478bd642f);
+	constexpr uint64_t P1 = UINT64_C(0xe7037ed1a0b428db);
+	constexpr uint64_t P2 = UINT64_C(0x8ebc6af09c88c6e3);
+	constexpr uint64_t P3 = UINT64_C(0x589965cc75374cc3);
+	const char* data = (const char*)pointer;
+	seed ^= multiplyMix(seed ^ P0, P1);
+	uint64_t a, b;
+	if(size <= 16){
+		if(size >= 4){
+			size_t offset = (size >> 3) << 2;
+			a = (readU32(data) << 32) | readU32(data + offset);
+			b = (readU32(data + size - 4) << 32) | readU32(data + size - 4 - offset);
+		}else if(size > 0){
+			a = ((uint64_t)(uint8_t)data[0] << 16) | ((uint64_t)(uint8_t)data[size >> 1] << 8) | (uint8_t)data[size - 1];
+			b = 0;
+		}else{
+			a = b = 0;
+		}
+	}else{
+		size_t left = size;
+		if(left > 48){
+			// Three independent lanes keep the multipliers busy.
+			uint64_t seed1 = seed, seed2 = seed;
+			do{
+				seed = multiplyMix(readU64(data) ^ P1, readU64(data + 8) ^ seed);
+				seed1 = multiplyMix(readU64(data + 16) ^ P2, readU64(data + 24) ^ seed1);
+				seed2 = multiplyMix(readU64(data + 32) ^ P3, readU64(data + 40) ^ seed2);
+				data += 48;
+				left -= 48;
+			}while(left > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while(left > 16){
+			seed = multiplyMix(readU64(data) ^ P1, readU64(data + 8) ^ seed);
+			data += 16;
+			left -= 16;
+		}
+		a = readU64(data + left - 16);
+		b = readU64(data + left - 8);
+	}
+	return multiplyMix(P1 ^ size, multiplyMix(a ^ P1, b ^ seed) ^ P0);
+}
+
+}
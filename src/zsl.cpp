@@ -3,6 +3,16 @@
 	#include "os_windows.cpp"
 #elif defined(ZSL_LINUX)
 	#include "os_linux.cpp"
+	#include "io_linux.cpp"
 #endif
 
 #include "memory.cpp"
+#include "cpu.cpp"
+#include "string_utils.cpp"
+#include "bitset.cpp"
+#include "filter.cpp"
+#include "fiber.cpp"
+#include "parallel.cpp"
+#include "profile.cpp"
+#include "interner.cpp"
+#include "allocation_trace.cpp"
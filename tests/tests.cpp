@@ -2,8 +2,10 @@
 #include <time.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unordered_map>
+#include <errno.h>
+#include <unistd.h>
 #include <algorithm>
+#include <numeric>
 #include "tests.h"
 
 std::vector<void*> allocations;
@@ -30,12 +32,17 @@ void* testAlloc(void* ptr, size_t size, size_t alignment){
 }
 
 template<typename Map>
-bool mapSanityCheck(Map& map){
+bool mapLayoutCheck(Map& map){
 	for(size_t i = 0; i < map.capacity; i++){
 		if(map.data[i].type == Map::RecordType::PLACED) return false;
 	}
 	if(!isPow2(map.capacity)) return false;
-	if(map.getLoadFactor() > Map::MAX_LOAD_FACTOR) return false;
+	return map.getLoadFactor() <= Map::MAX_LOAD_FACTOR;
+}
+
+template<typename Map>
+bool mapSanityCheck(Map& map){
+	if(!mapLayoutCheck(map)) return false;
 	map.deinit();
 	return true;
 }
@@ -67,6 +74,918 @@ TEST("Hash Map Deletion"){
 	return mapSanityCheck(map);
 };
 
+struct Handle{
+	uint32_t index;
+	uint32_t generation;
+	size_t hash() const{return index;}
+	bool compare(const Handle& other) const{return index == other.index && generation == other.generation;}
+};
+
+template<> struct zsl::HashSentinels<Handle>{
+	static Handle empty(){return {0, 0};}
+	static Handle deleted(){return {0, 1};}
+};
+
+TEST("Hash Map Sentinel Keys"){
+	using Map = HashMap<uint64_t, uint64_t, nalloc, defaultHash<uint64_t>, defaultCompare<uint64_t>, MaxSentinels<uint64_t>>;
+	static_assert(Map::SENTINELS && sizeof(Map::Record) == 16);
+	static_assert(!HashMap<uint64_t, uint64_t>::SENTINELS && sizeof(HashMap<uint64_t, uint64_t>::Record) == 24);
+	const size_t count = 200000;
+	auto map = Map::init();
+	DEFER(map.deinit());
+	for(uint64_t i = 0; i < count; i++) map.insert(i * 7, i);
+	for(uint64_t i = 0; i < count; i += 2) map.remove(i * 7);
+	map.clearGravestones();
+	uint64_t sum = 0;
+	for(auto& record: map) sum += record.value;
+	if(map.size != count / 2 || sum != (count / 2) * (count / 2)) return false;
+	for(uint64_t i = 0; i < count; i++) if(map.has(i * 7) != (i % 2 == 1)) return false;
+	for(size_t i = 0; i < map.capacity; i++) if(Map::isDeleted(map.data[i])) return false;
+	
+	// Looking up a sentinel doesn't match the free or deleted slots holding it.
+	auto small = Map::init();
+	DEFER(small.deinit());
+	small[1] = 1;
+	small[2] = 2;
+	small.remove(2);
+	if(small.has(UINT64_MAX) || small.has(UINT64_MAX - 1) || small.getRecord(UINT64_MAX)) return false;
+	small[2] = 3;
+	if(small.size != 2 || small.get(2) != 3) return false;
+	
+	// A specialized trait is picked up without naming it.
+	auto handles = HashMap<Handle, int>::init();
+	DEFER(handles.deinit());
+	static_assert(decltype(handles)::SENTINELS && sizeof(decltype(handles)::Record) == 12);
+	for(uint32_t i = 1; i < 1000; i++) handles[{i, i % 3}] = i;
+	for(uint32_t i = 1; i < 1000; i += 3) handles.remove({i, i % 3});
+	for(uint32_t i = 1; i < 1000; i++){
+		if(handles.has({i, i % 3}) != (i % 3 != 1) || handles.has({i, i % 3 + 1})) return false;
+	}
+	
+	auto pointers = HashMap<int*, int, nalloc, defaultHash<int*>, defaultCompare<int*>, MaxSentinels<int*>>::init();
+	DEFER(pointers.deinit());
+	static int values[100];
+	for(int i = 0; i < 100; i++) pointers[values + i] = i;
+	for(int i = 0; i < 100; i++) if(pointers.get(values + i) != i) return false;
+	if(pointers.has(nullptr) || pointers.size != 100) return false;
+	
+	// Signed keys reserve their largest values, not -1 and -2.
+	using SignedMap = HashMap<int32_t, int, nalloc, defaultHash<int32_t>, defaultCompare<int32_t>, MaxSentinels<int32_t>>;
+	static_assert(MaxSentinels<int32_t>::MAX == INT32_MAX && MaxSentinels<uint16_t>::MAX == UINT16_MAX);
+	auto signedKeys = SignedMap::init();
+	DEFER(signedKeys.deinit());
+	for(int i = -100; i < 100; i++) signedKeys.insert(i, i);
+	for(int i = -100; i < 100; i += 2) signedKeys.remove(i);
+	for(int i = -100; i < 100; i++) if(signedKeys.has(i) != (i % 2 != 0)) return false;
+	return signedKeys.get(-1) == -1 && signedKeys.size == 100;
+};
+
+TEST("Hash Map Parallel Build"){
+	const size_t count = 300000;
+	auto keys = ArrayList<uint64_t>::init(count);
+	auto values = ArrayList<uint64_t>::init(count);
+	DEFER(keys.deinit(); values.deinit());
+	for(size_t i = 0; i < count; i++){
+		// Random keys fill about half the table, so runs crossing region boundaries are common.
+		keys.append(mixHash(i));
+		values.append(i);
+	}
+	// Repeated keys keep their last value.
+	keys[count - 1] = keys[0];
+	auto map = HashMap<uint64_t, uint64_t>::buildFrom(keys, values, 4);
+	DEFER(map.deinit());
+	if(map.size != count - 1 || map.get(keys[0]) != count - 1) return false;
+	for(size_t i = 1; i < count - 1; i++) if(map.get(keys[i]) != i) return false;
+	
+	for(size_t i = 0; i < count; i += 3) map.remove(keys[i]);
+	map.rehashParallel(map.capacity * 2, 4);
+	for(size_t i = 1; i < count - 1; i++) if(map.has(keys[i]) != (i % 3 != 0)) return false;
+	
+	auto sentinel = HashMap<uint64_t, uint64_t, nalloc, defaultHash<uint64_t>, defaultCompare<uint64_t>, MaxSentinels<uint64_t>>::buildFrom(keys, values, 4);
+	DEFER(sentinel.deinit());
+	for(size_t i = 1; i < count - 1; i++) if(sentinel.get(keys[i]) != i) return false;
+	return sentinel.size == count - 1 && mapLayoutCheck(map);
+};
+
+// Recounts what the map keeps counted.
+template<typename Map>
+bool mapStatsCheck(Map& map){
+	HashMapStats stats = map.getStats();
+	size_t tombstones = 0, totalProbe = 0, maxProbe = 0;
+	for(size_t i = 0; i < map.capacity; i++){
+		if(Map::isDeleted(map.data[i])) tombstones++;
+		if(!Map::isOccupied(map.data[i])) continue;
+		size_t probe = BIT_MODULO(i - map.getHash(map.data[i].key), map.capacity);
+		totalProbe += probe;
+		maxProbe = max(maxProbe, probe);
+	}
+	// The largest probe is only an upper bound once records have been removed.
+	return stats.tombstones == tombstones && stats.totalProbe == totalProbe && stats.maxProbe >= maxProbe;
+}
+
+size_t clusteredHash(const uint64_t& key){return key & ~uint64_t(15);}
+
+TEST("Hash Map Maintenance"){
+	const size_t count = 100000;
+	// Without maintenance the tombstones pile up and stay counted.
+	auto manual = HashMap<uint64_t, uint64_t, nalloc, defaultHash<uint64_t>, defaultCompare<uint64_t>, HashSentinels<uint64_t>, NoHashMaintenance>::init();
+	DEFER(manual.deinit());
+	for(uint64_t i = 0; i < count; i++) manual.insert(mixHash(i), i);
+	for(uint64_t i = 0; i < count; i += 2) manual.remove(mixHash(i));
+	for(uint64_t i = count; i < count * 2; i += 4) manual.insert(mixHash(i), i);
+	if(!mapStatsCheck(manual) || manual.tombstones < count / 4) return false;
+	manual.clearGravestones();
+	if(!mapStatsCheck(manual) || manual.tombstones != 0) return false;
+	
+	// Churn at a constant size, the default policy cleans up whenever tombstones pass a fifth of the table.
+	auto churned = HashMap<uint64_t, uint64_t>::init();
+	DEFER(churned.deinit());
+	for(uint64_t i = 0; i < count; i++) churned.insert(mixHash(i), i);
+	size_t capacity = churned.capacity;
+	for(uint64_t i = 0; i < count * 4; i++){
+		churned.remove(mixHash(i));
+		churned.insert(mixHash(i + count), i + count);
+		if(churned.getStats().getTombstoneRatio() > DefaultHashMaintenance::MAX_TOMBSTONE_RATIO + 0.01) return false;
+	}
+	if(!mapStatsCheck(churned) || churned.capacity != capacity || churned.size != count) return false;
+	for(uint64_t i = count * 4; i < count * 5; i++) if(churned.get(mixHash(i)) != i) return false;
+	
+	// Every 16 keys share a home slot, growing spreads the groups apart but can't split them.
+	auto clustered = HashMap<uint64_t, uint64_t, nalloc, clusteredHash>::init();
+	DEFER(clustered.deinit());
+	for(uint64_t i = 0; i < count; i++) clustered.insert(i, i);
+	if(!mapStatsCheck(clustered) || clustered.getLoadFactor() < DefaultHashMaintenance::MIN_GROW_LOAD / 2) return false;
+	size_t histogram[32];
+	clustered.getProbeHistogram({32, histogram});
+	size_t total = 0;
+	for(size_t i = 0; i < 32; i++) total += histogram[i];
+	if(total != count || histogram[0] * 16 != count || histogram[15] * 16 != count) return false;
+	for(uint64_t i = 0; i < count; i++) if(clustered.get(i) != i) return false;
+	return true;
+};
+
+TEST("Array List Bulk Operations"){
+	int values[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+	auto list = ArrayList<int>::init();
+	DEFER(list.deinit());
+	for(int i = 0; i < 10; i++) list.appendRange({RAW_ARRAY_SIZE(values), values});
+	if(list.size != 100 || list[57] != 7) return false;
+	list.insertRange(5, {3, values});
+	if(list.size != 103 || list[4] != 4 || list[5] != 0 || list[7] != 2 || list[8] != 5) return false;
+	list.removeRange(5, 8);
+	for(size_t i = 0; i < list.size; i++) if(list[i] != i % 10) return false;
+	if(list.removeIf([](int value){return value % 2 == 1;}) != 50) return false;
+	for(size_t i = 0; i < list.size; i++) if(list[i] != (i * 2) % 10) return false;
+	ArrayView<int> added = list.extend(3);
+	for(int& value: added) value = -1;
+	if(list.size != 53 || list[52] != -1) return false;
+	list.insert(0, 42);
+	list.remove(1);
+	auto clone = list.copy();
+	DEFER(clone.deinit());
+	if(clone.size != list.size || clone[0] != 42 || clone[1] != 2) return false;
+	
+	auto small = SmallArrayList<int, 8>::init();
+	DEFER(small.deinit());
+	small.appendRange({4, values});
+	small.insertRange(2, {RAW_ARRAY_SIZE(values), values});
+	return !small.isInline() && small.size == 14 && small[2] == 0 && small[12] == 2 && small[13] == 3;
+};
+
+TEST("Small Array List"){
+	auto list = SmallArrayList<int, 4>::init();
+	DEFER(list.deinit());
+	for(int i = 0; i < 4; i++) list.append(i);
+	if(!list.isInline() || list.size != 4) return false;
+	list.insert(0, -1);
+	if(list.isInline()) return false;
+	for(int i = 4; i < 100; i++) list.append(i);
+	for(int i = 0; i < 100; i++) if(list[i + 1] != i) return false;
+	ArrayView<int> view = list.slice(1, 5);
+	if(view.size != 4 || view[3] != 3) return false;
+	list.resize(3);
+	list.remove(0);
+	list.shrink();
+	return list.isInline() && list.size == 2 && list[0] == 0 && list[1] == 1;
+};
+
+TEST("Virtual Array List"){
+	const size_t count = 1000000;
+	auto list = VirtualArrayList<uint64_t>::init(count);
+	DEFER(list.deinit());
+	list.append(0);
+	uint64_t* first = &list[0];
+	for(size_t i = 1; i < count; i++) list.append(i);
+	// Growing must never move elements.
+	if(&list[0] != first || list.size != count) return false;
+	for(size_t i = 0; i < count; i++) if(list[i] != i) return false;
+	list.resize(10);
+	list.shrink();
+	list.append(10);
+	return list.capacity < count && list[10] == 10 && list[9] == 9;
+};
+
+TEST("Sorting"){
+	uint64_t seed = 1;
+	auto random = [&](){seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed;};
+	auto list = ArrayList<int64_t>::init();
+	DEFER(list.deinit());
+	// Random, few distinct, sorted, reversed, all equal and organ pipe inputs.
+	for(int pattern = 0; pattern < 6; pattern++){
+		for(size_t size: {0, 1, 7, 100, 1000, 100000}){
+			list.clear();
+			for(size_t i = 0; i < size; i++){
+				int64_t values[] = {(int64_t)random(), (int64_t)(random() % 4), (int64_t)i, -(int64_t)i, 5, (int64_t)min(i, size - i)};
+				list.append(values[pattern]);
+			}
+			int64_t sum = 0;
+			for(int64_t value: list) sum += value;
+			sort<int64_t>(list);
+			if(!isSorted<int64_t>(list)) return false;
+			for(int64_t value: list) sum -= value;
+			if(sum != 0) return false;
+		}
+	}
+	
+	// Not trivially copyable, takes the branchy partition.
+	struct Boxed{
+		int value;
+		Boxed& operator=(const Boxed& other){value = other.value; return *this;}
+	};
+	Boxed boxed[1000];
+	for(Boxed& box: boxed) box.value = random() % 100;
+	sort<Boxed>({RAW_ARRAY_SIZE(boxed), boxed}, [](const Boxed& a, const Boxed& b){return a.value > b.value;});
+	for(size_t i = 1; i < RAW_ARRAY_SIZE(boxed); i++) if(boxed[i - 1].value < boxed[i].value) return false;
+	
+	list.clear();
+	for(size_t i = 0; i < 200000; i++) list.append((int64_t)random() >> (i % 40));
+	parallelSort<nalloc, int64_t>(list, Less(), 4);
+	if(!isSorted<int64_t>(list)) return false;
+	
+	radixSort<nalloc, int64_t>(list.slice(0, 1000));
+	if(!isSorted<int64_t>(list.slice(0, 1000))) return false;
+	float floats[] = {3.5f, -0.0f, -2.0f, 1e30f, -1e-30f, 0.0f, -1e30f, 2.0f};
+	radixSort<nalloc, float>({RAW_ARRAY_SIZE(floats), floats});
+	if(!isSorted<float>({RAW_ARRAY_SIZE(floats), floats})) return false;
+	
+	// Radix sort by key is stable.
+	struct Record{
+		uint16_t key;
+		uint32_t order;
+	};
+	Record records[5000];
+	for(uint32_t i = 0; i < RAW_ARRAY_SIZE(records); i++) records[i] = {(uint16_t)(random() % 300), i};
+	radixSort<nalloc, Record>({RAW_ARRAY_SIZE(records), records}, [](const Record& record){return record.key;});
+	for(size_t i = 1; i < RAW_ARRAY_SIZE(records); i++){
+		if(records[i - 1].key > records[i].key) return false;
+		if(records[i - 1].key == records[i].key && records[i - 1].order > records[i].order) return false;
+	}
+	return true;
+};
+
+TEST("Searching"){
+	int values[1000];
+	for(int i = 0; i < 1000; i++) values[i] = i / 3 * 2;
+	ArrayView<int> view = {RAW_ARRAY_SIZE(values), values};
+	auto eytzinger = EytzingerArray<int>::init(view);
+	DEFER(eytzinger.deinit());
+	for(int value = -1; value < 700; value++){
+		size_t lower = 0, upper = 0;
+		while(lower < view.size && values[lower] < value) lower++;
+		while(upper < view.size && values[upper] <= value) upper++;
+		if(lowerBound(view, value) != lower || upperBound(view, value) != upper) return false;
+		if(binarySearch(view, value) != (value >= 0 && value % 2 == 0 && value < 667)) return false;
+		int* found = eytzinger.lowerBound(value);
+		if(lower == view.size ? found != nullptr : !found || *found != values[lower]) return false;
+		if(eytzinger.contains(value) != binarySearch(view, value)) return false;
+	}
+	return lowerBound(ArrayView<int>{0, nullptr}, 5) == 0;
+};
+
+TEST("Ordered Map"){
+	// Signed and unsigned orders differ once the top bit is set.
+	int32_t signedKeys[] = {-90000, -5, -1, 0, 3, 8, 40, 41, 1 << 30};
+	uint64_t unsignedKeys[] = {1, 2, 3, UINT64_C(1) << 63, UINT64_MAX - 1};
+	if(countLess(signedKeys, RAW_ARRAY_SIZE(signedKeys), -2) != 2 || countLess(signedKeys, RAW_ARRAY_SIZE(signedKeys), 41) != 7) return false;
+	if(countLess(unsignedKeys, RAW_ARRAY_SIZE(unsignedKeys), UINT64_C(1) << 62) != 3 || countLess(unsignedKeys, RAW_ARRAY_SIZE(unsignedKeys), UINT64_MAX) != 5) return false;
+	
+	uint64_t seed = 1;
+	auto random = [&](){seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return seed;};
+	// Enough keys for three levels, with a plain array as the reference.
+	constexpr size_t KEYS = 20000;
+	static bool present[KEYS];
+	auto map = OrderedMap<uint64_t, uint64_t>::init();
+	DEFER(map.deinit());
+	for(size_t i = 0; i < KEYS; i++){
+		uint64_t key = random() % KEYS;
+		if(!present[key]) map.insert(key, key * 3);
+		present[key] = true;
+	}
+	for(uint64_t key = 0; key < KEYS; key += 2) map[key] = key * 3;
+	size_t expected = 0;
+	for(size_t key = 0; key < KEYS; key++) expected += present[key] = present[key] || key % 2 == 0;
+	if(map.size != expected || map.height < 2) return false;
+	uint64_t previous = 0;
+	size_t visited = 0;
+	for(auto entry: map){
+		if((visited && entry.key <= previous) || !present[entry.key] || entry.value != entry.key * 3) return false;
+		previous = entry.key;
+		visited++;
+	}
+	if(visited != expected) return false;
+	
+	// Remove every key but a few ranges, which leaves mostly empty nodes behind.
+	for(uint64_t key = 0; key < KEYS; key++){
+		bool keep = key % 1000 < 10;
+		if(!keep && map.remove(key) != present[key]) return false;
+		present[key] = present[key] && keep;
+		if(map.has(key) != present[key]) return false;
+	}
+	size_t inRange = 0;
+	for(uint64_t key = 5005; key < 7003; key++) inRange += present[key];
+	for(auto entry: map.range(5005, 7003)){
+		if(entry.key < 5005 || entry.key >= 7003) return false;
+		inRange--;
+	}
+	if(inRange != 0) return false;
+	auto after = map.upperBound(7000);
+	if(after == map.end() || (*after).key <= 7000 || map.lowerBound(KEYS) != map.end()) return false;
+	for(uint64_t key = 0; key < KEYS; key++) map.remove(key);
+	if(map.size != 0 || map.root || map.begin() != map.end() || map.find(3)) return false;
+	
+	// Keys the integer kernels don't cover take the generic search.
+	using DoubleMap = OrderedMap<double, int>;
+	DoubleMap::Record records[3000];
+	for(int i = 0; i < 3000; i++) records[i] = {i * 0.5 - 100, i};
+	auto loaded = DoubleMap::init({RAW_ARRAY_SIZE(records), records});
+	DEFER(loaded.deinit());
+	if(loaded.size != 3000 || loaded.get(-100) != 0 || loaded.get(-99.5) != 1 || loaded.has(-99.75)) return false;
+	loaded[-99.75] = 7;
+	loaded.insert(2000, 8);
+	int count = 0;
+	for(auto entry: loaded.range(-100, -99)) count += entry.value;
+	return count == 8 && (*loaded.lowerBound(-99.8)).value == 7 && (*loaded.upperBound(1399.5)).value == 8;
+};
+
+TEST("Filters"){
+	constexpr size_t KEYS = 20000;
+	static uint64_t present[KEYS];
+	static uint64_t absent[KEYS * 5];
+	static bool results[KEYS * 5];
+	for(size_t i = 0; i < KEYS; i++) present[i] = i * 2;
+	for(size_t i = 0; i < KEYS * 5; i++) absent[i] = i * 2 + 1;
+	
+	auto bloom = BloomFilter<uint64_t>::init(KEYS);
+	DEFER(bloom.deinit());
+	for(uint64_t key: present) bloom.insert(key);
+	// Every key put in has to come back, and with 10 bits per key about 1% of the rest does too.
+	if(bloom.containsBatch({KEYS, present}, results) != KEYS) return false;
+	size_t falsePositives = bloom.containsBatch({KEYS * 5, absent}, results);
+	if(falsePositives > KEYS * 5 / 50) return false;
+	for(size_t i = 0; i < KEYS * 5; i++) if(results[i] != bloom.contains(absent[i])) return false;
+	
+	// Repeated keys are allowed.
+	present[7] = present[8];
+	auto small = XorFilter<uint64_t>::init({KEYS, present});
+	DEFER(small.deinit());
+	auto large = XorFilter<uint64_t, uint16_t>::init({KEYS, present});
+	DEFER(large.deinit());
+	for(uint64_t key: present) if(!small.contains(key) || !large.contains(key)) return false;
+	if(small.containsBatch({KEYS, present}, results) != KEYS || large.containsBatch({KEYS, present}, results) != KEYS) return false;
+	size_t smallPositives = small.containsBatch({KEYS * 5, absent}, results);
+	for(size_t i = 0; i < KEYS * 5; i++) if(results[i] != small.contains(absent[i])) return false;
+	size_t largePositives = large.containsBatch({KEYS * 5, absent}, results);
+	for(size_t i = 0; i < KEYS * 5; i++) if(results[i] != large.contains(absent[i])) return false;
+	return smallPositives > 0 && smallPositives < KEYS * 5 / 100 && largePositives < 10;
+};
+
+static size_t evicted;
+static void countEviction(uint64_t&, uint64_t&){evicted++;}
+
+TEST("Cache"){
+	using IntCache = Cache<uint64_t, uint64_t>;
+	constexpr size_t ENTRIES = 100;
+	auto cache = IntCache::init(ENTRIES * IntCache::ENTRY_BYTES, 1);
+	DEFER(cache.deinit());
+	uint64_t value;
+	for(uint64_t i = 0; i < ENTRIES; i++) cache.put(i, i * 2);
+	for(uint64_t i = 0; i < ENTRIES / 2; i++) if(!cache.get(i, value) || value != i * 2) return false;
+	// The referenced half has to outlive the other half.
+	for(uint64_t i = ENTRIES; i < ENTRIES * 3 / 2; i++) cache.put(i, i * 2);
+	for(uint64_t i = 0; i < ENTRIES * 3 / 2; i++) if(cache.get(i, value) != (i < ENTRIES / 2 || i >= ENTRIES)) return false;
+	auto stats = cache.getStats();
+	if(stats.entries != ENTRIES || stats.evictions != ENTRIES / 2 || stats.bytes != ENTRIES * IntCache::ENTRY_BYTES) return false;
+	
+	// Replacing with a larger charge evicts others to make room, too large is refused.
+	auto sized = IntCache::init(ENTRIES * IntCache::ENTRY_BYTES, 1);
+	DEFER(sized.deinit());
+	for(uint64_t i = 0; i < ENTRIES; i++) sized.put(i, i);
+	if(!sized.put(0, 1, IntCache::ENTRY_BYTES * 9) || !sized.get(0, value) || value != 1) return false;
+	if(sized.getStats().entries != ENTRIES - 9 || sized.put(1000, 0, ENTRIES * IntCache::ENTRY_BYTES)) return false;
+	if(!sized.remove(0) || sized.remove(0) || sized.get(0, value)) return false;
+	
+	// Every value leaves through onEvict exactly once, replaced ones included, and a replace that
+	// needs room never evicts the entry it wrote.
+	evicted = 0;
+	using CountingCache = Cache<uint64_t, uint64_t, ZSL_DEFAULT_ALLOCATOR, defaultHash<uint64_t>, defaultCompare<uint64_t>, countEviction>;
+	auto counting = CountingCache::init(ENTRIES * CountingCache::ENTRY_BYTES, 1);
+	for(uint64_t i = 0; i < ENTRIES; i++) counting.put(i, i);
+	for(uint64_t i = 0; i < 10; i++) counting.put(i, i + 1);
+	if(evicted != 10) return false;
+	for(uint64_t i = 0; i < ENTRIES; i++) counting.get(i, value);
+	if(!counting.put(5, 7, CountingCache::ENTRY_BYTES * 20) || !counting.get(5, value) || value != 7) return false;
+	if(evicted != 11 + 20 || counting.getStats().entries != ENTRIES - 20) return false;
+	counting.deinit();
+	if(evicted != ENTRIES + 11) return false;
+	
+	static uint64_t keys[1000];
+	for(uint64_t i = 0; i < 1000; i++) keys[i] = i + 5000;
+	auto batched = IntCache::init(1000 * IntCache::ENTRY_BYTES, 8);
+	DEFER(batched.deinit());
+	if(batched.putBatch({1000, keys}, {1000, keys}) != 1000) return false;
+	size_t found = 0;
+	for(uint64_t key: keys) found += batched.get(key, value) && value == key;
+	// Shards get an even share of the budget, so the fullest ones evict a little.
+	if(found < 800 || found != batched.getStats().entries) return false;
+	
+	auto shared = IntCache::init(4096 * IntCache::ENTRY_BYTES);
+	DEFER(shared.deinit());
+	size_t wrong = 0;
+	CONCURRENT{
+		uint64_t value;
+		for(uint64_t i = 0; i < 1000; i++){
+			if(!shared.get(i, value)) shared.put(i, i + 1);
+			else if(value != i + 1) atomicAdd(&wrong, size_t(1));
+		}
+	};
+	stats = shared.getStats();
+	return wrong == 0 && stats.hits + stats.misses == threadCount * 1000 && stats.entries == 1000;
+};
+
+TEST("Aligned Allocations"){
+	// Pooled blocks are only 8 byte aligned, so over aligned data sits at different offsets inside them.
+	// Fill every block to its end and check that none of them ran into another.
+	const size_t alignments[] = {16, 32, 64, 128, 4096};
+	char* blocks[64];
+	for(size_t alignment: alignments){
+		for(size_t size = 8; size <= 8192; size = size * 3 + 8){
+			for(size_t i = 0; i < 64; i++){
+				blocks[i] = (char*)nalloc(nullptr, size, alignment);
+				if((uintptr_t)blocks[i] % alignment) return false;
+				memset(blocks[i], (int)i, size);
+			}
+			for(size_t i = 0; i < 64; i++){
+				for(size_t j = 0; j < size; j++) if(blocks[i][j] != (char)i) return false;
+				// Frees push the block back through the pointer stored before the data.
+				nalloc(blocks[i], 0, 0);
+			}
+		}
+	}
+	// Once freed the blocks are reused by other alignments, which must not overlap either.
+	for(size_t i = 0; i < 64; i++){
+		blocks[i] = (char*)nalloc(nullptr, 200, i % 2 ? 8 : 64);
+		memset(blocks[i], (int)i, 200);
+	}
+	for(size_t i = 0; i < 64; i++){
+		for(size_t j = 0; j < 200; j++) if(blocks[i][j] != (char)i) return false;
+		nalloc(blocks[i], 0, 0);
+	}
+	return true;
+};
+
+TEST("Large Allocations"){
+	// Grows past the direct mapping size from the pools, then keeps growing and shrinks back into them.
+	size_t size = NALLOC_DIRECT_SIZE / 4;
+	uint32_t* data = alloc<nalloc, uint32_t>(size / 4);
+	for(size_t i = 0; i < size / 4; i++) data[i] = (uint32_t)i;
+	for(size_t grown = 0; grown < 5; grown++){
+		size *= 4;
+		data = realloc<nalloc>(size / 4, data);
+		for(size_t i = size / 16; i < size / 4; i++) data[i] = (uint32_t)i;
+	}
+	for(size_t i = 0; i < size / 4; i++) if(data[i] != i) return false;
+	data = realloc<nalloc>(1000, data);
+	for(size_t i = 0; i < 1000; i++) if(data[i] != i) return false;
+	dealloc<nalloc>(data);
+	
+	// Page aligned, and aligned further than a page which can't be mapped.
+	for(size_t alignment: {size_t(8), size_t(4096), size_t(1) << 16}){
+		char* block = (char*)nalloc(nullptr, NALLOC_DIRECT_SIZE * 3, alignment);
+		if((size_t)block % alignment != 0) return false;
+		block[0] = 1;
+		block[NALLOC_DIRECT_SIZE * 3 - 1] = 2;
+		block = (char*)nalloc(block, NALLOC_DIRECT_SIZE * 5, 0);
+		if((size_t)block % alignment != 0 || block[0] != 1 || block[NALLOC_DIRECT_SIZE * 3 - 1] != 2) return false;
+		nalloc(block, 0, 0);
+	}
+	
+	// More than the address space fails without touching the block being resized.
+	const size_t huge = size_t(1) << 62;
+	if(nalloc(nullptr, huge, 8)) return false;
+	char* block = (char*)nalloc(nullptr, NALLOC_DIRECT_SIZE, 8);
+	block[NALLOC_DIRECT_SIZE - 1] = 3;
+	if(nalloc(block, huge, 0) || block[NALLOC_DIRECT_SIZE - 1] != 3) return false;
+	nalloc(block, 0, 0);
+	return true;
+};
+
+struct SquareEntries{
+	StaticMapEntry<uint64_t, uint32_t> entries[500];
+};
+
+static constexpr SquareEntries makeSquareEntries(){
+	SquareEntries squares = {};
+	for(uint32_t i = 0; i < 500; i++) squares.entries[i] = {uint64_t(i) * i * 7 + 1, i};
+	return squares;
+}
+
+static constexpr SquareEntries SQUARE_ENTRIES = makeSquareEntries();
+
+TEST("Static Maps"){
+	static constexpr auto keywords = makeStaticMap<StringView, int>({
+		{"if", 1}, {"else", 2}, {"while", 3}, {"for", 4}, {"return", 5}, {"", 6}, {"static_assert", 7}, {"thread_local", 8},
+	});
+	static constexpr auto squares = makeStaticMap(SQUARE_ENTRIES.entries);
+	if(keywords.get(StringView::init("while")) != 3 || keywords.get(StringView::init("")) != 6) return false;
+	if(keywords.get(StringView::init("thread_local")) != 8 || keywords.get(StringView::init("static_assert")) != 7) return false;
+	if(keywords.has(StringView::init("whilst")) || keywords.has(StringView::init("thread_locale")) || keywords.get(StringView::init("If"), -1) != -1) return false;
+	size_t found = 0;
+	for(uint64_t key = 0; key < 500 * 500 * 7 + 1; key++){
+		auto record = squares.getRecord(key);
+		if(!record) continue;
+		if(key != uint64_t(record->value) * record->value * 7 + 1) return false;
+		found++;
+	}
+	// Iteration skips the free slots, which hold copies of the first entry.
+	size_t count = 0, sum = 0;
+	for(auto& record: squares){
+		count++;
+		sum += record.value;
+	}
+	return found == 500 && count == 500 && sum == 499 * 500 / 2;
+};
+
+// Random upserts and removes against a HashMap, clustered so removes shift long runs that wrap around the table.
+TEST("Dense Map"){
+	auto map = DenseMap<uint64_t, uint64_t, nalloc, clusteredHash>::init();
+	DEFER(map.deinit());
+	auto reference = HashMap<uint64_t, uint64_t>::init();
+	DEFER(reference.deinit());
+	uint64_t state = 1;
+	for(size_t i = 0; i < 200000; i++){
+		state = mixHash(state);
+		uint64_t key = state % 4096 - 2048;
+		if(state >> 62 == 0 && reference.has(key)){
+			map.remove(key);
+			reference.remove(key);
+		}else{
+			map[key] += i;
+			reference[key] += i;
+		}
+	}
+	if(map.getSize() != reference.size) return false;
+	size_t count = 0;
+	for(auto& entry: map){
+		if(reference.get(entry.key) != entry.value || map.get(entry.key) != entry.value) return false;
+		count++;
+	}
+	if(count != reference.size) return false;
+	for(uint64_t key = -4096; key != 4096; key++) if(map.has(key) != reference.has(key)) return false;
+	
+	// Insertion order until the first remove, then the last entry takes the removed one's place.
+	auto ordered = DenseMap<int, int>::init();
+	DEFER(ordered.deinit());
+	for(int i = 0; i < 100; i++) ordered.insert(i * 31, i);
+	int expected = 0;
+	for(int value: ordered.iterateValues()) if(value != expected++) return false;
+	ordered.remove(0);
+	if(ordered.entries[0].key != 99 * 31 || ordered.get(99 * 31) != 99 || ordered.has(0)) return false;
+	if(ordered.removeIf([](int key, int value){return value % 2 == 0;}) != 49 || ordered.getSize() != 50) return false;
+	// The odd values in order, except that 99 moved to the front.
+	expected = 99;
+	for(int key: ordered.iterateKeys()){
+		if(key != expected * 31 || ordered.get(key) != expected) return false;
+		expected = expected == 99 ? 1 : expected + 2;
+	}
+	ordered.clear();
+	return ordered.getSize() == 0 && !ordered.has(31) && ordered.begin() == ordered.end();
+};
+
+TEST("Interner"){
+	Interner interner;
+	interner.init();
+	DEFER(interner.deinit());
+	char buffer[32];
+	InternId first = interner.intern(StringView::init("requests.count"));
+	if(interner.intern(StringView::init("requests.count")) != first || interner.find(StringView::init("requests.size")) != Interner::NONE) return false;
+	// The empty string is a string like any other.
+	InternId empty = interner.intern(StringView::init(""));
+	if(empty == first || interner.get(empty).size != 0 || interner.getPointer(empty)[0] != 0) return false;
+	const char* pointer = interner.getPointer(first);
+	
+	InternId ids[1000];
+	StringView names[1000];
+	for(size_t i = 0; i < 1000; i++){
+		snprintf(buffer, sizeof(buffer), "metric.%zu", i % 500);
+		ids[i] = interner.intern(StringView::init(buffer));
+	}
+	for(size_t i = 0; i < 500; i++){
+		snprintf(buffer, sizeof(buffer), "metric.%zu", i);
+		// Interned copies are null terminated, and equal ids mean equal strings.
+		if(ids[i] != ids[i + 500] || !isStringEqual(interner.getPointer(ids[i]), buffer)) return false;
+		if(interner.find(StringView::init(buffer)) != ids[i]) return false;
+		names[i] = interner.get(ids[i]);
+	}
+	InternId batch[500];
+	interner.intern({500, names}, batch);
+	for(size_t i = 0; i < 500; i++) if(batch[i] != ids[i]) return false;
+	if(interner.getPointer(first) != pointer || interner.getCount() != 502) return false;
+	
+	// Threads race to intern overlapping names and resolve each other's ids without the lock.
+	Interner shared;
+	shared.init();
+	DEFER(shared.deinit());
+	InternId* sharedIds = alloc<nalloc, InternId>(threadCount * 200);
+	DEFER(dealloc<nalloc>(sharedIds));
+	size_t next = 0, wrong = 0;
+	CONCURRENT{
+		size_t thread = atomicAdd(&next, size_t(1));
+		char buffer[32];
+		for(size_t i = 0; i < 200; i++){
+			snprintf(buffer, sizeof(buffer), "tag.%zu", (thread * 7 + i) % 300);
+			InternId id = shared.intern(StringView::init(buffer));
+			sharedIds[thread * 200 + i] = id;
+			if(!isStringEqual(shared.getPointer(id), buffer)) atomicAdd(&wrong, size_t(1));
+		}
+	};
+	for(size_t i = 0; i < threadCount * 200; i++){
+		snprintf(buffer, sizeof(buffer), "tag.%zu", (i / 200 * 7 + i % 200) % 300);
+		if(shared.find(StringView::init(buffer)) != sharedIds[i]) return false;
+	}
+	return wrong == 0 && shared.getCount() == 300;
+};
+
+TEST("Parallel Algorithms"){
+	// Enough workers to run chunks side by side even on one processor.
+	setParallelThreadCount(4);
+	DEFER(setParallelThreadCount(0));
+	if(getParallelThreadCount() != 4) return false;
+	constexpr size_t count = 100003;
+	std::vector<int64_t> values(count), results(count);
+	for(size_t i = 0; i < count; i++) values[i] = int64_t(mixHash(i) % 1000) - 500;
+	ArrayView<int64_t> view = {count, values.data()};
+	
+	// Every grain from one element per chunk to a single chunk gives the serial answer.
+	for(size_t grain: {size_t(0), size_t(1), size_t(97), size_t(4096), count}){
+		std::vector<int64_t> expected(count);
+		parallelTransform(view, results.data(), [](int64_t value){return value * 3;}, grain);
+		for(size_t i = 0; i < count; i++) if(results[i] != values[i] * 3) return false;
+		
+		int64_t sum = 0;
+		for(size_t i = 0; i < count; i++) sum += values[i];
+		if(parallelReduce(view, int64_t(0), Add(), grain) != sum) return false;
+		auto maximum = [](int64_t a, int64_t b){return max(a, b);};
+		if(parallelReduce(view, INT64_MIN, maximum, grain) != *std::max_element(values.begin(), values.end())) return false;
+		
+		std::partial_sum(values.begin(), values.end(), expected.begin());
+		parallelInclusiveScan(view, results.data(), Add(), grain);
+		if(results != expected) return false;
+		for(size_t i = 0; i < count; i++) expected[i] -= values[i] - 10;
+		parallelExclusiveScan(view, results.data(), int64_t(10), Add(), grain);
+		if(results != expected) return false;
+		
+		size_t kept = parallelFilter(view, results.data(), [](int64_t value){return value % 3 == 0;}, grain);
+		auto last = std::copy_if(values.begin(), values.end(), expected.begin(), [](int64_t value){return value % 3 == 0;});
+		if(kept != size_t(last - expected.begin()) || !std::equal(expected.begin(), last, results.begin())) return false;
+	}
+	// In place.
+	std::vector<int64_t> copy = values;
+	parallelInclusiveScan(ArrayView<int64_t>{count, copy.data()}, copy.data(), Add(), 1000);
+	if(copy[count - 1] != parallelReduce(view, int64_t(0))) return false;
+	std::vector<int64_t> empty;
+	parallelInclusiveScan(ArrayView<int64_t>{0, empty.data()}, empty.data());
+	if(parallelReduce(ArrayView<int64_t>{0, empty.data()}, int64_t(7)) != 7) return false;
+	
+	// Each index runs exactly once, nested loops run inline, and scratch is freed when a thread's share ends.
+	std::vector<uint8_t> seen(count, 0);
+	char* mark = getScratchArena()->mark;
+	size_t scratchErrors = 0;
+	parallelForRange(count, [&](size_t begin, size_t end){
+		int64_t* scratch = alloc<salloc, int64_t>(end - begin);
+		parallelFor(end - begin, [&](size_t i){scratch[i] = int64_t(begin + i);});
+		for(size_t i = begin; i < end; i++){
+			if(scratch[i - begin] != int64_t(i)) atomicAdd(&scratchErrors, size_t(1));
+			seen[i]++;
+		}
+	}, 1000);
+	if(getScratchArena()->mark != mark || scratchErrors) return false;
+	for(uint8_t times: seen) if(times != 1) return false;
+	size_t visited = 0;
+	parallelForEach(view, [&](int64_t&){atomicAdd(&visited, size_t(1));}, 10);
+	if(visited != count) return false;
+	
+	// Loops started while the pool is busy run on their own thread.
+	size_t wrong = 0;
+	CONCURRENT{
+		if(parallelReduce(view, int64_t(0), Add(), 5000) != copy[count - 1]) atomicAdd(&wrong, size_t(1));
+	};
+	return wrong == 0;
+};
+
+TEST("Allocation Trace"){
+	const char* path = "zsl_allocation_trace_test.bin";
+	DEFER(unlink(path));
+	// Allocated before the trace starts, so its free refers to a block the trace never saw.
+	void* early = tracedAlloc<nalloc>(nullptr, 100, 8);
+	if(!allocationTraceStart(path) || allocationTraceStart(path)) return false;
+	tracedAlloc<nalloc>(early, 0, 0);
+	size_t misaligned = 0;
+	CONCURRENT{
+		void* blocks[20];
+		for(size_t i = 0; i < 20; i++){
+			// Byte aligned blocks are recorded as asked for, not with the header's alignment.
+			size_t alignment = i % 4 == 0 ? 64 : i % 4 == 1 ? 1 : 8;
+			blocks[i] = tracedAlloc<nalloc>(nullptr, 16 + i * 100, alignment);
+			if((uintptr_t)blocks[i] % alignment) atomicAdd(&misaligned, size_t(1));
+			memset(blocks[i], (int)i, 16 + i * 100);
+		}
+		for(size_t i = 0; i < 20; i += 2){
+			blocks[i] = tracedAlloc<nalloc>(blocks[i], 5000 + i, 0);
+			if(((uint8_t*)blocks[i])[15 + i * 100] != i) atomicAdd(&misaligned, size_t(1));
+		}
+		for(void* block: blocks) tracedAlloc<nalloc>(block, 0, 0);
+	};
+	allocationTraceStop();
+	// Not recorded.
+	tracedAlloc<nalloc>(tracedAlloc<nalloc>(nullptr, 10, 8), 0, 0);
+	if(misaligned) return false;
+	
+	auto events = ArrayList<AllocationEvent>::init();
+	DEFER(events.deinit());
+	if(!loadAllocationTrace(path, events) || events.size != 1 + ::threadCount * 50) return false;
+	// Every block goes allocation, maybe a resize, free, in time order, each on the thread that made it.
+	auto states = HashMap<uint64_t, AllocationEvent>::init();
+	DEFER(states.deinit());
+	const uint8_t SHIFTS[] = {6, 0, 3, 3};
+	uint32_t threadsSeen = 0;
+	for(size_t i = 0; i < events.size; i++){
+		AllocationEvent& event = events[i];
+		if(i && event.time < events[i - 1].time) return false;
+		threadsSeen = max(threadsSeen, event.thread + 1);
+		auto record = states.getRecord(event.block);
+		if(event.op == ALLOCATION_ALLOC){
+			if(record || (event.size - 16) % 100 || event.alignmentShift != SHIFTS[(event.size - 16) / 100 % 4]) return false;
+			states.insert(event.block, event);
+			continue;
+		}
+		if(!record){
+			// The block allocated before the trace.
+			if(event.op != ALLOCATION_FREE || event.thread != 0) return false;
+			continue;
+		}
+		if(record->value.op == ALLOCATION_FREE || record->value.thread != event.thread) return false;
+		if(event.op == ALLOCATION_RESIZE && (record->value.op != ALLOCATION_ALLOC || event.size < 5000)) return false;
+		if(event.op == ALLOCATION_FREE && event.size) return false;
+		record->value = event;
+	}
+	for(auto& record: states) if(record.value.op != ALLOCATION_FREE) return false;
+	if(states.size != ::threadCount * 20 || threadsSeen != ::threadCount + 1) return false;
+	
+	// Not a trace.
+	File file = fileOpen(path, FILE_WRITE | FILE_TRUNCATE);
+	fileWrite(file, "ZSLTRACX", 8, 0);
+	fileClose(file);
+	return !loadAllocationTrace(path, events) && events.size == 0;
+};
+
+TEST("CPU Dispatch"){
+	const CpuInfo& info = getCpuInfo();
+	if(info.cacheLineSize == 0 || !info.vendor[0]) return false;
+#if defined(__x86_64__)
+	if(!hasCpuFeatures(CPU_SSE2)) return false;
+#endif
+	// Features that need OS support can't show up without the ones they build on.
+	if(hasCpuFeatures(CPU_AVX2) && !hasCpuFeatures(CPU_AVX)) return false;
+	if(hasCpuFeatures(CPU_AVX512BW) && !hasCpuFeatures(CPU_AVX512F)) return false;
+	if(!isStringEqual(getCpuFeatureName(CPU_SSE41), "sse4.1")) return false;
+	
+	static CpuDispatch<int(int), 3> dispatch = {{
+		{CPU_AVX512F | CPU_AVX512BW, [](int x){return x * 3;}},
+		{CPU_AVX2, [](int x){return x * 2;}},
+		{0, [](int x){return x;}},
+	}};
+	int expected = hasCpuFeatures(CPU_AVX512F | CPU_AVX512BW) ? 30 : hasCpuFeatures(CPU_AVX2) ? 20 : 10;
+	return dispatch(10) == expected && dispatch.get()(10) == expected;
+};
+
+TEST("Strings"){
+	// Every offset and length around the vector widths, against the obvious loops.
+	char text[200];
+	for(size_t i = 0; i < sizeof(text); i++) text[i] = 'a' + i % 7;
+	text[150] = 'x';
+	text[151] = 'y';
+	for(size_t offset = 0; offset < 40; offset++){
+		for(size_t size = 0; offset + size < sizeof(text); size++){
+			const char* data = text + offset;
+			const char* naive = nullptr;
+			for(size_t i = 0; i < size && !naive; i++) if(data[i] == 'x' || data[i] == 'g' || data[i] == ';') naive = data + i;
+			if(findAnyByte(data, size, "x;g", 3) != naive) return false;
+			naive = nullptr;
+			for(size_t i = 0; i + 3 <= size && !naive; i++) if(memcmp(data + i, "fxy", 3) == 0) naive = data + i;
+			if(findBytes(data, size, "fxy", 3) != naive) return false;
+			if(findByte(data, size, 'y') != (offset + size > 151 && offset <= 151 ? text + 151 : nullptr)) return false;
+			if(!isMemoryEqual(data, text + offset, size)) return false;
+			if(size && offset + size + 1 < sizeof(text) && isMemoryEqual(data, data + 1, size)) return false;
+		}
+		char copy[64];
+		memcpy(copy, text + offset, 63);
+		copy[63] = '\0';
+		if(stringLength(copy + offset % 32) != 63 - offset % 32) return false;
+		if(!isStringEqual(copy, copy) || isStringEqual(copy, copy + 7)) return false;
+	}
+	char longText[1024];
+	memset(longText, 'a', sizeof(longText));
+	for(size_t end = 0; end < sizeof(longText); end += 37){
+		longText[end] = '\0';
+		if(stringLength(longText + end % 5) != end - end % 5) return false;
+		longText[end] = 'a';
+	}
+	const char* names[] = {"alpha", "beta"};
+	if(hasString(names, "bet") || !hasString(names, "beta") || !isStringEqual("", "")) return false;
+	
+	StringView line = StringView::init("key=value;;last");
+	if(!line.startsWith(StringView::init("key=")) || !line.endsWith(StringView::init("last")) || line.find(StringView::init("val")) != 4) return false;
+	StringView token;
+	const char* expected[] = {"key", "value", "", "last"};
+	size_t count = 0;
+	while(line.split(StringView::init("=;"), token)){
+		if(count >= 4 || !token.compare(StringView::init(expected[count++]))) return false;
+	}
+	if(count != 4) return false;
+	
+	auto map = HashMap<StringView, int>::init();
+	DEFER(map.deinit());
+	char buffer[] = "one two three";
+	map.insert(StringView::init(buffer, 3), 1);
+	map.insert(StringView::init(buffer + 4, 3), 2);
+	return map[StringView::init("two")] == 2 && StringView::init("one").hash() == StringView::init(buffer, 3).hash();
+};
+
+TEST("Bit Sets"){
+	if(popCount(UINT64_C(0xF0F0)) != 8 || countTrailingZeros(uint32_t(0)) != 32 || countTrailingZeros(UINT64_C(1) << 40) != 40) return false;
+	if(countLeadingZeros(uint32_t(1)) != 31 || countLeadingZeros(uint64_t(0)) != 64 || selectBit(0b101100, 2) != 5) return false;
+	
+	auto fixed = BitSet<200>::init();
+	for(size_t i = 0; i < 200; i += 3) fixed.set(i);
+	if(fixed.count() != 67 || fixed.findNext(1) != 3 || fixed.findNextUnset(0) != 1 || fixed.count(10, 130) != 40) return false;
+	size_t expected = 0;
+	for(size_t i: fixed.iterateSet()){
+		if(i != expected) return false;
+		expected += 3;
+	}
+	if(expected != 201) return false;
+	fixed.setAll();
+	if(fixed.count() != 200 || fixed.findNextUnset() != BitSet<200>::NOT_FOUND) return false;
+	
+	// Large enough for the vector kernels and several rank blocks.
+	auto a = DynamicBitSet<>::init(5000);
+	DEFER(a.deinit());
+	auto b = DynamicBitSet<>::init(5000);
+	DEFER(b.deinit());
+	for(size_t i = 0; i < 5000; i += 2) a.set(i);
+	for(size_t i = 0; i < 5000; i += 5) b.set(i);
+	auto both = a.copy();
+	DEFER(both.deinit());
+	both.andWith(b);
+	auto either = a.copy();
+	DEFER(either.deinit());
+	either.orWith(b);
+	auto difference = a.copy();
+	DEFER(difference.deinit());
+	difference.andNotWith(b);
+	auto different = a.copy();
+	DEFER(different.deinit());
+	different.xorWith(b);
+	if(both.count() != 500 || either.count() != 3000 || difference.count() != 2000 || different.count() != 2500) return false;
+	
+	auto index = RankSelectIndex<>::init(either);
+	DEFER(index.deinit());
+	for(size_t i = 0; i <= 5000; i += 7){
+		if(index.rank(i) != either.rank(i)) return false;
+	}
+	for(size_t k = 0; k < 3000; k += 11){
+		size_t position = index.select(k);
+		if(position != either.select(k) || !either.get(position) || index.rank(position) != k) return false;
+	}
+	if(index.select(3000) != RankSelectIndex<>::NOT_FOUND) return false;
+	
+	a.resize(70);
+	a.resize(200);
+	if(a.count() != 35 || a.findNext(70) != DynamicBitSet<>::NOT_FOUND) return false;
+	for(int i = 0; i < 100; i++) a.append(true);
+	return a.bitCount == 300 && a.count() == 135 && a.findNext(70) == 200;
+};
+
 TEST("Synchronization"){
 	Mutex mutex; mutex.init();
 	auto map = HashMap<int, int>::init();
@@ -92,18 +1011,211 @@ TEST("Synchronization"){
 	return true;
 };
 
-timespec diff(timespec start, timespec end){
-	timespec temp;
-	if ((end.tv_nsec-start.tv_nsec)<0) {
-		temp.tv_sec = end.tv_sec-start.tv_sec-1;
-		temp.tv_nsec = 1000000000+end.tv_nsec-start.tv_nsec;
-	} else {
-		temp.tv_sec = end.tv_sec-start.tv_sec;
-		temp.tv_nsec = end.tv_nsec-start.tv_nsec;
+TEST("Fibers"){
+	const size_t count = 20000;
+	static size_t counter;
+	static FiberScheduler scheduler;
+	counter = 0;
+	scheduler.init(4, count);
+	for(size_t i = 0; i < count; i++) scheduler.spawn([](void*){
+		for(int j = 0; j < 3; j++) fiberYield();
+		atomicAdd(&counter, size_t(1));
+	}, nullptr);
+	scheduler.wait();
+	if(counter != count) return false;
+	
+	// Fibers waiting on fibers they spawned.
+	counter = 0;
+	scheduler.spawn([](void*){
+		FiberGroup group; group.init();
+		for(int i = 0; i < 100; i++){
+			group.add();
+			scheduler.spawn([](void* g){
+				atomicAdd(&counter, size_t(1));
+				((FiberGroup*)g)->done();
+			}, &group);
+		}
+		group.wait();
+		if(atomicLoad(&counter) == 100) atomicAdd(&counter, size_t(1));
+	}, nullptr);
+	scheduler.wait();
+	scheduler.deinit();
+	return counter == 101;
+};
+
+TEST("Async File IO"){
+	const char* path = "zsl_io_test.bin";
+	const size_t blockSize = 4096;
+	const size_t blocks = 64;
+	File file = fileOpen(path, FILE_READ | FILE_WRITE | FILE_CREATE | FILE_TRUNCATE);
+	if(!file.isValid()) return false;
+	DEFER(fileClose(file); unlink(path));
+	
+	static GlobalVar<Arena> arena;
+	char* buffer = (char*)arena.var.alloc(nullptr, blockSize * blocks, 4096);
+	for(size_t i = 0; i < blockSize * blocks; i++) buffer[i] = (char)(i / blockSize);
+	
+	IoQueue queue; queue.init(16);
+	DEFER(queue.deinit());
+	ArrayView<char> registered = {blockSize * blocks, buffer};
+	if(!queue.registerBuffers({1, &registered})) return false;
+	
+	// More requests than ring entries to exercise the full ring path.
+	for(size_t i = 0; i < blocks; i++) queue.writeFixed(file, 0, buffer + i * blockSize, blockSize, i * blockSize, (void*)i);
+	IoCompletion completions[blocks];
+	size_t done = 0;
+	while(done < blocks) done += queue.wait({blocks - done, completions + done}, blocks - done);
+	for(IoCompletion& completion: completions) if(completion.result != blockSize) return false;
+	queue.sync(file, nullptr);
+	if(queue.wait({1, completions}) != 1 || completions[0].result != 0) return false;
+	if(fileSize(file) != blockSize * blocks) return false;
+	
+	memset(buffer, 0xFF, blockSize * blocks);
+	for(size_t i = 0; i < blocks; i++) queue.read(file, buffer + i * blockSize, blockSize, i * blockSize, buffer + i * blockSize);
+	done = 0;
+	while(done < blocks) done += queue.wait({blocks - done, completions + done}, blocks - done);
+	for(size_t i = 0; i < blockSize * blocks; i++) if(buffer[i] != (char)(i / blockSize)) return false;
+	
+	// Too long for an entry, refused instead of cut short.
+	queue.read(file, buffer, size_t(UINT32_MAX) + 1, 0, (void*)7);
+	return queue.wait({1, completions}) == 1 && completions[0].userData == (void*)7 && completions[0].result == -EINVAL;
+};
+
+TEST("Mapped Files"){
+	const char* path = "zsl_map_test.bin";
+	const size_t size = 3 * 1024 * 1024 + 123;
+	File file = fileOpen(path, FILE_WRITE | FILE_CREATE | FILE_TRUNCATE);
+	if(!file.isValid()) return false;
+	DEFER(unlink(path));
+	char* source = alloc<nalloc, char>(size);
+	DEFER(dealloc<nalloc>(source));
+	for(size_t i = 0; i < size; i++) source[i] = (char)(i * 7);
+	if(fileWrite(file, source, size, 0) != size) return false;
+	fileClose(file);
+	
+	ArrayView<char> map = mapFile(path, MAPPING_SEQUENTIAL | MAPPING_POPULATE);
+	if(map.size != size || memcmp(map.data, source, size) != 0) return false;
+	unmapFile(map);
+	
+	auto reader = FileReader::init(path, 64 * 1024);
+	DEFER(reader.deinit());
+	if(!reader.isValid()) return false;
+	size_t position = 0;
+	while(true){
+		ArrayView<char> window = reader.next();
+		if(window.size == 0) break;
+		if(memcmp(window.data, source + position, window.size) != 0) return false;
+		position += window.size;
+		// Hand the last few bytes out again with the next window.
+		if(!reader.isDone()){
+			reader.unread(10);
+			position -= 10;
+		}
+	}
+	return position == size;
+};
+
+TEST("Clock"){
+	uint64_t time = getTime();
+	uint64_t cycles = readCycles();
+	threadSleep(2000000);
+	if(getTime() - time < 2000000) return false;
+	uint64_t elapsed = cyclesToNanoseconds(readCycles() - cycles);
+	// Calibration is only as good as the sleep it measured.
+	return elapsed > 1000000 && elapsed < 1000000000;
+};
+
+TEST("Profiling"){
+	const char* path = "zsl_profile_test.json";
+	DEFER(unlink(path));
+	profileReset();
+	{
+		PROFILE_SCOPE("outer");
+		for(int i = 0; i < 10; i++){
+			PROFILE_SCOPE("inner \"quoted\"");
+		}
 	}
-	return temp;
+	CONCURRENT{
+		PROFILE_SCOPE("thread");
+	};
+	if(!profileExport(path)) return false;
+	ArrayView<char> json = mapFile(path);
+	DEFER(unmapFile(json));
+	size_t events = 0;
+	for(size_t i = 0; i + 6 < json.size; i++) if(memcmp(json.data + i, "\"ph\":", 5) == 0) events++;
+	return events == 11 + threadCount && json.data[0] == '{';
+};
+
+// Out of line and exported so they show up by name in backtraces and samples.
+__attribute__((noinline)) size_t backtraceLeaf(void** frames, size_t maxFrames){
+	size_t depth = captureBacktrace(frames, maxFrames);
+	// Keeps the call from becoming a tail call, which would take this frame off the stack.
+	asm volatile("" ::: "memory");
+	return depth;
+}
+
+__attribute__((noinline)) uint64_t sampledSpin(uint64_t nanoseconds){
+	uint64_t end = getProcessTime() + nanoseconds;
+	uint64_t hash = 0;
+	while(getProcessTime() < end){
+		for(uint64_t i = 0; i < 100000; i++) hash = mixHash(hash + i);
+	}
+	return hash;
 }
 
+__attribute__((noinline)) void sampledAllocate(char** blocks, size_t count, size_t size){
+	for(size_t i = 0; i < count; i++) blocks[i] = alloc<nalloc, char>(size);
+	asm volatile("" ::: "memory");
+}
+
+// Sums the counts of the folded stack lines that contain name.
+static uint64_t foldedTotal(const char* path, const char* name){
+	ArrayView<char> file = mapFile(path);
+	DEFER(unmapFile(file));
+	StringView rest = {file.size, file.data};
+	StringView line;
+	uint64_t total = 0;
+	while(rest.split(StringView::init("\n"), line)){
+		size_t space = line.size;
+		while(space > 0 && line.data[space - 1] != ' ') space--;
+		if(space == 0 || line.find(StringView::init(name)) == StringView::NOT_FOUND) continue;
+		for(size_t i = space; i < line.size; i++) total = total * 10 + (line.data[i] - '0');
+	}
+	return total;
+}
+
+TEST("Sampling Profiler"){
+	void* frames[64];
+	char name[256];
+	size_t depth = backtraceLeaf(frames, 64);
+	symbolizeAddress((char*)frames[0] - 1, name, sizeof(name));
+	if(depth < 2 || !strstr(name, "backtraceLeaf")) return false;
+	
+	const char* path = "zsl_samples_test.txt";
+	DEFER(unlink(path));
+	samplerReset();
+	if(!samplerStart(1000000)) return false;
+	// About 50 samples with a 4 ms kernel tick, more with a finer one.
+	volatile uint64_t spinTime = 200000000;
+	volatile uint64_t hash = sampledSpin(spinTime);
+	(void)hash;
+	samplerStop();
+	if(!samplerExport(path) || foldedTotal(path, "sampledSpin") < 25) return false;
+	
+	// A megabyte in 1000 blocks is about 250 samples, together they should account for all of it.
+	char* blocks[1000];
+	// Not constants, a copy of sampledAllocate specialized for them would be a local symbol without a name.
+	volatile size_t blockCount = 1000, blockSize = 1024;
+	allocationSamplesReset();
+	setAllocationSampling(4096);
+	sampledAllocate(blocks, blockCount, blockSize);
+	setAllocationSampling(0);
+	for(char* block: blocks) dealloc<nalloc>(block);
+	if(!allocationSamplesExport(path)) return false;
+	uint64_t bytes = foldedTotal(path, "sampledAllocate");
+	return bytes > 1000 * 1024 - 8192 && bytes <= 1000 * 1024;
+};
+
 int main(){
 	int failedCount = 0;
 	for(auto test: tests){
@@ -112,31 +1224,4 @@ int main(){
 		printInfo(test, passed ? passedStatus : failStatus);
 		printf("\n");
 	}
-	
-	const size_t count = 10000;
-	timespec time1, time2;
-	
-	//srand(time(NULL));
-	srand(0);
-	
-	{
-		auto benchmark = HashMap<int, int>::init();
-		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time1);
-		for(int i = 0; i < count; i++) benchmark[rand()] = i;
-		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time2);
-		for(int i = 0; i < count; i++) if(benchmark.has(i)) benchmark.remove(i);
-		benchmark.deinit();
-	}
-	
-	printf("zsl: %ld\n", diff(time1, time2).tv_sec * 1'000'000'000 + diff(time1, time2).tv_nsec);
-	srand(0);
-	
-	{
-		std::unordered_map<int, int> benchmark;
-		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time1);
-		for(int i = 0; i < count; i++) benchmark[rand()] = i;
-		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time2);
-		for(int i = 0; i < count; i++) benchmark.erase(i);
-	}
-	printf("std: %ld\n", diff(time1, time2).tv_sec * 1'000'000'000 + diff(time1, time2).tv_nsec);
 }
@@ -15,6 +15,22 @@ inline void assertJmp(bool check){
 //#define ZSL_DEFAULT_ALLOCATOR testAlloc
 #include "zsl/core.h"
 #include "zsl/hash_map.h"
+#include "zsl/array_list.h"
+#include "zsl/sort.h"
+#include "zsl/string_utils.h"
+#include "zsl/cpu.h"
+#include "zsl/bitset.h"
+#include "zsl/ordered_map.h"
+#include "zsl/filter.h"
+#include "zsl/cache.h"
+#include "zsl/static_map.h"
+#include "zsl/dense_map.h"
+#include "zsl/interner.h"
+#include "zsl/parallel.h"
+#include "zsl/fiber.h"
+#include "zsl/io.h"
+#include "zsl/profile.h"
+#include "zsl/allocation_trace.h"
 
 using namespace zsl;
 
@@ -79,23 +95,3 @@ struct Concurrent{
 	}
 };
 #define CONCURRENT Concurrent TOKEN_PASTE(concurrent, __LINE__) = [&]()
-
-using BenchmarkFunction = void(*)(size_t*, size_t*);
-struct BenchmarkGenerator;
-inline std::vector<BenchmarkGenerator*> benchmarks;
-/*
-
-struct BenchmarkGenerator{
-	const char* name;
-	BenchmarkFunction func;
-	
-	BenchmarkGenerator(const BenchmarkGenerator& gen){
-		*this = gen;
-		benchmarks.push_back(this);
-	}
-	BenchmarkGenerator(const char* set){name = set;}
-	BenchmarkGenerator& operator<<(TestFunction set){func = set; return *this;}
-};
-
-#define TEST(name) BenchmarkGenerator TOKEN_PASTE(benchmark, __LINE__) = BenchmarkGenerator{name} << []() -> void
-*/